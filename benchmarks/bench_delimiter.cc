@@ -0,0 +1,101 @@
+/*
+ * Compares the vectorized delimiter search used by readline against the
+ * per-byte std::string comparison it replaced, on NMEA-like "\r\n" lines.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "serial/impl/delimiter.h"
+
+using Clock = std::chrono::steady_clock;
+
+static const size_t data_size = 8 << 20;
+static const int rounds = 10;
+
+static std::vector<uint8_t>
+make_lines()
+{
+    const std::string sentence = "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n";
+    std::vector<uint8_t> data;
+    data.reserve(data_size + sentence.size());
+    while (data.size() < data_size) {
+        data.insert(data.end(), sentence.begin(), sentence.end());
+    }
+    return data;
+}
+
+// What readline did before: after every byte build a std::string from the
+// last eol.length() bytes and compare it with the EOL.
+static size_t
+count_per_byte(const std::vector<uint8_t>& data, const std::string& eol)
+{
+    size_t lines = 0;
+    for (size_t i = eol.length(); i <= data.size(); ++i) {
+        if (std::string(reinterpret_cast<const char*>(data.data() + i - eol.length()), eol.length()) == eol) {
+            ++lines;
+        }
+    }
+    return lines;
+}
+
+static size_t
+count_search(const std::vector<uint8_t>& data, const std::string& eol)
+{
+    size_t lines = 0;
+    auto pos = data.begin();
+    while ((pos = std::search(pos, data.end(), eol.begin(), eol.end())) != data.end()) {
+        ++lines;
+        pos += eol.length();
+    }
+    return lines;
+}
+
+static size_t
+count_find_delimiter(const std::vector<uint8_t>& data, const std::string& eol)
+{
+    const uint8_t* delimiter = reinterpret_cast<const uint8_t*>(eol.data());
+    size_t lines = 0;
+    size_t pos = 0;
+    while (true) {
+        pos += serial::find_delimiter(data.data() + pos, data.size() - pos, delimiter, eol.length());
+        if (pos == data.size()) {
+            break;
+        }
+        ++lines;
+        pos += eol.length();
+    }
+    return lines;
+}
+
+template <typename F>
+static void
+measure(const char* name, F count, const std::vector<uint8_t>& data, const std::string& eol)
+{
+    size_t lines = 0;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        lines += count(data, eol);
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    printf("  %-26s %9.1f MB/s (%zu lines)\n", name,
+        double(data.size()) * rounds / seconds / 1e6, lines / rounds);
+}
+
+int main()
+{
+    std::vector<uint8_t> data = make_lines();
+    const std::string eol = "\r\n";
+
+    printf("delimiter search over %zu MiB, kernel: %s\n", data.size() >> 20,
+        serial::find_delimiter_kernel());
+    measure("per-byte std::string", count_per_byte, data, eol);
+    measure("std::search", count_search, data, eol);
+    measure("serial::find_delimiter", count_find_delimiter, data, eol);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,285 @@
+/*
+ * Compares list_ports() against the glob, realpath and ifstream based
+ * enumeration it replaced, on a fake /dev and sysfs tree built in a
+ * temporary directory: 32 legacy ttyS stubs, 48 FTDI adapters and 16 CDC
+ * ACM devices. Both must report the same ports. A last row shows the cost
+ * of leaving out the 31 stubs without a UART.
+ */
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <glob.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "serial/impl/list_ports.h"
+#include "serial/serial.h"
+
+using Clock = std::chrono::steady_clock;
+using serial::PortInfo;
+using std::string;
+using std::vector;
+
+static const int legacy_ports = 32;
+static const int usb_ports = 48;
+static const int acm_ports = 16;
+static const int rounds = 200;
+
+static string
+format(const char* format, ...)
+{
+    char buffer[512];
+    va_list ap;
+    va_start(ap, format);
+    vsnprintf(buffer, sizeof(buffer), format, ap);
+    va_end(ap);
+    return buffer;
+}
+
+static void
+make_dir(const string& path)
+{
+    for (size_t slash = path.find('/', 1); slash != string::npos; slash = path.find('/', slash + 1)) {
+        mkdir(path.substr(0, slash).c_str(), 0755);
+    }
+    mkdir(path.c_str(), 0755);
+}
+
+static void
+write_file(const string& path, const string& content)
+{
+    std::ofstream(path.c_str()) << content << "\n";
+}
+
+static void
+link_to(const string& target, const string& path)
+{
+    if (symlink(target.c_str(), path.c_str()) == -1) {
+        perror(path.c_str());
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void
+write_usb_device(const string& path, int number)
+{
+    make_dir(path);
+    write_file(path + "/idVendor", "0403");
+    write_file(path + "/idProduct", "6001");
+    write_file(path + "/manufacturer", "FTDI");
+    write_file(path + "/product", "FT232R USB UART");
+    write_file(path + "/serial", format("A%05d", number));
+    write_file(path + "/devnum", format("%d", number + 2));
+}
+
+static void
+make_tree(const string& root)
+{
+    make_dir(root + "/dev");
+    make_dir(root + "/sys/class/tty");
+    const string usb = "/sys/devices/pci0000:00/0000:00:14.0/usb1";
+    for (int i = 0; i < legacy_ports; ++i) {
+        string tty = format("/sys/devices/platform/serial8250/tty/ttyS%d", i);
+        make_dir(root + tty);
+        link_to("../..", root + tty + "/device");
+        link_to("../../.." + tty, root + format("/sys/class/tty/ttyS%d", i));
+        // Only the first UART has hardware behind it
+        write_file(root + tty + "/type", i == 0 ? "4" : "0");
+        write_file(root + format("/dev/ttyS%d", i), "");
+    }
+    for (int i = 0; i < usb_ports; ++i) {
+        string device = format("%s/1-%d", usb.c_str(), i);
+        string port = format("%s/1-%d:1.0/ttyUSB%d", device.c_str(), i, i);
+        string tty = format("%s/tty/ttyUSB%d", port.c_str(), i);
+        write_usb_device(root + device, i);
+        make_dir(root + tty);
+        link_to(format("../../../ttyUSB%d", i), root + tty + "/device");
+        link_to("../../.." + tty, root + format("/sys/class/tty/ttyUSB%d", i));
+        write_file(root + format("/dev/ttyUSB%d", i), "");
+    }
+    for (int i = 0; i < acm_ports; ++i) {
+        string device = format("%s/2-%d", usb.c_str(), i);
+        string tty = format("%s/2-%d:1.0/tty/ttyACM%d", device.c_str(), i, i);
+        write_usb_device(root + device, usb_ports + i);
+        make_dir(root + tty);
+        link_to("../..", root + tty + "/device");
+        link_to("../../.." + tty, root + format("/sys/class/tty/ttyACM%d", i));
+        write_file(root + format("/dev/ttyACM%d", i), "");
+    }
+}
+
+// The enumeration list_ports() used before, with the /dev and /sys/class/tty
+// prefixes made parameters
+
+static string
+legacy_read_line(const string& file)
+{
+    std::ifstream ifs(file.c_str(), std::ifstream::in);
+    string line;
+    if (ifs) {
+        std::getline(ifs, line);
+    }
+    return line;
+}
+
+static string
+legacy_dirname(const string& path)
+{
+    size_t pos = path.rfind("/");
+    if (pos == string::npos)
+        return path;
+    else if (pos == 0)
+        return "/";
+    return string(path, 0, pos);
+}
+
+static string
+legacy_realpath(const string& path)
+{
+    char* real_path = realpath(path.c_str(), NULL);
+    string result;
+    if (real_path != NULL) {
+        result = real_path;
+        free(real_path);
+    }
+    return result;
+}
+
+static bool
+legacy_path_exists(const string& path)
+{
+    struct stat sb;
+    return stat(path.c_str(), &sb) == 0;
+}
+
+static void
+legacy_usb_info(const string& path, string& friendly_name, string& hardware_id)
+{
+    unsigned int device_number = 0;
+    sscanf(legacy_read_line(path + "/devnum").c_str(), "%u", &device_number);
+    string manufacturer = legacy_read_line(path + "/manufacturer");
+    string product = legacy_read_line(path + "/product");
+    string serial = legacy_read_line(path + "/serial");
+    if (!manufacturer.empty() || !product.empty() || !serial.empty())
+        friendly_name = format("%s %s %s", manufacturer.c_str(), product.c_str(), serial.c_str());
+    string serial_number = legacy_read_line(path + "/serial");
+    if (serial_number.length() > 0)
+        serial_number = format("SNR=%s", serial_number.c_str());
+    string vid = legacy_read_line(path + "/idVendor");
+    string pid = legacy_read_line(path + "/idProduct");
+    hardware_id = format("USB VID:PID=%s:%s %s", vid.c_str(), pid.c_str(), serial_number.c_str());
+}
+
+static vector<PortInfo>
+legacy_list_ports(const string& dev, const string& sys_tty)
+{
+    const char* prefixes[] = { "ttyACM", "ttyS", "ttyUSB", "tty.", "cu." };
+    glob_t glob_results;
+    int flags = 0;
+    for (const char* prefix : prefixes) {
+        glob((dev + "/" + prefix + "*").c_str(), flags, NULL, &glob_results);
+        flags = GLOB_APPEND;
+    }
+    vector<PortInfo> results;
+    for (size_t i = 0; i < glob_results.gl_pathc; ++i) {
+        string device = glob_results.gl_pathv[i];
+        string name = device.substr(device.rfind('/') + 1);
+        string friendly_name;
+        string hardware_id;
+        string sys_device_path = format("%s/%s/device", sys_tty.c_str(), name.c_str());
+        if (name.compare(0, 6, "ttyUSB") == 0) {
+            sys_device_path = legacy_dirname(legacy_dirname(legacy_realpath(sys_device_path)));
+            if (legacy_path_exists(sys_device_path))
+                legacy_usb_info(sys_device_path, friendly_name, hardware_id);
+        }
+        else if (name.compare(0, 6, "ttyACM") == 0) {
+            sys_device_path = legacy_dirname(legacy_realpath(sys_device_path));
+            if (legacy_path_exists(sys_device_path))
+                legacy_usb_info(sys_device_path, friendly_name, hardware_id);
+        }
+        else if (legacy_path_exists(sys_device_path + "/id")) {
+            hardware_id = legacy_read_line(sys_device_path + "/id");
+        }
+        PortInfo info;
+        info.port = device;
+        info.description = friendly_name.empty() ? name : friendly_name;
+        info.hardware_id = hardware_id.empty() ? "n/a" : hardware_id;
+        results.push_back(info);
+    }
+    globfree(&glob_results);
+    return results;
+}
+
+static bool
+same_ports(const vector<PortInfo>& a, const vector<PortInfo>& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].port != b[i].port || a[i].description != b[i].description
+            || a[i].hardware_id != b[i].hardware_id)
+            return false;
+    }
+    return true;
+}
+
+template <typename List>
+static double
+time_per_call(List list)
+{
+    size_t ports = 0;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        ports += list().size();
+    }
+    double elapsed = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    if (ports == 0) {
+        printf("  (no ports listed)\n");
+    }
+    return elapsed / rounds;
+}
+
+static void
+compare(const char* title, const string& dev, const string& sys_tty)
+{
+    vector<PortInfo> legacy = legacy_list_ports(dev, sys_tty);
+    vector<PortInfo> current = serial::list_ports_in(dev, sys_tty, serial::ListPortsOptions(), 1);
+    printf("%s, %zu ports%s\n", title, current.size(),
+        same_ports(legacy, current) ? "" : "  ** results differ **");
+    printf("  %-28s %10.1f us/call\n", "glob + realpath + ifstream",
+        time_per_call([&] { return legacy_list_ports(dev, sys_tty); }));
+    for (unsigned threads : { 1u, 2u, 4u }) {
+        string label = format("openat, %u thread%s", threads, threads == 1 ? "" : "s");
+        printf("  %-28s %10.1f us/call\n", label.c_str(),
+            time_per_call([&] { return serial::list_ports_in(dev, sys_tty, serial::ListPortsOptions(), threads); }));
+    }
+    serial::ListPortsOptions present_only;
+    present_only.present_only = true;
+    size_t present = serial::list_ports_in(dev, sys_tty, present_only, 1).size();
+    string label = format("present_only, %zu ports", present);
+    printf("  %-28s %10.1f us/call\n", label.c_str(),
+        time_per_call([&] { return serial::list_ports_in(dev, sys_tty, present_only, 1); }));
+}
+
+int main()
+{
+    char root_template[] = "/tmp/bench_list_ports.XXXXXX";
+    char* root = mkdtemp(root_template);
+    if (root == NULL) {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    make_tree(root);
+    compare("fake tree", string(root) + "/dev", string(root) + "/sys/class/tty");
+    compare("this host", "/dev", "/sys/class/tty");
+
+    string remove = string("rm -rf ") + root;
+    return system(remove.c_str()) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,89 @@
+/*
+ * Compares system calls per KiB of Serial::read in readmode_poll,
+ * readmode_kernel and readmode_uring. A writer thread feeds the master side
+ * of a pty in small bursts, the reader asks for fixed size blocks the way
+ * framed protocols do.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include <pty.h>
+#include <unistd.h>
+
+#include "serial/serial.h"
+#include "syscall_counter.h"
+
+using Clock = std::chrono::steady_clock;
+
+static const size_t total_bytes = 256 * 1024;
+static const size_t burst_size = 32;
+
+static void
+run(serial::readmode_t mode, const char* name, size_t block_size)
+{
+    int master, slave;
+    char path[128];
+    if (openpty(&master, &slave, path, NULL, NULL) == -1) {
+        perror("openpty");
+        exit(EXIT_FAILURE);
+    }
+
+    serial::Serial port(path, 115200, serial::Timeout(50, 1000, 0, 1000, 0));
+    port.setReadMode(mode);
+    if (port.getReadMode() != mode) {
+        printf("  %-8s unavailable, falls back to poll\n", name);
+        ::close(master);
+        ::close(slave);
+        return;
+    }
+
+    std::thread writer([&]() {
+        std::vector<uint8_t> burst(burst_size, 'x');
+        for (size_t sent = 0; sent < total_bytes; sent += burst_size) {
+            if (::write(master, burst.data(), burst.size()) < 0) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
+        }
+    });
+
+    std::vector<uint8_t> block(block_size);
+    size_t received = 0;
+    uint64_t calls = 0;
+    Clock::time_point start = Clock::now();
+    {
+        syscall_counter::Scope scope;
+        while (received < total_bytes) {
+            size_t bytes_read = port.read(block.data(), block.size());
+            if (bytes_read == 0) {
+                break;
+            }
+            received += bytes_read;
+        }
+        calls = scope.count();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    writer.join();
+
+    printf("  %-8s block %4zu: %7.2f syscalls/KiB, %6.2f MB/s\n", name, block_size,
+        double(calls) * 1024 / double(received), double(received) / seconds / 1e6);
+
+    ::close(master);
+    ::close(slave);
+}
+
+int main()
+{
+    printf("Serial::read of %zu KiB fed in %zu byte bursts\n", total_bytes / 1024, burst_size);
+    for (size_t block_size : { 64, 255, 1024 }) {
+        run(serial::readmode_poll, "poll", block_size);
+        run(serial::readmode_kernel, "kernel", block_size);
+        run(serial::readmode_uring, "uring", block_size);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,111 @@
+/*
+ * Timeout heavy read paths against a device paced at its baud rate. For each
+ * line profile the device streams fixed size frames and the reader asks for
+ * one frame per Serial::read; the report shows how far past the frame's
+ * last byte each read returned (p50/p99/max) and syscalls per frame.
+ *
+ * The virtual device is seeded, so runs are comparable between builds.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "serial/serial.h"
+#include "syscall_counter.h"
+#include "virtual_device.h"
+
+using Clock = std::chrono::steady_clock;
+using serial::LatencyHistogram;
+using serial::MicrosecondTimeout;
+using serial::PortConfig;
+using serial_test::VirtualDevice;
+
+static const size_t frames = 200;
+
+struct Profile {
+    const char* name;
+    uint32_t baudrate;
+    size_t frame_size;
+    MicrosecondTimeout timeout;
+    serial::readmode_t read_mode;
+    VirtualDevice::Options options;
+};
+
+static void
+run(const Profile& profile)
+{
+    PortConfig line(profile.baudrate);
+    VirtualDevice device(line, profile.options);
+    serial::Serial port(device.name(), profile.baudrate);
+    port.setTimeout(profile.timeout);
+    port.setReadMode(profile.read_mode);
+
+    const std::chrono::nanoseconds frame_time(device.byteTimeNs() * profile.frame_size);
+    std::string frame(profile.frame_size, 'f');
+    std::vector<uint8_t> buffer(profile.frame_size);
+    LatencyHistogram overshoot;
+    size_t short_reads = 0;
+    uint64_t calls = 0;
+
+    for (size_t i = 0; i < frames; ++i) {
+        Clock::time_point sent = Clock::now();
+        device.send(frame);
+        size_t bytes_read;
+        {
+            syscall_counter::Scope scope;
+            bytes_read = port.read(buffer.data(), buffer.size());
+            calls += scope.count();
+        }
+        Clock::time_point done = Clock::now();
+        if (bytes_read < frame.size()) {
+            ++short_reads;
+        }
+        // Time past the moment the last byte could have arrived
+        std::chrono::nanoseconds late = done - sent - frame_time;
+        overshoot.record(late.count() > 0 ? static_cast<uint64_t>(late.count()) : 0);
+        device.flush();
+        port.flushInput();
+    }
+
+    printf("%-28s %8.1f %9.1f %9.1f %10.1f %7zu\n", profile.name,
+        double(overshoot.percentile(0.5)) / 1000, double(overshoot.percentile(0.99)) / 1000,
+        double(overshoot.max()) / 1000, double(calls) / frames, short_reads);
+}
+
+int main()
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    printf("%zu frames per profile, overshoot past the last byte in us\n", frames);
+    printf("%-28s %8s %9s %9s %10s %7s\n", "profile", "p50", "p99", "max", "calls/frm", "short");
+
+    VirtualDevice::Options plain;
+    VirtualDevice::Options jitter;
+    jitter.jitter_ns = 20000;
+    VirtualDevice::Options usb;
+    usb.burst_size = 64;
+    VirtualDevice::Options gaps;
+    gaps.gap_every = 16;
+    gaps.gap_ns = 2000000;
+
+    const MicrosecondTimeout total_only(MicrosecondTimeout::max(), 200000, 0, 100000, 0);
+    const MicrosecondTimeout inter_byte(5000, 200000, 0, 100000, 0);
+    const MicrosecondTimeout multiplier(MicrosecondTimeout::max(), 5000, 100, 100000, 0);
+
+    const Profile profiles[] = {
+        { "9600 64B total", 9600, 64, total_only, serial::readmode_poll, plain },
+        { "115200 64B total", 115200, 64, total_only, serial::readmode_poll, plain },
+        { "115200 64B inter-byte", 115200, 64, inter_byte, serial::readmode_poll, plain },
+        { "115200 64B multiplier", 115200, 64, multiplier, serial::readmode_poll, plain },
+        { "115200 64B jitter", 115200, 64, total_only, serial::readmode_poll, jitter },
+        { "115200 256B usb bursts", 115200, 256, total_only, serial::readmode_poll, usb },
+        { "115200 64B gaps", 115200, 64, inter_byte, serial::readmode_poll, gaps },
+        { "115200 64B kernel", 115200, 64, inter_byte, serial::readmode_kernel, plain },
+        { "115200 64B kernel gaps", 115200, 64, inter_byte, serial::readmode_kernel, gaps },
+    };
+    for (const Profile& profile : profiles) {
+        run(profile);
+    }
+    return EXIT_SUCCESS;
+}
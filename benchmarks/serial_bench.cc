@@ -0,0 +1,224 @@
+/*
+ * Throughput and system calls per byte of Serial::read, readline, readlines
+ * and write at several chunk sizes. A pty pair stands in for the device: a
+ * helper thread feeds or drains the master side as fast as it can while the
+ * calling thread drives the Serial under test. The port runs at 4 Mbaud so
+ * the pre-read byte time wait of multi-byte reads stays out of the way.
+ *
+ * Usage: serial_bench [megabytes per case, default 4]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "serial/serial.h"
+#include "syscall_counter.h"
+
+using Clock = std::chrono::steady_clock;
+
+static size_t total_bytes = 4 << 20;
+
+struct Pty {
+    Pty()
+    {
+        char path[128];
+        if (openpty(&master, &slave, path, NULL, NULL) == -1) {
+            perror("openpty");
+            exit(EXIT_FAILURE);
+        }
+        name = path;
+        termios options;
+        tcgetattr(master, &options);
+        cfmakeraw(&options);
+        tcsetattr(master, TCSANOW, &options);
+    }
+    ~Pty()
+    {
+        ::close(master);
+        ::close(slave);
+    }
+    int master;
+    int slave;
+    std::string name;
+};
+
+struct Result {
+    size_t bytes;
+    uint64_t calls;
+    double seconds;
+};
+
+static void
+report(const char* operation, size_t chunk, const Result& result)
+{
+    printf("%-10s %6zu  %8.2f MB/s  %21.4f  %20.1f\n",
+        operation, chunk, double(result.bytes) / result.seconds / 1e6,
+        double(result.calls) / double(result.bytes),
+        double(result.bytes) / double(result.calls ? result.calls : 1));
+}
+
+// Device side writer: pattern in pieces of piece bytes, optionally lines
+static std::thread
+feed(int fd, size_t piece, bool lines)
+{
+    return std::thread([fd, piece, lines]() {
+        std::vector<char> data(piece, 'x');
+        if (lines && piece > 0) {
+            data.back() = '\n';
+        }
+        for (size_t sent = 0; sent < total_bytes;) {
+            ssize_t n = ::write(fd, data.data(), data.size());
+            if (n <= 0) {
+                return;
+            }
+            sent += static_cast<size_t>(n);
+        }
+    });
+}
+
+static Result
+bench_read(size_t chunk)
+{
+    Pty pty;
+    serial::Serial port(pty.name, 4000000, serial::Timeout::simpleTimeout(1000));
+    std::thread device = feed(pty.master, 4096, false);
+    std::vector<uint8_t> buffer(chunk);
+    Result result = { 0, 0, 0 };
+    Clock::time_point start = Clock::now();
+    {
+        syscall_counter::Scope scope;
+        while (result.bytes < total_bytes) {
+            size_t n = port.read(buffer.data(), std::min(chunk, total_bytes - result.bytes));
+            if (n == 0) {
+                break;
+            }
+            result.bytes += n;
+        }
+        result.calls = scope.count();
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    device.join();
+    return result;
+}
+
+static Result
+bench_readline(size_t line_length)
+{
+    Pty pty;
+    serial::Serial port(pty.name, 4000000, serial::Timeout::simpleTimeout(1000));
+    std::thread device = feed(pty.master, line_length, true);
+    std::string line;
+    Result result = { 0, 0, 0 };
+    Clock::time_point start = Clock::now();
+    {
+        syscall_counter::Scope scope;
+        while (result.bytes < total_bytes) {
+            line.clear();
+            size_t n = port.readline(line, 65536, "\n");
+            if (n == 0) {
+                break;
+            }
+            result.bytes += n;
+        }
+        result.calls = scope.count();
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    device.join();
+    return result;
+}
+
+static Result
+bench_readlines(size_t line_length)
+{
+    Pty pty;
+    serial::Serial port(pty.name, 4000000, serial::Timeout::simpleTimeout(1000));
+    std::thread device = feed(pty.master, line_length, true);
+    Result result = { 0, 0, 0 };
+    Clock::time_point start = Clock::now();
+    {
+        syscall_counter::Scope scope;
+        while (result.bytes < total_bytes) {
+            // Ask for roughly a page of lines at a time
+            std::vector<std::string> lines = port.readlines(std::max<size_t>(4096, line_length), "\n");
+            if (lines.empty()) {
+                break;
+            }
+            for (const std::string& line : lines) {
+                result.bytes += line.size();
+            }
+        }
+        result.calls = scope.count();
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    device.join();
+    return result;
+}
+
+static Result
+bench_write(size_t chunk)
+{
+    Pty pty;
+    serial::Serial port(pty.name, 4000000, serial::Timeout::simpleTimeout(1000));
+    std::thread device([&pty]() {
+        std::vector<char> buffer(65536);
+        for (size_t received = 0; received < total_bytes;) {
+            ssize_t n = ::read(pty.master, buffer.data(), buffer.size());
+            if (n <= 0) {
+                return;
+            }
+            received += static_cast<size_t>(n);
+        }
+    });
+    std::vector<uint8_t> data(chunk, 'x');
+    Result result = { 0, 0, 0 };
+    Clock::time_point start = Clock::now();
+    {
+        syscall_counter::Scope scope;
+        while (result.bytes < total_bytes) {
+            size_t n = port.write(data.data(), std::min(chunk, total_bytes - result.bytes));
+            if (n == 0) {
+                break;
+            }
+            result.bytes += n;
+        }
+        result.calls = scope.count();
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    device.join();
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    if (argc > 1) {
+        total_bytes = static_cast<size_t>(atoi(argv[1])) << 20;
+    }
+    printf("%zu MiB per case over a pty pair\n", total_bytes >> 20);
+    printf("%-10s %6s  %13s  %21s  %20s\n", "operation", "chunk", "throughput",
+        "syscalls/byte", "bytes/syscall");
+
+    const size_t chunks[] = { 1, 16, 256, 4096, 65536 };
+    for (size_t chunk : chunks) {
+        report("read", chunk, bench_read(chunk));
+    }
+    for (size_t chunk : chunks) {
+        report("write", chunk, bench_write(chunk));
+    }
+    const size_t line_lengths[] = { 16, 80, 1024 };
+    for (size_t length : line_lengths) {
+        report("readline", length, bench_readline(length));
+    }
+    for (size_t length : line_lengths) {
+        report("readlines", length, bench_readlines(length));
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,156 @@
+/*
+ * Counts the system calls the serial library makes on the calling thread.
+ *
+ * The wrappers below interpose the libc entry points SerialImpl uses and
+ * forward to the real ones found through dlsym(RTLD_NEXT). Include this
+ * header from exactly one source file of a benchmark executable.
+ */
+
+#ifndef SERIAL_BENCHMARKS_SYSCALL_COUNTER_H
+#define SERIAL_BENCHMARKS_SYSCALL_COUNTER_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <cstdarg>
+#include <cstdint>
+#include <dlfcn.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace syscall_counter {
+
+// Counting is per thread so a writer thread feeding the pty is not included
+static thread_local bool enabled = false;
+static thread_local uint64_t calls = 0;
+
+struct Scope {
+    Scope()
+    {
+        calls = 0;
+        enabled = true;
+    }
+    ~Scope() { enabled = false; }
+    uint64_t count() const { return calls; }
+};
+
+template <typename F>
+static F
+next(const char* name)
+{
+    return reinterpret_cast<F>(dlsym(RTLD_NEXT, name));
+}
+
+} // namespace syscall_counter
+
+#define SYSCALL_COUNTER_HIT()           \
+    do {                                \
+        if (syscall_counter::enabled) { \
+            ++syscall_counter::calls;   \
+        }                               \
+    } while (0)
+
+extern "C" {
+
+ssize_t read(int fd, void* buf, size_t count)
+{
+    static auto real = syscall_counter::next<ssize_t (*)(int, void*, size_t)>("read");
+    SYSCALL_COUNTER_HIT();
+    return real(fd, buf, count);
+}
+
+ssize_t write(int fd, const void* buf, size_t count)
+{
+    static auto real = syscall_counter::next<ssize_t (*)(int, const void*, size_t)>("write");
+    SYSCALL_COUNTER_HIT();
+    return real(fd, buf, count);
+}
+
+ssize_t readv(int fd, const struct iovec* iov, int count)
+{
+    static auto real = syscall_counter::next<ssize_t (*)(int, const struct iovec*, int)>("readv");
+    SYSCALL_COUNTER_HIT();
+    return real(fd, iov, count);
+}
+
+ssize_t writev(int fd, const struct iovec* iov, int count)
+{
+    static auto real = syscall_counter::next<ssize_t (*)(int, const struct iovec*, int)>("writev");
+    SYSCALL_COUNTER_HIT();
+    return real(fd, iov, count);
+}
+
+// Declared __THROW (noexcept) by <sys/ioctl.h>, the definition must match
+int ioctl(int fd, unsigned long request, ...) __THROW
+{
+    static auto real = syscall_counter::next<int (*)(int, unsigned long, void*)>("ioctl");
+    va_list ap;
+    va_start(ap, request);
+    void* arg = va_arg(ap, void*);
+    va_end(ap);
+    SYSCALL_COUNTER_HIT();
+    return real(fd, request, arg);
+}
+
+int poll(struct pollfd* fds, nfds_t count, int timeout)
+{
+    static auto real = syscall_counter::next<int (*)(struct pollfd*, nfds_t, int)>("poll");
+    SYSCALL_COUNTER_HIT();
+    return real(fds, count, timeout);
+}
+
+int ppoll(struct pollfd* fds, nfds_t count, const struct timespec* timeout, const sigset_t* mask)
+{
+    static auto real = syscall_counter::next<int (*)(struct pollfd*, nfds_t, const struct timespec*, const sigset_t*)>("ppoll");
+    SYSCALL_COUNTER_HIT();
+    return real(fds, count, timeout, mask);
+}
+
+int epoll_wait(int epfd, struct epoll_event* events, int max_events, int timeout)
+{
+    static auto real = syscall_counter::next<int (*)(int, struct epoll_event*, int, int)>("epoll_wait");
+    SYSCALL_COUNTER_HIT();
+    return real(epfd, events, max_events, timeout);
+}
+
+int epoll_pwait2(int epfd, struct epoll_event* events, int max_events, const struct timespec* timeout, const sigset_t* mask)
+{
+    static auto real = syscall_counter::next<int (*)(int, struct epoll_event*, int, const struct timespec*, const sigset_t*)>("epoll_pwait2");
+    SYSCALL_COUNTER_HIT();
+    return real(epfd, events, max_events, timeout, mask);
+}
+
+int nanosleep(const struct timespec* duration, struct timespec* remaining)
+{
+    static auto real = syscall_counter::next<int (*)(const struct timespec*, struct timespec*)>("nanosleep");
+    SYSCALL_COUNTER_HIT();
+    return real(duration, remaining);
+}
+
+// io_uring has no libc wrapper, readmode_uring calls syscall() directly.
+// None of its calls take more than six arguments.
+long syscall(long number, ...) __THROW
+{
+    static auto real = syscall_counter::next<long (*)(long, ...)>("syscall");
+    va_list ap;
+    va_start(ap, number);
+    long args[6];
+    for (int i = 0; i < 6; ++i) {
+        args[i] = va_arg(ap, long);
+    }
+    va_end(ap);
+    SYSCALL_COUNTER_HIT();
+    return real(number, args[0], args[1], args[2], args[3], args[4], args[5]);
+}
+
+} // extern "C"
+
+#undef SYSCALL_COUNTER_HIT
+
+#endif // SERIAL_BENCHMARKS_SYSCALL_COUNTER_H
@@ -0,0 +1,247 @@
+/*!
+ * \file serial/coroutine.h
+ *
+ * \section LICENSE
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides C++20 coroutine awaitables for reading and writing ports
+ * registered with a serial::IoExecutor (Linux only). The library itself is
+ * built as C++17, everything here is header only and only available when
+ * the including code is compiled with coroutine support.
+ *
+ * \code
+ * serial::Detached session(serial::Serial& port)
+ * {
+ *     co_await port.asyncWrite(std::string("AT\r\n"));
+ *     std::string reply = co_await port.asyncReadUntil("\r\n");
+ *     ...
+ * }
+ * \endcode
+ */
+
+#ifndef SERIAL_COROUTINE_H
+#define SERIAL_COROUTINE_H
+
+#if defined(__cpp_impl_coroutine) && !defined(_WIN32)
+
+#include <coroutine>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "serial/executor.h"
+#include "serial/serial.h"
+
+namespace serial {
+
+/*!
+ * Return type for coroutines that are started and left to run on their
+ * own, like a detached thread. The coroutine runs until its first co_await
+ * on the calling thread and continues on the executor's thread. An
+ * exception escaping it calls std::terminate.
+ */
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() { return Detached(); }
+        std::suspend_never initial_suspend() noexcept { return std::suspend_never(); }
+        std::suspend_never final_suspend() noexcept { return std::suspend_never(); }
+        void return_void() { }
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+namespace detail {
+
+inline IoExecutor&
+executor_of(Serial& port, const char* what)
+{
+    IoExecutor* executor = IoExecutor::of(port);
+    if (executor == NULL) {
+        throw SerialException(std::string(what) + " port not registered");
+    }
+    return *executor;
+}
+
+} // namespace detail
+
+/*! Awaitable returned by Serial::asyncRead, yields the bytes read. */
+class ReadAwaitable {
+public:
+    ReadAwaitable(Serial& port, uint8_t* buffer, size_t size)
+        : port_(port)
+        , executor_(detail::executor_of(port, "Serial::asyncRead"))
+        , buffer_(buffer)
+        , size_(size)
+        , result_(0)
+    {
+    }
+
+    bool await_ready() const { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        // The handler may resume the coroutine on the executor's thread
+        // before this returns, nothing may be touched after the call
+        executor_.asyncRead(port_, buffer_, size_, [this, handle](size_t bytes_read, std::exception_ptr error) {
+            result_ = bytes_read;
+            error_ = error;
+            handle.resume();
+        });
+    }
+
+    size_t await_resume()
+    {
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+        return result_;
+    }
+
+private:
+    Serial& port_;
+    IoExecutor& executor_;
+    uint8_t* buffer_;
+    size_t size_;
+    size_t result_;
+    std::exception_ptr error_;
+};
+
+/*! Awaitable returned by Serial::asyncReadUntil, yields the line read. */
+class ReadUntilAwaitable {
+public:
+    ReadUntilAwaitable(Serial& port, std::string eol, size_t size)
+        : port_(port)
+        , executor_(detail::executor_of(port, "Serial::asyncReadUntil"))
+        , eol_(std::move(eol))
+        , size_(size)
+    {
+    }
+
+    bool await_ready() const { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        executor_.asyncReadUntil(port_, eol_, size_, [this, handle](std::string line, std::exception_ptr error) {
+            result_ = std::move(line);
+            error_ = error;
+            handle.resume();
+        });
+    }
+
+    std::string await_resume()
+    {
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+        return std::move(result_);
+    }
+
+private:
+    Serial& port_;
+    IoExecutor& executor_;
+    std::string eol_;
+    size_t size_;
+    std::string result_;
+    std::exception_ptr error_;
+};
+
+/*!
+ * Awaitable returned by Serial::asyncWrite, yields the bytes written. It
+ * owns the data, which lives in the coroutine frame until the write is
+ * done.
+ */
+class WriteAwaitable {
+public:
+    WriteAwaitable(Serial& port, std::vector<uint8_t> data)
+        : port_(port)
+        , executor_(detail::executor_of(port, "Serial::asyncWrite"))
+        , data_(std::move(data))
+        , result_(0)
+    {
+    }
+
+    bool await_ready() const { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        executor_.asyncWrite(port_, data_.data(), data_.size(), [this, handle](size_t bytes_written, std::exception_ptr error) {
+            result_ = bytes_written;
+            error_ = error;
+            handle.resume();
+        });
+    }
+
+    size_t await_resume()
+    {
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+        return result_;
+    }
+
+private:
+    Serial& port_;
+    IoExecutor& executor_;
+    std::vector<uint8_t> data_;
+    size_t result_;
+    std::exception_ptr error_;
+};
+
+inline ReadAwaitable
+Serial::asyncRead(uint8_t* buffer, size_t size)
+{
+    return ReadAwaitable(*this, buffer, size);
+}
+
+#ifdef __cpp_lib_span
+inline ReadAwaitable
+Serial::asyncRead(std::span<uint8_t> buffer)
+{
+    return ReadAwaitable(*this, buffer.data(), buffer.size());
+}
+#endif
+
+inline ReadUntilAwaitable
+Serial::asyncReadUntil(std::string eol, size_t size)
+{
+    return ReadUntilAwaitable(*this, std::move(eol), size);
+}
+
+inline WriteAwaitable
+Serial::asyncWrite(std::vector<uint8_t> data)
+{
+    return WriteAwaitable(*this, std::move(data));
+}
+
+inline WriteAwaitable
+Serial::asyncWrite(const std::string& data)
+{
+    return WriteAwaitable(*this, std::vector<uint8_t>(data.begin(), data.end()));
+}
+
+} // namespace serial
+
+#endif // defined(__cpp_impl_coroutine) && !defined(_WIN32)
+
+#endif
@@ -0,0 +1,204 @@
+/*!
+ * \file serial/executor.h
+ *
+ * \section LICENSE
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides an epoll based executor that runs asynchronous reads and
+ * writes on many serial ports from a single thread (Linux only). The C++20
+ * coroutine interface in serial/coroutine.h is built on top of it.
+ */
+
+#ifndef SERIAL_EXECUTOR_H
+#define SERIAL_EXECUTOR_H
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "serial/serial.h"
+
+namespace serial {
+
+/*!
+ * Event loop that completes read, read-until and write operations on
+ * registered ports as they become ready, without a thread per port.
+ *
+ * Operations follow the port's Timeout the same way the blocking calls do:
+ * a read is bounded by the total read timeout for its size, a read-until by
+ * the timeout for one byte after the last byte that arrived (as readline),
+ * a write by the total write timeout for its size. Each deadline is a timer
+ * in the executor that is cancelled when the operation finishes first; when
+ * it fires the operation completes with what it has, as a short count.
+ *
+ * Ports are opened and configured as usual and then registered with add().
+ * Each port runs at most one read-type and one write operation at a time.
+ * While registered, a port must not be read from anywhere else. Writes from
+ * other threads do not interleave with a single write() syscall but may
+ * land between the chunks of an asynchronous write.
+ *
+ * Completion handlers run on the thread driving run() or runOnce(), never
+ * inside the call that started the operation. Operations may be started
+ * and ports added or removed from any thread.
+ */
+class IoExecutor {
+public:
+    /*! Receives the bytes transferred and the failure, or null. */
+    typedef std::function<void(size_t, std::exception_ptr)> Handler;
+
+    /*! Receives the line read and the failure, or null. */
+    typedef std::function<void(std::string, std::exception_ptr)> LineHandler;
+
+    /*!
+     * Creates an executor with no ports.
+     *
+     * \throw serial::IOException
+     */
+    IoExecutor();
+
+    IoExecutor(const IoExecutor&) = delete;
+    IoExecutor& operator=(const IoExecutor&) = delete;
+
+    /*!
+     * Unregisters every port. Operations still pending complete with a
+     * serial::SerialException, their handlers run on the destroying thread.
+     */
+    ~IoExecutor();
+
+    /*!
+     * Registers an open port.
+     *
+     * \throw serial::PortNotOpenedException
+     * \throw serial::SerialException if the port is registered already
+     * \throw serial::IOException
+     */
+    void add(Serial& port);
+
+    /*!
+     * Unregisters a port. Its pending operations complete with a
+     * serial::SerialException on the executor's thread. Does nothing if
+     * the port is not registered. Closing or destroying a registered port
+     * removes it the same way, with a serial::PortNotOpenedException.
+     */
+    void remove(Serial& port);
+
+    /*! Returns the executor a port is registered with, or null. */
+    static IoExecutor* of(Serial& port);
+
+    /*!
+     * Reads exactly size bytes into buffer, or fewer on timeout.
+     *
+     * \throw serial::SerialException if the port is not registered or has
+     * a read pending
+     */
+    void asyncRead(Serial& port, uint8_t* buffer, size_t size, Handler handler);
+
+    /*!
+     * Reads until eol is seen or size bytes were read, or fewer on timeout.
+     * Bytes after the delimiter stay buffered in the port.
+     *
+     * \throw serial::SerialException if the port is not registered or has
+     * a read pending
+     */
+    void asyncReadUntil(Serial& port, const std::string& eol, size_t size, LineHandler handler);
+
+    /*!
+     * Writes size bytes from data, or fewer on timeout. The data must stay
+     * valid until the handler has run.
+     *
+     * \throw serial::SerialException if the port is not registered or has
+     * a write pending
+     */
+    void asyncWrite(Serial& port, const uint8_t* data, size_t size, Handler handler);
+
+    /*! Runs task on the executor's thread, thread safe. */
+    void post(std::function<void()> task);
+
+    /*!
+     * Waits up to timeout milliseconds for activity, then advances every
+     * operation that can make progress and runs the handlers of those that
+     * finished.
+     *
+     * \param timeout Milliseconds to wait, Timeout::max() waits until there
+     * is activity, a deadline passes or stop() is called.
+     *
+     * \return The number of handlers and posted tasks run.
+     *
+     * \throw serial::IOException
+     */
+    size_t runOnce(uint32_t timeout);
+
+    /*! Runs the loop until stop() is called. */
+    void run();
+
+    /*! Makes run() return after the current iteration, thread safe. */
+    void stop();
+
+    /*! Returns the number of operations that have not completed yet. */
+    size_t pending() const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Operation;
+    struct Port;
+    typedef std::multimap<Clock::time_point, Operation*> Timers;
+
+    void start(Port& port, std::unique_ptr<Operation> operation);
+    bool advance(Port& port, Operation& operation);
+    static size_t readAvailable(Port& port, uint8_t* buffer, size_t size);
+    void finish(Port& port, std::unique_ptr<Operation>& slot, std::exception_ptr error);
+    void updateEvents(Port& port);
+    void setDeadline(Operation& operation, Clock::time_point deadline);
+    Port& registered(Serial& port, const char* what);
+    void wake();
+
+    // Unregisters the port behind impl, failing its pending operations
+    // with error. The port calls this when it is closed.
+    void detach(Serial::SerialImpl* impl, std::exception_ptr error);
+    friend class Serial::SerialImpl;
+
+    int epoll_fd_; // Epoll set watching registered ports
+    int wake_fd_; // Eventfd used to interrupt epoll_wait
+    std::atomic<bool> stopped_;
+    std::thread::id loop_thread_; // Thread inside runOnce, if any
+
+    mutable std::mutex mutex_; // Guards everything below
+    std::map<int, std::unique_ptr<Port>> ports_; // Registered ports by fd
+    std::vector<int> ready_; // Ports to advance without waiting for epoll
+    Timers timers_; // Operation deadlines, earliest first
+    std::vector<std::function<void()>> completions_; // Handlers and posted tasks to run
+    size_t pending_;
+};
+
+} // namespace serial
+
+#endif
@@ -0,0 +1,39 @@
+/*!
+ * \file serial/impl/delimiter.h
+ *
+ * \section DESCRIPTION
+ *
+ * Delimiter search used to split lines out of the receive buffer. On x86 the
+ * search runs 16 (SSE2) or 32 (AVX2) bytes per step, picked at runtime, with
+ * a memchr based scalar fallback elsewhere.
+ */
+
+#ifndef SERIAL_IMPL_DELIMITER_H
+#define SERIAL_IMPL_DELIMITER_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace serial {
+
+/*!
+ * Finds the first occurrence of delimiter in data.
+ *
+ * \param data Bytes to search.
+ * \param size Number of bytes in data.
+ * \param delimiter Bytes to look for.
+ * \param delimiter_size Number of bytes in delimiter.
+ *
+ * \return Offset of the first match, or size when there is none (including
+ * when delimiter_size is zero or larger than size).
+ */
+size_t find_delimiter(const uint8_t* data, size_t size,
+    const uint8_t* delimiter, size_t delimiter_size);
+
+/*! Name of the search kernel selected for this CPU ("avx2", "sse2" or
+ *  "scalar"). */
+const char* find_delimiter_kernel();
+
+} // namespace serial
+
+#endif // SERIAL_IMPL_DELIMITER_H
@@ -0,0 +1,75 @@
+/*!
+ * \file serial/impl/list_ports.h
+ *
+ * \section DESCRIPTION
+ *
+ * Pieces of the Linux port enumeration shared by list_ports() and
+ * PortMonitor: which device names count as serial ports, how one port is
+ * described from sysfs, and the kernel uevent message format.
+ */
+
+#ifndef SERIAL_IMPL_LIST_PORTS_H
+#define SERIAL_IMPL_LIST_PORTS_H
+
+#if defined(__linux__)
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "serial/serial.h"
+
+namespace serial {
+
+/*!
+ * True if name, a device node name relative to /dev such as "ttyUSB0", is
+ * one list_ports() reports.
+ */
+bool is_port_name(const std::string& name);
+
+/*! Describes the port at device, a path such as "/dev/ttyUSB0", from sysfs. */
+PortInfo describe_port(const std::string& device);
+
+/*!
+ * The /dev/serial/by-id link under dev_path that udev made for the port
+ * name, such as "ttyUSB0". Empty if there is none, or none yet: udev makes
+ * the link some time after the kernel announced the port.
+ */
+std::string by_id_link(const std::string& dev_path, const std::string& name);
+
+/*!
+ * False if device is a legacy UART port without hardware, one that
+ * ListPortsOptions::present_only leaves out.
+ */
+bool port_present(const std::string& device);
+
+/*!
+ * What list_ports() does, against the device nodes in dev_path and the
+ * tty class directory sysfs_tty_path, so it can run on a copy of the
+ * trees. Large sets of ports are described, and probed for present_only,
+ * on up to threads threads.
+ */
+std::vector<PortInfo> list_ports_in(const std::string& dev_path,
+    const std::string& sysfs_tty_path, const ListPortsOptions& options, unsigned threads);
+
+/*! The fields of a kernel uevent that port tracking looks at. */
+struct Uevent {
+    std::string action; // "add", "remove", "change", ...
+    std::string subsystem;
+    std::string devname; // Device node relative to /dev, empty if none
+};
+
+/*!
+ * Parses one NETLINK_KOBJECT_UEVENT datagram: an "action@devpath" header
+ * followed by NUL separated KEY=VALUE pairs.
+ *
+ * \return False if data is not a kernel uevent, for instance a message
+ * udev rebroadcast with its own binary header.
+ */
+bool parse_uevent(const char* data, size_t size, Uevent& event);
+
+} // namespace serial
+
+#endif // defined(__linux__)
+
+#endif // SERIAL_IMPL_LIST_PORTS_H
@@ -0,0 +1,96 @@
+/*!
+ * \file serial/impl/mpsc_queue.h
+ *
+ * \section DESCRIPTION
+ *
+ * Intrusive multi-producer single-consumer queue (Vyukov's algorithm).
+ * Producers enqueue with one atomic exchange and never wait on each other
+ * or on the consumer; only the single consumer may call pop() and empty().
+ */
+
+#ifndef SERIAL_IMPL_MPSC_QUEUE_H
+#define SERIAL_IMPL_MPSC_QUEUE_H
+
+#include <atomic>
+
+namespace serial {
+
+/*!
+ * Queue of Node objects linked through a `std::atomic<Node*> next` member.
+ * Nodes are owned by the caller; the queue only links them. Node must be
+ * default constructible for the internal stub.
+ */
+template <typename Node>
+class MpscQueue {
+public:
+    MpscQueue()
+        : head_(&stub_)
+        , tail_(&stub_)
+    {
+        stub_.next.store(nullptr, std::memory_order_relaxed);
+    }
+
+    /*! Appends a node, callable from any thread. */
+    void push(Node* node)
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node* previous = head_.exchange(node, std::memory_order_seq_cst);
+        // Between the exchange and this store the chain is briefly broken,
+        // pop() reports nothing until it is linked
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    /*!
+     * Removes the oldest node, consumer only. Returns null when the queue is
+     * empty or the next node is still being linked by a producer.
+     */
+    Node* pop()
+    {
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (tail == &stub_) {
+            if (next == nullptr) {
+                return nullptr;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next != nullptr) {
+            tail_ = next;
+            return tail;
+        }
+        if (tail != head_.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        // tail is the last node, park the stub behind it so tail can go
+        push(&stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            tail_ = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+    /*! True when no push has started since the last pop, consumer only. */
+    bool empty() const
+    {
+        // Any node other than the stub at the tail is still waiting to be
+        // popped
+        return tail_ == &stub_
+            && head_.load(std::memory_order_seq_cst) == &stub_;
+    }
+
+private:
+    MpscQueue(const MpscQueue&);
+    MpscQueue& operator=(const MpscQueue&);
+
+    std::atomic<Node*> head_; // Last pushed node, producers side
+    Node* tail_; // Next node to pop, consumer side
+    Node stub_;
+};
+
+} // namespace serial
+
+#endif // SERIAL_IMPL_MPSC_QUEUE_H
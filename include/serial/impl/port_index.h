@@ -0,0 +1,44 @@
+/*!
+ * \file serial/impl/port_index.h
+ *
+ * \section DESCRIPTION
+ *
+ * Hash index over an enumeration result, used by find_port() and
+ * PortMonitor to look ports up by USB identity without scanning the list.
+ */
+
+#ifndef SERIAL_IMPL_PORT_INDEX_H
+#define SERIAL_IMPL_PORT_INDEX_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "serial/serial.h"
+
+namespace serial {
+
+/*! Immutable once built, so one instance may be shared between threads. */
+class PortIndex {
+public:
+    explicit PortIndex(const std::vector<PortInfo>& ports);
+
+    /*!
+     * Ports with the given vendor and product ID and, unless it is empty,
+     * serial number, ordered by interface number and then port name.
+     */
+    std::vector<PortInfo> find(uint16_t vid, uint16_t pid, const std::string& serial_number) const;
+
+private:
+    // Vendor and product ID as four big endian bytes followed by the serial
+    // number; with an empty serial number it keys every port of the model
+    typedef std::string Key;
+
+    static Key key(uint16_t vid, uint16_t pid, const std::string& serial_number);
+
+    std::unordered_map<Key, std::vector<PortInfo>> ports_;
+};
+
+} // namespace serial
+
+#endif // SERIAL_IMPL_PORT_INDEX_H
@@ -0,0 +1,139 @@
+/*!
+ * \file serial/impl/stats.h
+ *
+ * \section DESCRIPTION
+ *
+ * Per-port I/O counters behind Serial::stats and the latency recorder
+ * behind Serial::latencyStats. The counters are bumped with
+ * relaxed atomic adds on the read/write paths, which costs a few cycles next
+ * to the system call being counted and needs no lock, so stats() and
+ * resetStats() can be called from any thread while a read is blocked.
+ */
+
+#ifndef SERIAL_IMPL_STATS_H
+#define SERIAL_IMPL_STATS_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "serial/latency.h"
+#include "serial/serial.h"
+
+namespace serial {
+
+class StatsCounters {
+public:
+    typedef std::atomic<uint64_t> counter_t;
+
+    static void add(counter_t& counter, uint64_t amount = 1)
+    {
+        counter.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    PortStats snapshot() const
+    {
+        PortStats stats;
+        stats.bytes_read = load(bytes_read);
+        stats.read_calls = load(read_calls);
+        stats.read_timeouts = load(read_timeouts);
+        stats.bytes_written = load(bytes_written);
+        stats.write_calls = load(write_calls);
+        stats.partial_writes = load(partial_writes);
+        stats.write_timeouts = load(write_timeouts);
+        stats.wait_calls = load(read_wait_calls) + load(write_wait_calls);
+        stats.wait_time_ns = load(read_wait_time_ns) + load(write_wait_time_ns);
+        stats.eintr_retries = load(read_eintr_retries) + load(write_eintr_retries);
+        return stats;
+    }
+
+    void reset()
+    {
+        counter_t* counters[] = { &bytes_read, &read_calls, &read_timeouts,
+            &read_wait_calls, &read_wait_time_ns, &read_eintr_retries,
+            &bytes_written, &write_calls, &partial_writes, &write_timeouts,
+            &write_wait_calls, &write_wait_time_ns, &write_eintr_retries };
+        for (counter_t* counter : counters) {
+            counter->store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Reader and writer usually run on different threads, keep their
+    // counters on separate cache lines.
+    alignas(64) counter_t bytes_read { 0 };
+    counter_t read_calls { 0 };
+    counter_t read_timeouts { 0 };
+    counter_t read_wait_calls { 0 };
+    counter_t read_wait_time_ns { 0 };
+    counter_t read_eintr_retries { 0 };
+
+    alignas(64) counter_t bytes_written { 0 };
+    counter_t write_calls { 0 };
+    counter_t partial_writes { 0 };
+    counter_t write_timeouts { 0 };
+    counter_t write_wait_calls { 0 };
+    counter_t write_wait_time_ns { 0 };
+    counter_t write_eintr_retries { 0 };
+
+private:
+    static uint64_t load(const counter_t& counter)
+    {
+        return counter.load(std::memory_order_relaxed);
+    }
+};
+
+/*!
+ * Lock-free counterpart of LatencyStats that the I/O paths record into.
+ * Recording is one relaxed atomic add on the bucket; snapshot() copies the
+ * buckets into plain histograms for percentile queries and export.
+ */
+class LatencyRecorder {
+public:
+    typedef enum {
+        read_first_byte = 0,
+        read,
+        write,
+        wait,
+        histogram_count
+    } histogram_t;
+
+    LatencyRecorder() { reset(); }
+
+    void record(histogram_t histogram, uint64_t nanoseconds)
+    {
+        buckets_[histogram][LatencyHistogram::bucketIndex(nanoseconds)]
+            .fetch_add(1, std::memory_order_relaxed);
+    }
+
+    LatencyStats snapshot() const
+    {
+        LatencyStats stats;
+        LatencyHistogram* histograms[histogram_count] = {
+            &stats.read_first_byte, &stats.read, &stats.write, &stats.wait
+        };
+        for (int histogram = 0; histogram < histogram_count; ++histogram) {
+            for (size_t bucket = 0; bucket < LatencyHistogram::bucket_count; ++bucket) {
+                uint64_t count = buckets_[histogram][bucket].load(std::memory_order_relaxed);
+                if (count != 0) {
+                    histograms[histogram]->add(bucket, count);
+                }
+            }
+        }
+        return stats;
+    }
+
+    void reset()
+    {
+        for (int histogram = 0; histogram < histogram_count; ++histogram) {
+            for (size_t bucket = 0; bucket < LatencyHistogram::bucket_count; ++bucket) {
+                buckets_[histogram][bucket].store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    std::atomic<uint64_t> buckets_[histogram_count][LatencyHistogram::bucket_count];
+};
+
+} // namespace serial
+
+#endif // SERIAL_IMPL_STATS_H
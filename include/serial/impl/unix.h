@@ -41,8 +41,17 @@
 #define SERIAL_IMPL_UNIX_H
 
 #include "serial/serial.h"
+#include "serial/impl/mpsc_queue.h"
+#include "serial/impl/stats.h"
 
 #include <pthread.h>
+#include <termios.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace serial {
 
@@ -53,14 +62,51 @@ using std::invalid_argument;
 using serial::SerialException;
 using serial::IOException;
 
-class MillisecondTimer {
+class Uring;
+
+// Point in time on the monotonic clock after which an operation times out.
+class Deadline {
 public:
-  MillisecondTimer(const uint32_t millis);         
-  int64_t remaining();
+  explicit Deadline (std::chrono::nanoseconds timeout);
+  std::chrono::nanoseconds remaining () const;
 
 private:
-  static timespec timespec_now();
-  timespec expiry;
+  std::chrono::steady_clock::time_point expiry_;
+};
+
+// Progress through a caller's iovec array during readv/writev. The array
+// itself is never modified; a partly transferred buffer is tracked in a
+// private copy of its entry.
+class IoCursor {
+public:
+  IoCursor (const iovec *iov, size_t count);
+
+  // Combined length of all buffers
+  size_t size () const { return size_; }
+  // Bytes transferred so far
+  size_t done () const { return done_; }
+  bool finished () const { return done_ == size_; }
+
+  // The buffers still to transfer, at most IOV_MAX of them. After a partial
+  // transfer this is only the rest of the current buffer.
+  const iovec *pending (int &count) const;
+
+  void advance (size_t bytes);
+
+private:
+  const iovec *iov_;
+  size_t count_;
+  size_t index_;              // Entry of iov_ being transferred
+  iovec current_;             // What is left of iov_[index_]
+  size_t size_;
+  size_t done_;
+};
+
+// One buffer queued by Serial::writeAsync
+struct AsyncWrite {
+  std::vector<uint8_t> data;
+  WriteCallback callback;
+  std::atomic<AsyncWrite *> next;
 };
 
 class serial::Serial::SerialImpl {
@@ -80,27 +126,80 @@ public:
   void
   close ();
 
+  void
+  cancel ();
+
   bool
   isOpen () const;
 
+  int
+  getFd () const;
+
   size_t
   available ();
 
   bool
   waitReadable (uint32_t timeout);
 
+  bool
+  waitReadable (std::chrono::nanoseconds timeout);
+
   void
   waitByteTimes (size_t count);
 
   size_t
   read (uint8_t *buf, size_t size = 1);
 
+  size_t
+  readv (const iovec *iov, size_t count);
+
+  size_t
+  readNonBlocking (uint8_t *buf, size_t size);
+
+  // Puts bytes back in front of the receive buffer, the next read returns
+  // them first
+  void
+  unread (const uint8_t *data, size_t size);
+
+  size_t
+  readline (string &line, size_t size, const string &eol);
+
+  std::vector<string>
+  readlines (size_t size, const string &eol);
+
   size_t
   write (const uint8_t *data, size_t length);
 
+  size_t
+  writev (const iovec *iov, size_t count);
+
+  size_t
+  writePriority (const uint8_t *data, size_t length);
+
+  size_t
+  writeNonBlocking (const uint8_t *data, size_t length);
+
+  void
+  writeAsync (std::vector<uint8_t> data, WriteCallback callback);
+
+  void
+  waitAsyncWrites ();
+
+  // Stops taking writeAsync buffers, stops the writer thread and fails what
+  // is still queued. Must not be called with the write lock held, the
+  // writer takes it to finish its batch.
+  void
+  stopAsyncWriter ();
+
   void
   flush ();
 
+  size_t
+  outputPending ();
+
+  bool
+  waitTransmitted (uint32_t timeout);
+
   void
   flushInput ();
 
@@ -143,9 +242,15 @@ public:
   void
   setTimeout (const Timeout &timeout);
 
+  void
+  setTimeout (const MicrosecondTimeout &timeout);
+
   Timeout
   getTimeout () const;
 
+  MicrosecondTimeout
+  getMicrosecondTimeout () const;
+
   void
   setBaudrate (unsigned long baudrate);
 
@@ -176,6 +281,71 @@ public:
   flowcontrol_t
   getFlowcontrol () const;
 
+  void
+  configure (const PortConfig &config);
+
+  PortConfig
+  getConfig () const;
+
+  void
+  setReadMode (readmode_t readmode);
+
+  readmode_t
+  getReadMode () const;
+
+  void
+  setLowLatency (bool low_latency);
+
+  bool
+  getLowLatency () const;
+
+  void
+  setWritePacing (uint32_t max_queued_ms);
+
+  uint32_t
+  getWritePacing () const;
+
+  PortStats
+  stats () const;
+
+  void
+  resetStats ();
+
+  void
+  setLatencyTracking (bool latency_tracking);
+
+  bool
+  getLatencyTracking () const;
+
+  LatencyStats
+  latencyStats () const;
+
+  // How long a read or write of size bytes may take under the current
+  // timeouts, for IoExecutor which does its own waiting. A readline ends
+  // after readlineTimeout() without new bytes.
+  std::chrono::nanoseconds
+  readTimeout (size_t size) const;
+
+  std::chrono::nanoseconds
+  readlineTimeout () const;
+
+  std::chrono::nanoseconds
+  writeTimeout (size_t size) const;
+
+  // Executor the port is registered with, or null
+  void
+  setExecutor (IoExecutor *executor);
+
+  IoExecutor *
+  getExecutor () const;
+
+  // Reactor the port is registered with, or null
+  void
+  setReactor (Reactor *reactor);
+
+  Reactor *
+  getReactor () const;
+
   void
   readLock ();
 
@@ -191,15 +361,71 @@ public:
 protected:
   void reconfigurePort ();
 
+  size_t readUntil (string &line, size_t size, const string &eol,
+                    bool &eol_found);
+
+  bool pollReadable (std::chrono::nanoseconds timeout);
+
+  size_t readFromBuffer (uint8_t *buf, size_t size);
+
+  size_t readCursor (IoCursor &cursor);
+
+  void readKernel (IoCursor &cursor, const Deadline &total_timeout,
+                   std::chrono::nanoseconds inter_byte_timeout);
+
+  size_t readUring (const iovec *iov, int count,
+                    std::chrono::nanoseconds timeout);
+
+  bool openUring ();
+
+  size_t writeCursor (IoCursor &cursor, bool priority = false);
+
+  void lockWriteChunk ();
+
+  size_t pacedChunk (uint32_t pacing_ms,
+                     std::chrono::nanoseconds timeout_remaining);
+
+  void setReadMinimum (unsigned char vmin);
+
+  void openReadDescriptor ();
+
+  size_t fillReadBuffer ();
+
+  // Closes the ring and every descriptor, returns what closing fd_ did
+  // (-1 with errno set on failure)
+  int closeDescriptors ();
+
+  void closeCancelDescriptors ();
+
+  void clearReadBuffer ();
+
+  void applyLowLatency (bool low_latency);
+
+  void countRead (size_t bytes_read, size_t size);
+
+  void startAsyncWriter ();
+
+  void asyncWriterLoop ();
+
+  void writeBatch (AsyncWrite **batch, size_t count);
+
+  void completeAsyncWrites (AsyncWrite **batch, size_t count,
+                            size_t bytes_written, std::exception_ptr error);
+
 private:
   string port_;               // Path to the file descriptor
   int fd_;                    // The current file descriptor
+  int epoll_fd_;              // Epoll set watching fd_ for readability
+  int read_fd_;               // Blocking descriptor used by readmode_kernel
+  int read_cancel_fd_;        // Eventfds signalled by cancel(), kept open
+  int write_cancel_fd_;       // from construction so cancel() never races close()
+  bool read_cancelled_;       // The last pollReadable was ended by cancel()
 
   bool is_open_;
   bool xonxoff_;
   bool rtscts_;
 
-  Timeout timeout_;           // Timeout for read operations
+  MicrosecondTimeout timeout_; // Timeout for read and write operations
   unsigned long baudrate_;    // Baudrate
   uint32_t byte_time_ns_;     // Nanoseconds to transmit/receive a single byte
 
@@ -207,6 +433,47 @@ private:
   bytesize_t bytesize_;       // Size of the bytes
   stopbits_t stopbits_;       // Stop Bits
   flowcontrol_t flowcontrol_; // Flow Control
+  readmode_t read_mode_;      // How reads wait for data
+  unsigned char read_vmin_;   // VMIN currently applied in readmode_kernel
+  termios termios_;           // Settings last applied, setReadMinimum edits VMIN
+  std::unique_ptr<Uring> uring_; // Ring behind readmode_uring
+  bool uring_cancel_armed_;   // The ring polls read_cancel_fd_
+  bool low_latency_;          // ASYNC_LOW_LATENCY and latency_timer wanted
+  int saved_latency_timer_;   // latency_timer before we changed it, or -1
+
+  // Bytes pulled from the port but not yet handed to the caller, the live
+  // region is [read_buffer_begin_, read_buffer_end_)
+  std::vector<uint8_t> read_buffer_;
+  size_t read_buffer_begin_;
+  size_t read_buffer_end_;
+
+  // Most output queue time writes may build up, 0 when pacing is off
+  std::atomic<uint32_t> write_pacing_ms_;
+  // Held around each bulk write syscall and for a whole writePriority
+  std::mutex write_chunk_mutex_;
+  std::atomic<unsigned> priority_writers_; // writePriority calls waiting or running
+
+  StatsCounters stats_;       // I/O counters behind Serial::stats
+  std::unique_ptr<LatencyRecorder> latency_owner_; // Allocated on first use
+  std::atomic<LatencyRecorder*> latency_; // Recorder in use, or null
+
+  // Background writer behind writeAsync, started on first use
+  MpscQueue<AsyncWrite> write_queue_;
+  std::thread writer_thread_;
+  std::atomic<bool> writer_running_;
+  std::atomic<bool> writer_sleeping_; // Set while the writer waits on writer_wake_
+  std::atomic<bool> writer_stopping_;
+  std::mutex writer_start_mutex_;
+  std::mutex writer_wake_mutex_;
+  std::condition_variable writer_wake_;
+  std::atomic<size_t> async_pending_; // Queued writes not yet completed
+  std::atomic<bool> async_accepting_; // writeAsync takes buffers, set while open
+  std::atomic<unsigned> async_submitters_; // writeAsync calls past that check
+  std::mutex async_idle_mutex_;
+  std::condition_variable async_idle_;
+
+  IoExecutor *executor_;      // Set by IoExecutor::add
+  Reactor *reactor_;          // Set by Reactor::add
 
   // Mutex used to lock the read functions
   pthread_mutex_t read_mutex;
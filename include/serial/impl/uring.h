@@ -0,0 +1,107 @@
+/*!
+ * \file serial/impl/uring.h
+ *
+ * \section DESCRIPTION
+ *
+ * Minimal io_uring ring driven through the raw system calls, so the library
+ * needs neither liburing nor anything newer than the kernel headers. It is
+ * what readmode_uring submits its reads to (Linux only).
+ */
+
+#ifndef SERIAL_IMPL_URING_H
+#define SERIAL_IMPL_URING_H
+
+#if defined(__linux__)
+
+#include <cstddef>
+#include <cstdint>
+
+#include <linux/io_uring.h>
+
+namespace serial {
+
+/*!
+ * One submission and completion queue pair. Not thread safe: a single
+ * owner prepares entries, submits them and reaps the completions.
+ */
+class Uring {
+public:
+    /*!
+     * Sets up a ring with room for entries submissions.
+     *
+     * \throw serial::IOException
+     */
+    explicit Uring(unsigned entries);
+
+    ~Uring();
+
+    Uring(const Uring&) = delete;
+    Uring& operator=(const Uring&) = delete;
+
+    /*!
+     * True when the kernel lets this process set up a ring that has every
+     * operation readmode_uring uses. Probed once, later calls are cheap.
+     */
+    static bool supported();
+
+    /*! Next free submission entry, zeroed, or null when all are taken. */
+    io_uring_sqe* getSqe();
+
+    /*!
+     * Submits the prepared entries and waits for at least wait_count
+     * completions. The wait may end early, after a signal or once the
+     * entries were handed over, so callers reap and call again until what
+     * they wait for has completed.
+     *
+     * \throw serial::IOException
+     */
+    void submit(unsigned wait_count);
+
+    /*! Takes the oldest completion, false when there is none. */
+    bool popCqe(uint64_t& user_data, int32_t& result);
+
+    /*!
+     * Registers the one buffer READ_FIXED entries refer to as index 0,
+     * replacing the previous one. Returns false if the kernel refuses, for
+     * instance over RLIMIT_MEMLOCK; plain reads still work then and later
+     * calls do not try again.
+     */
+    bool registerBuffer(void* base, size_t size);
+
+    /*! True if [base, base + size) lies in the registered buffer. */
+    bool isRegistered(const void* base, size_t size) const;
+
+private:
+    void release();
+
+    int fd_;
+
+    void* sq_ring_;
+    size_t sq_ring_size_;
+    void* cq_ring_; // Same mapping as sq_ring_ with IORING_FEAT_SINGLE_MMAP
+    size_t cq_ring_size_;
+    io_uring_sqe* sqes_;
+    size_t sqes_size_;
+
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned sq_mask_;
+    unsigned sq_entries_;
+    unsigned* sq_array_;
+    unsigned sq_local_tail_; // Entries handed out by getSqe, not yet published
+
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned cq_mask_;
+    io_uring_cqe* cqes_;
+
+    const uint8_t* buffer_base_; // Registered buffer, null if none
+    size_t buffer_size_;
+    bool buffers_refused_;
+};
+
+} // namespace serial
+
+#endif // defined(__linux__)
+
+#endif // SERIAL_IMPL_URING_H
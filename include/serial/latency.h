@@ -0,0 +1,153 @@
+/*!
+ * \file serial/latency.h
+ *
+ * \section LICENSE
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * Log bucketed latency histograms recorded per port, see
+ * serial::Serial::setLatencyTracking.
+ */
+
+#ifndef SERIAL_LATENCY_H
+#define SERIAL_LATENCY_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace serial {
+
+/*!
+ * Histogram of durations in nanoseconds with HDR style log-linear buckets.
+ *
+ * Every power of two range is split into 16 linear sub-buckets, so a
+ * recorded value is known to within 1/16 (about 6%) of itself from 16 ns up
+ * to about 18 minutes; values below 16 ns are exact and longer ones land in
+ * the last bucket. Percentiles report the upper bound of the bucket the
+ * percentile falls in.
+ *
+ * Histograms from several ports, or from several snapshots of one port, can
+ * be combined with merge().
+ */
+class LatencyHistogram {
+public:
+    /*! Sub-buckets per power of two, 2^sub_bucket_bits. */
+    static const unsigned sub_bucket_bits = 4;
+    /*! Values at or above 2^max_bits ns share the last bucket. */
+    static const unsigned max_bits = 40;
+    /*! Number of buckets in every histogram. */
+    static const size_t bucket_count = ((max_bits - sub_bucket_bits + 1) << sub_bucket_bits);
+
+    LatencyHistogram();
+
+    /*! Index of the bucket a duration of nanoseconds falls in. */
+    static size_t bucketIndex(uint64_t nanoseconds)
+    {
+        const uint64_t sub_buckets = uint64_t(1) << sub_bucket_bits;
+        if (nanoseconds < sub_buckets) {
+            return static_cast<size_t>(nanoseconds);
+        }
+        if (nanoseconds >= (uint64_t(1) << max_bits)) {
+            return bucket_count - 1;
+        }
+#if defined(_MSC_VER)
+        unsigned long msb;
+        _BitScanReverse64(&msb, nanoseconds);
+#else
+        unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(nanoseconds));
+#endif
+        unsigned shift = static_cast<unsigned>(msb) - sub_bucket_bits;
+        return ((msb - sub_bucket_bits + 1) << sub_bucket_bits)
+            + static_cast<size_t>((nanoseconds >> shift) & (sub_buckets - 1));
+    }
+
+    /*! Smallest duration in nanoseconds counted by a bucket. */
+    static uint64_t lowerBound(size_t bucket);
+
+    /*! Largest duration in nanoseconds counted by a bucket. */
+    static uint64_t upperBound(size_t bucket);
+
+    /*! Adds one sample. */
+    void record(uint64_t nanoseconds);
+
+    /*! Adds count samples to a bucket, used to fill a histogram from a
+     *  recorder or an export.
+     */
+    void add(size_t bucket, uint64_t count);
+
+    /*! Adds every sample of another histogram to this one. */
+    void merge(const LatencyHistogram& other);
+
+    /*! Number of samples in a bucket. */
+    uint64_t countAt(size_t bucket) const { return counts_[bucket]; }
+
+    /*! Total number of samples. */
+    uint64_t count() const { return total_; }
+
+    /*!
+     * Duration below which the given fraction of samples lie, e.g. 0.99 for
+     * p99 or 0.999 for p999. Returns 0 for an empty histogram.
+     */
+    uint64_t percentile(double fraction) const;
+
+    /*! Upper bound of the highest non-empty bucket, 0 when empty. */
+    uint64_t max() const;
+
+    /*! Removes all samples. */
+    void clear();
+
+private:
+    uint64_t counts_[bucket_count];
+    uint64_t total_;
+};
+
+/*!
+ * Latency histograms of one port, see serial::Serial::latencyStats.
+ */
+struct LatencyStats {
+    /*! From entering a read until the first byte was available. */
+    LatencyHistogram read_first_byte;
+    /*! From entering a read until it returned. */
+    LatencyHistogram read;
+    /*! From entering a write until it returned. */
+    LatencyHistogram write;
+    /*! Time blocked in each readiness wait (epoll/poll/select). */
+    LatencyHistogram wait;
+
+    /*! Adds every histogram of other to the matching one here. */
+    void merge(const LatencyStats& other)
+    {
+        read_first_byte.merge(other.read_first_byte);
+        read.merge(other.read);
+        write.merge(other.write);
+        wait.merge(other.wait);
+    }
+};
+
+} // namespace serial
+
+#endif // SERIAL_LATENCY_H
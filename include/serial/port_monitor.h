@@ -0,0 +1,167 @@
+/*!
+ * \file serial/port_monitor.h
+ *
+ * \section LICENSE
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ * \section DESCRIPTION
+ *
+ * This provides a monitor that keeps the list of serial ports up to date
+ * from kernel hotplug events instead of rescanning /dev and sysfs (Linux
+ * only).
+ */
+
+#ifndef SERIAL_PORT_MONITOR_H
+#define SERIAL_PORT_MONITOR_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "serial/serial.h"
+
+namespace serial {
+
+class PortIndex;
+
+/*!
+ * Port table that follows devices as they come and go. The constructor
+ * enumerates the ports once, as list_ports() does; after that the table is
+ * changed only by the add and remove uevents the kernel broadcasts on a
+ * NETLINK_KOBJECT_UEVENT socket, and only the sysfs entries of the device
+ * that was added are read.
+ *
+ * One thread drives the monitor through run() or runOnce(), which apply
+ * the queued events and invoke the callbacks. ports() and stop() may be
+ * called from any thread, including from inside a callback.
+ *
+ * If the kernel drops events because the socket buffer overflowed, the
+ * monitor enumerates again and reports the difference through the same
+ * callbacks.
+ *
+ * udev makes the /dev/serial/by-id link of a USB port some time after the
+ * kernel announced it, so on_add usually sees an empty by_id_path. While
+ * such a link is missing, for up to a few seconds after the add, runOnce()
+ * wakes at least every 100 ms to look for it and puts it in the table,
+ * where ports() and find() see it. No callback reports that refresh.
+ */
+class PortMonitor {
+public:
+    /*! Called with the port that appeared or disappeared. */
+    typedef std::function<void(const PortInfo&)> PortCallback;
+
+    /*! Set of callbacks, either may be left empty. */
+    struct Callbacks {
+        PortCallback on_add;
+        PortCallback on_remove;
+    };
+
+    /*! Immutable copy of the port table, ordered by port name. */
+    typedef std::shared_ptr<const std::vector<PortInfo>> Snapshot;
+
+    /*!
+     * Subscribes to kernel uevents and enumerates the current ports. The
+     * callbacks are not invoked for ports present at construction.
+     *
+     * \param options Applied to the enumeration and to every port added
+     * later, as list_ports(options) would.
+     *
+     * \throw serial::IOException
+     */
+    explicit PortMonitor(const Callbacks& callbacks = Callbacks(),
+        const ListPortsOptions& options = ListPortsOptions());
+
+    PortMonitor(const PortMonitor&) = delete;
+
+    PortMonitor& operator=(const PortMonitor&) = delete;
+
+    ~PortMonitor();
+
+    /*!
+     * Returns the current ports without touching the filesystem. The
+     * snapshot is shared, not copied, and stays valid and unchanged while
+     * the table moves on.
+     */
+    Snapshot ports() const;
+
+    /*!
+     * Finds ports by USB identity like serial::find_port(), through an
+     * index over the current table that is rebuilt only when it changes.
+     */
+    std::vector<PortInfo> find(uint16_t vid, uint16_t pid,
+        const std::string& serial_number = std::string()) const;
+
+    /*!
+     * Waits up to timeout milliseconds for uevents and applies them.
+     *
+     * \param timeout Milliseconds to wait, Timeout::max() waits until an
+     * event arrives or stop() is called.
+     *
+     * \return The number of ports added or removed.
+     *
+     * \throw serial::IOException
+     */
+    size_t runOnce(uint32_t timeout);
+
+    /*! Applies events until stop() is called. */
+    void run();
+
+    /*! Makes run() return after the current iteration, thread safe. */
+    void stop();
+
+private:
+    struct Change {
+        bool added;
+        PortInfo info;
+    };
+
+    bool receive(std::vector<Change>& changes);
+
+    void rescan(std::vector<Change>& changes);
+
+    bool resolveLinks();
+
+    void publish();
+
+    int socket_fd_; // Netlink socket bound to the kernel uevent group
+    int wake_fd_; // Eventfd used to interrupt poll
+    Callbacks callbacks_;
+    ListPortsOptions options_;
+    std::atomic<bool> stopped_;
+    std::vector<char> buffer_; // Receive buffer for one uevent
+
+    std::map<std::string, PortInfo> table_; // Ports by name, loop thread only
+    // Added USB ports still without a by-id link, with when to stop looking
+    std::map<std::string, std::chrono::steady_clock::time_point> unlinked_;
+
+    mutable std::mutex mutex_; // Guards snapshot_ and index_
+    Snapshot snapshot_;
+    std::shared_ptr<const PortIndex> index_;
+};
+
+} // namespace serial
+
+#endif
@@ -0,0 +1,168 @@
+/*!
+ * \file serial/reactor.h
+ *
+ * \section LICENSE
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * \section DESCRIPTION
+ *
+ * This provides an epoll based event loop that services many open serial
+ * ports from a single thread (Linux only).
+ */
+
+#ifndef SERIAL_REACTOR_H
+#define SERIAL_REACTOR_H
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "serial/serial.h"
+
+namespace serial {
+
+/*!
+ * Event loop that watches many open serial ports on one epoll set and hands
+ * received bytes, errors and modem line changes to per-port callbacks.
+ *
+ * Ports are opened and configured as usual through serial::Serial and then
+ * registered with add(). While registered, a port must not be read from
+ * anywhere else; writing to it from other threads is fine. Closing or
+ * destroying a port unregisters it, as does destroying the reactor.
+ *
+ * One thread drives the loop through run() or runOnce(). add(), remove() and
+ * stop() may be called from any thread, including from inside a callback.
+ */
+class Reactor {
+public:
+    /*! State of the modem input lines of a port. */
+    struct ModemStatus {
+        bool cts;
+        bool dsr;
+        bool ri;
+        bool cd;
+    };
+
+    /*! Called with the bytes read from a port that became readable. */
+    typedef std::function<void(Serial&, const uint8_t*, size_t)> DataCallback;
+
+    /*! Called once when reading a port fails, the port is then removed. */
+    typedef std::function<void(Serial&, const SerialException&)> ErrorCallback;
+
+    /*! Called when one of CTS, DSR, RI or CD changed state. */
+    typedef std::function<void(Serial&, const ModemStatus&)> ModemCallback;
+
+    /*! Set of callbacks for one port, any of them may be left empty. */
+    struct Callbacks {
+        DataCallback on_data;
+        ErrorCallback on_error;
+        ModemCallback on_modem_change;
+    };
+
+    /*!
+     * Creates an empty reactor.
+     *
+     * \param modem_poll_interval Milliseconds between modem line checks for
+     * ports with an on_modem_change callback. The kernel has no readiness
+     * event for modem lines, so they are sampled with TIOCMGET.
+     *
+     * \throw serial::IOException
+     */
+    explicit Reactor(uint32_t modem_poll_interval = 10);
+
+    Reactor(const Reactor&) = delete;
+
+    Reactor& operator=(const Reactor&) = delete;
+
+    ~Reactor();
+
+    /*!
+     * Registers an open port. Bytes already sitting in the port's receive
+     * buffer are delivered on the next loop iteration.
+     *
+     * \throw serial::PortNotOpenedException
+     * \throw serial::SerialException if the port is already registered,
+     * here or with another reactor
+     * \throw serial::IOException
+     */
+    void add(Serial& port, const Callbacks& callbacks);
+
+    /*! Unregisters a port, does nothing if it is not registered. */
+    void remove(Serial& port);
+
+    /*! Returns the number of registered ports. */
+    size_t size() const;
+
+    /*!
+     * Waits up to timeout milliseconds for activity and dispatches the
+     * callbacks of every port that had some.
+     *
+     * \param timeout Milliseconds to wait, Timeout::max() waits until there
+     * is activity or stop() is called.
+     *
+     * \return The number of ports whose callbacks were invoked.
+     *
+     * \throw serial::IOException
+     */
+    size_t runOnce(uint32_t timeout);
+
+    /*! Dispatches events until stop() is called. */
+    void run();
+
+    /*! Makes run() return after the current iteration, thread safe. */
+    void stop();
+
+private:
+    struct Entry;
+
+    std::shared_ptr<Entry> find(int fd);
+
+    // Reads what the port has queued, or after a hangup reads anyway so
+    // the failure is reported
+    void service(const std::shared_ptr<Entry>& entry, bool hangup);
+
+    void pollModemLines();
+
+    void unregister(const std::shared_ptr<Entry>& entry);
+
+    // Unregisters the port of impl, for Serial::close()
+    void detach(Serial::SerialImpl* impl);
+    friend class Serial::SerialImpl;
+
+    int epoll_fd_; // Epoll set watching every registered port
+    int wake_fd_; // Eventfd used to interrupt epoll_wait
+    uint32_t modem_poll_interval_;
+    std::atomic<bool> stopped_;
+
+    mutable std::mutex mutex_; // Guards entries_ and ready_
+    std::map<int, std::shared_ptr<Entry>> entries_; // Registered ports by fd
+    std::vector<int> ready_; // Ports to service without waiting for epoll
+
+    std::vector<uint8_t> buffer_; // Receive buffer shared by all ports
+};
+
+} // namespace serial
+
+#endif
@@ -36,22 +36,47 @@
 #ifndef SERIAL_H
 #define SERIAL_H
 
+#include <atomic>
 #include <cstring>
 #include <exception>
+#include <functional>
+#include <future>
 #include <limits>
+#include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <vector>
 #include <mutex>
 
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<span>)
+#include <span>
+#endif
+#endif
+
 #ifdef _WIN32
 #include "Windows.h"
+#else
+#include <sys/uio.h>
 #endif
 
+#include "serial/latency.h"
+
 #define THROW(exceptionClass, message) throw exceptionClass(__FILE__, \
     __LINE__, (message))
 
+#ifdef _WIN32
+/*!
+ * One buffer of a scatter/gather transfer, laid out like the POSIX struct
+ * of the same name so the readv/writev signatures are the same everywhere.
+ */
+struct iovec {
+    void* iov_base;
+    size_t iov_len;
+};
+#endif
+
 namespace serial {
 
 /*!
@@ -93,6 +118,23 @@ typedef enum {
     flowcontrol_hardware
 } flowcontrol_t;
 
+/*!
+ * Enumeration defines how reads wait for data.
+ *
+ * readmode_poll waits for readiness with epoll/select and then reads what
+ * is available, timing every gap in user space. readmode_kernel maps the
+ * requested size and the inter byte timeout onto termios VMIN/VTIME and
+ * issues blocking reads, so the line discipline collects the bytes and
+ * times the gaps between them. readmode_uring submits each wait as an
+ * io_uring read linked to a timeout, one system call where readmode_poll
+ * makes a wait and a read, with the same results as readmode_poll (Linux).
+ */
+typedef enum {
+    readmode_poll = 0,
+    readmode_kernel,
+    readmode_uring
+} readmode_t;
+
 /*!
  * Structure for setting the timeout of the serial port, times are
  * in milliseconds.
@@ -150,6 +192,204 @@ struct Timeout {
     }
 };
 
+/*!
+ * Microsecond resolution variant of serial::Timeout, for inter-byte and total
+ * timeouts below one millisecond. The fields mean the same as in
+ * serial::Timeout but are in microseconds.
+ *
+ * In order to disable the interbyte timeout, set it to
+ * MicrosecondTimeout::max().
+ */
+struct MicrosecondTimeout {
+    static uint64_t max()
+    {
+        return std::numeric_limits<uint64_t>::max();
+    }
+
+    /*!
+     * Converts a millisecond Timeout, a disabled (Timeout::max()) inter byte
+     * timeout stays disabled.
+     */
+    static MicrosecondTimeout fromTimeout(const Timeout& timeout)
+    {
+        return MicrosecondTimeout(
+            timeout.inter_byte_timeout == Timeout::max() ? max() : timeout.inter_byte_timeout * uint64_t(1000),
+            timeout.read_timeout_constant * uint64_t(1000),
+            timeout.read_timeout_multiplier * uint64_t(1000),
+            timeout.write_timeout_constant * uint64_t(1000),
+            timeout.write_timeout_multiplier * uint64_t(1000));
+    }
+
+    /*! Number of microseconds between bytes received to timeout on. */
+    uint64_t inter_byte_timeout;
+    /*! A constant number of microseconds to wait after calling read. */
+    uint64_t read_timeout_constant;
+    /*! A multiplier against the number of requested bytes to wait after
+     *  calling read.
+     */
+    uint64_t read_timeout_multiplier;
+    /*! A constant number of microseconds to wait after calling write. */
+    uint64_t write_timeout_constant;
+    /*! A multiplier against the number of requested bytes to wait after
+     *  calling write.
+     */
+    uint64_t write_timeout_multiplier;
+
+    explicit MicrosecondTimeout(uint64_t inter_byte_timeout_ = 0,
+        uint64_t read_timeout_constant_ = 0,
+        uint64_t read_timeout_multiplier_ = 0,
+        uint64_t write_timeout_constant_ = 0,
+        uint64_t write_timeout_multiplier_ = 0)
+        : inter_byte_timeout(inter_byte_timeout_)
+        , read_timeout_constant(read_timeout_constant_)
+        , read_timeout_multiplier(read_timeout_multiplier_)
+        , write_timeout_constant(write_timeout_constant_)
+        , write_timeout_multiplier(write_timeout_multiplier_)
+    {
+    }
+
+    /*!
+     * Converts to a millisecond Timeout. Non-zero times are rounded up so a
+     * sub-millisecond timeout does not turn into a non-blocking one.
+     */
+    Timeout toTimeout() const
+    {
+        return Timeout(
+            inter_byte_timeout == max() ? Timeout::max() : toMilliseconds(inter_byte_timeout),
+            toMilliseconds(read_timeout_constant),
+            toMilliseconds(read_timeout_multiplier),
+            toMilliseconds(write_timeout_constant),
+            toMilliseconds(write_timeout_multiplier));
+    }
+
+private:
+    static uint32_t toMilliseconds(uint64_t micros)
+    {
+        uint64_t millis = micros / 1000 + (micros % 1000 != 0 ? 1 : 0);
+        return millis < Timeout::max() ? static_cast<uint32_t>(millis) : Timeout::max();
+    }
+};
+
+/*!
+ * Structure holding the line settings of a serial port, used to change
+ * several of them at once with Serial::configure.
+ */
+struct PortConfig {
+    /*! Baudrate of the port. */
+    uint32_t baudrate;
+    /*! Size of each byte in the serial transmission of data. */
+    bytesize_t bytesize;
+    /*! Method of parity. */
+    parity_t parity;
+    /*! Number of stop bits used. */
+    stopbits_t stopbits;
+    /*! Type of flowcontrol used. */
+    flowcontrol_t flowcontrol;
+
+    explicit PortConfig(uint32_t baudrate_ = 9600,
+        bytesize_t bytesize_ = eightbits,
+        parity_t parity_ = parity_none,
+        stopbits_t stopbits_ = stopbits_one,
+        flowcontrol_t flowcontrol_ = flowcontrol_none)
+        : baudrate(baudrate_)
+        , bytesize(bytesize_)
+        , parity(parity_)
+        , stopbits(stopbits_)
+        , flowcontrol(flowcontrol_)
+    {
+    }
+
+    /*!
+     * Nanoseconds one character occupies on the line: a start bit, the data
+     * bits, a parity bit unless parity is none, and the stop bits.
+     */
+    uint32_t byteTimeNs() const
+    {
+        uint32_t bit_time_ns = baudrate != 0 ? 1000000000u / baudrate : 0;
+        uint32_t bits = 1 + bytesize + (parity == parity_none ? 0 : 1);
+        // stopbits_one_point_five is the enum value 3, not 1.5
+        if (stopbits == stopbits_one_point_five) {
+            return bits * bit_time_ns + bit_time_ns + bit_time_ns / 2;
+        }
+        return (bits + stopbits) * bit_time_ns;
+    }
+
+    bool operator==(const PortConfig& other) const
+    {
+        return baudrate == other.baudrate && bytesize == other.bytesize
+            && parity == other.parity && stopbits == other.stopbits
+            && flowcontrol == other.flowcontrol;
+    }
+
+    bool operator!=(const PortConfig& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+/*!
+ * Snapshot of the I/O counters of a serial port, see Serial::stats.
+ *
+ * All counts are since the port object was created or since the last
+ * Serial::resetStats.
+ */
+struct PortStats {
+    /*! Bytes handed to callers by the read functions. */
+    uint64_t bytes_read;
+    /*! System calls made to pull data from the device. */
+    uint64_t read_calls;
+    /*! Reads that returned fewer bytes than requested because the read
+     *  timeout expired.
+     */
+    uint64_t read_timeouts;
+    /*! Bytes accepted by the device from the write functions. */
+    uint64_t bytes_written;
+    /*! System calls made to push data to the device. */
+    uint64_t write_calls;
+    /*! Write system calls that accepted fewer bytes than offered. */
+    uint64_t partial_writes;
+    /*! Writes that returned early because the write timeout expired. */
+    uint64_t write_timeouts;
+    /*! Readiness waits (epoll/poll/select) issued by reads and writes. */
+    uint64_t wait_calls;
+    /*! Nanoseconds spent blocked in those readiness waits. */
+    uint64_t wait_time_ns;
+    /*! System calls interrupted by a signal and retried. */
+    uint64_t eintr_retries;
+
+    PortStats()
+        : bytes_read(0)
+        , read_calls(0)
+        , read_timeouts(0)
+        , bytes_written(0)
+        , write_calls(0)
+        , partial_writes(0)
+        , write_timeouts(0)
+        , wait_calls(0)
+        , wait_time_ns(0)
+        , eintr_retries(0)
+    {
+    }
+};
+
+/*!
+ * Completion callback of Serial::writeAsync. Receives the number of bytes
+ * the port accepted, fewer than queued if the write timed out, and the
+ * exception that ended the write, or null on success or timeout.
+ */
+typedef std::function<void(size_t bytes_written, std::exception_ptr error)> WriteCallback;
+
+class IoExecutor;
+class Reactor;
+class LatencyRecorder;
+class StatsCounters;
+
+#if defined(__cpp_impl_coroutine) && !defined(_WIN32)
+class ReadAwaitable;
+class ReadUntilAwaitable;
+class WriteAwaitable;
+#endif
+
 /*!
  * Class that provides a portable serial port interface.
  */
@@ -228,6 +468,23 @@ public:
     /*! Closes the serial port. */
     void close();
 
+    /*! Wakes a read and a write blocked on this port from another thread.
+     *
+     * The woken calls return what they transferred so far, as if their
+     * timeout had expired; this includes readline, readlines and
+     * waitTransmitted. If no read (or write) is blocked, the next one that
+     * has to wait returns right away instead, so a thread that checks a
+     * shutdown flag and then reads cannot miss the wakeup. A cancel does
+     * not carry over when the port is reopened.
+     *
+     * Use it to stop reader threads before close(), which must not run
+     * while another thread is inside a read or write.
+     *
+     * On Windows pending ReadFile and WriteFile calls are cancelled with
+     * CancelIoEx, a cancel with no call blocked has no effect.
+     */
+    void cancel();
+
     /*! Return the number of characters in the buffer. */
     size_t available();
 
@@ -235,7 +492,7 @@ public:
      * number of milliseconds have elapsed. The return value is true when
      * the function exits with the port in a readable state, false otherwise
      * (due to timeout or select interruption). */
-    bool Serial::waitReadable()
+    bool waitReadable()
     {
         return waitReadable(getTimeout().read_timeout_constant);
     }
@@ -276,7 +533,57 @@ public:
      */
     size_t read(uint8_t* buffer, size_t size);
 
+#ifdef __cpp_lib_span
+    /*! Read up to buffer.size() bytes from the serial port into a buffer.
+     *
+     * \param buffer A std::span of uint8_t to fill.
+     *
+     * \return A size_t representing the number of bytes read as a result of the
+     *         call to read.
+     *
+     * \throw serial::PortNotOpenedException
+     * \throw serial::SerialException
+     */
+    size_t read(std::span<uint8_t> buffer)
+    {
+        return read(buffer.data(), buffer.size());
+    }
+#endif
+
+    /*! Read into several buffers, filling each one before the next.
+     *
+     * Behaves like read() for the combined size of the buffers, with the
+     * same timeouts, but scatters the bytes with readv() so a frame can be
+     * split into header, payload and trailer without a copy.
+     *
+     * On Windows the buffers are read one after another, each with its own
+     * read timeout.
+     *
+     * \param iov The buffers to fill, in order.
+     * \param count The number of entries in iov.
+     *
+     * \return A size_t representing the total number of bytes read.
+     *
+     * \throw serial::PortNotOpenedException
+     * \throw serial::SerialException
+     */
+    size_t readv(const iovec* iov, size_t count);
+
+#ifdef __cpp_lib_span
+    /*! Read into several buffers, filling each one before the next.
+     *
+     * \see Serial::readv
+     */
+    size_t readv(std::span<const iovec> iov)
+    {
+        return readv(iov.data(), iov.size());
+    }
+#endif
+
     /*! Read a given amount of bytes from the serial port into a give buffer.
+     *
+     * The data is appended to the vector by reading straight into its tail,
+     * no temporary buffer is allocated when the capacity suffices.
      *
      * \param buffer A reference to a std::vector of uint8_t.
      * \param size A size_t defining how many bytes to be read.
@@ -289,16 +596,27 @@ public:
      */
     size_t read(std::vector<uint8_t>& buffer, size_t size = 1)
     {
-        std::unique_ptr<uint8_t[]> tmp = std::make_unique<uint8_t[]>(size);
+        size_t offset = buffer.size();
+        buffer.resize(offset + size);
 
-        size_t bytes_read = read(tmp.get(), size);
+        size_t bytes_read = 0;
+        try {
+            bytes_read = read(buffer.data() + offset, size);
+        }
+        catch (...) {
+            buffer.resize(offset);
+            throw;
+        }
 
-        buffer.insert(buffer.end(), tmp.get(), tmp.get() + bytes_read);
+        buffer.resize(offset + bytes_read);
 
         return bytes_read;
     }
 
     /*! Read a given amount of bytes from the serial port into a give buffer.
+     *
+     * The data is appended to the string by reading straight into its tail,
+     * no temporary buffer is allocated when the capacity suffices.
      *
      * \param buffer A reference to a std::string.
      * \param size A size_t defining how many bytes to be read.
@@ -311,11 +629,19 @@ public:
      */
     size_t read(std::string& buffer, size_t size = 1)
     {
-        std::unique_ptr<uint8_t[]> tmp = std::make_unique<uint8_t[]>(size);
+        size_t offset = buffer.size();
+        buffer.resize(offset + size);
 
-        size_t bytes_read = read(tmp.get(), size);
+        size_t bytes_read = 0;
+        try {
+            bytes_read = read(reinterpret_cast<uint8_t*>(&buffer[0]) + offset, size);
+        }
+        catch (...) {
+            buffer.resize(offset);
+            throw;
+        }
 
-        buffer.append(reinterpret_cast<const char*>(tmp.get()), bytes_read);
+        buffer.resize(offset + bytes_read);
 
         return bytes_read;
     }
@@ -339,7 +665,9 @@ public:
 
     /*! Reads in a line or until a given delimiter has been processed.
      *
-     * Reads from the serial port until a single line has been read.
+     * Reads from the serial port until a single line has been read. Data is
+     * pulled from the port in chunks into an internal receive buffer, any
+     * bytes following the delimiter are kept there for the next read call.
      *
      * \param buffer A std::string reference used to store the data.
      * \param size A maximum length of a line, defaults to 65536 (2^16)
@@ -350,30 +678,7 @@ public:
      * \throw serial::PortNotOpenedException
      * \throw serial::SerialException
      */
-    size_t readline(std::string& line, size_t size = 65536, std::string eol = "\n")
-    {
-        std::unique_ptr<uint8_t[]> tmp = std::make_unique<uint8_t[]>(size * sizeof(uint8_t));
-
-        size_t read_so_far = 0;
-
-        while (read_so_far < size) {
-            size_t bytes_read = read(tmp.get() + read_so_far, 1);
-
-            if (bytes_read == 0) {
-                break; // Timeout occured on reading 1 byte
-            }
-
-            read_so_far += bytes_read;
-
-            if (std::string(reinterpret_cast<const char*>(tmp.get() + read_so_far - eol.length()), eol.length()) == eol) {
-                break; // EOL found
-            }
-        }
-
-        line.append(reinterpret_cast<const char*>(tmp.get()), read_so_far);
-
-        return read_so_far;
-    }
+    size_t readline(std::string& line, size_t size = 65536, std::string eol = "\n");
 
     /*! Reads in a line or until a given delimiter has been processed.
      *
@@ -408,45 +713,7 @@ public:
      * \throw serial::PortNotOpenedException
      * \throw serial::SerialException
      */
-    std::vector<std::string> readlines(size_t size = 65536, std::string eol = "\n")
-    {
-        std::vector<std::string> lines;
-
-        std::unique_ptr<uint8_t[]> tmp = std::make_unique<uint8_t[]>(size * sizeof(uint8_t));
-
-        size_t read_so_far = 0;
-        size_t start_of_line = 0;
-
-        while (read_so_far < size) {
-            size_t bytes_read = read(tmp.get() + read_so_far, 1);
-
-            read_so_far += bytes_read;
-
-            if (bytes_read == 0) {
-                if (start_of_line != read_so_far) {
-                    lines.push_back(std::string(reinterpret_cast<const char*>(tmp.get() + start_of_line), read_so_far - start_of_line));
-                }
-
-                break; // Timeout occured on reading 1 byte
-            }
-
-            if (std::string(reinterpret_cast<const char*>(tmp.get() + read_so_far - eol.length()), eol.length()) == eol) {
-                // EOL found
-                lines.push_back(std::string(reinterpret_cast<const char*>(tmp.get() + start_of_line), read_so_far - start_of_line));
-                start_of_line = read_so_far;
-            }
-
-            if (read_so_far == size) {
-                if (start_of_line != read_so_far) {
-                    lines.push_back(std::string(reinterpret_cast<const char*>(tmp.get() + start_of_line), read_so_far - start_of_line));
-                }
-
-                break; // Reached the maximum read length
-            }
-        }
-
-        return lines;
-    }
+    std::vector<std::string> readlines(size_t size = 65536, std::string eol = "\n");
 
     /*! Write a string to the serial port.
      *
@@ -479,8 +746,26 @@ public:
      */
     size_t write(const std::vector<uint8_t>& data)
     {
-        return write(&data[0], data.size());
+        return write(data.data(), data.size());
+    }
+
+#ifdef __cpp_lib_span
+    /*! Write a data buffer to the serial port.
+     *
+     * \param data A std::span of the bytes to be written to the serial port.
+     *
+     * \return A size_t representing the number of bytes actually written to
+     * the serial port.
+     *
+     * \throw serial::PortNotOpenedException
+     * \throw serial::SerialException
+     * \throw serial::IOException
+     */
+    size_t write(std::span<const uint8_t> data)
+    {
+        return write(data.data(), data.size());
     }
+#endif
 
     /*! Write a string to the serial port.
      *
@@ -499,6 +784,165 @@ public:
         return write(reinterpret_cast<const uint8_t*>(data.c_str()), data.length());
     }
 
+    /*! Write urgent data ahead of paced bulk writes.
+     *
+     * Does not wait for the write lock a bulk write() holds for its whole
+     * duration; it waits at most for the single write() syscall in flight
+     * and then goes out unpaced. With write pacing on, this bounds the
+     * delay of a command queued behind a firmware image to the pacing
+     * budget. Priority writes are serialized with each other.
+     *
+     * On Windows this is the same as write().
+     *
+     * \param data The bytes to write.
+     * \param size The number of bytes to write.
+     *
+     * \return A size_t representing the number of bytes actually written to
+     * the serial port.
+     *
+     * \throw serial::PortNotOpenedException
+     * \throw serial::SerialException
+     * \throw serial::IOException
+     */
+    size_t writePriority(const uint8_t* data, size_t size);
+
+    /*! Write an urgent string ahead of paced bulk writes.
+     *
+     * \see Serial::writePriority
+     */
+    size_t writePriority(const std::string& data)
+    {
+        return writePriority(reinterpret_cast<const uint8_t*>(data.c_str()), data.length());
+    }
+
+    /*! Write several buffers back to back, as if they were one.
+     *
+     * Behaves like write() for the combined size of the buffers, with the
+     * same timeout, but gathers them with writev() so a header, payload and
+     * checksum held apart need not be copied into one buffer first.
+     *
+     * On Windows the buffers are written one after another, each with its
+     * own write timeout.
+     *
+     * \param iov The buffers to write, in order.
+     * \param count The number of entries in iov.
+     *
+     * \return A size_t representing the total number of bytes written.
+     *
+     * \throw serial::PortNotOpenedException
+     * \throw serial::SerialException
+     * \throw serial::IOException
+     */
+    size_t writev(const iovec* iov, size_t count);
+
+#ifdef __cpp_lib_span
+    /*! Write several buffers back to back, as if they were one.
+     *
+     * \see Serial::writev
+     */
+    size_t writev(std::span<const iovec> iov)
+    {
+        return writev(iov.data(), iov.size());
+    }
+#endif
+
+    /*! Queues a buffer to be written in the background and returns at once.
+     *
+     * A writer thread, started on first use, drains the queue and merges
+     * adjacent buffers into single writev() calls. Buffers are written in
+     * the order they were queued, from any number of threads, and never
+     * interleave with a concurrent write(). Each merged batch is bounded by
+     * the write timeout for its combined size.
+     *
+     * The callback runs on the writer thread once the buffer was written,
+     * timed out or failed; it must not block for long and exceptions it
+     * throws are swallowed. Buffers still queued when the port is closed
+     * complete with a serial::PortNotOpenedException.
+     *
+     * On Windows the write happens synchronously before returning.
+     *
+     * \param data The bytes to write, moved into the queue.
+     * \param callback Called with the outcome. \see serial::WriteCallback
+     *
+     * \throw serial::PortNotOpenedException
+     */
+    void writeAsync(std::vector<uint8_t> data, WriteCallback callback);
+
+    /*! Queues a buffer to be written in the background.
+     *
+     * \return A future for the number of bytes written, which holds the
+     * exception instead if the write failed. \see Serial::writeAsync
+     *
+     * \throw serial::PortNotOpenedException
+     */
+    std::future<size_t> writeAsync(std::vector<uint8_t> data)
+    {
+        std::shared_ptr<std::promise<size_t> > promise = std::make_shared<std::promise<size_t> >();
+        std::future<size_t> result = promise->get_future();
+        writeAsync(std::move(data), [promise](size_t bytes_written, std::exception_ptr error) {
+            if (error) {
+                promise->set_exception(error);
+            }
+            else {
+                promise->set_value(bytes_written);
+            }
+        });
+        return result;
+    }
+
+    /*! Queues a string to be written in the background.
+     *
+     * \see Serial::writeAsync
+     *
+     * \throw serial::PortNotOpenedException
+     */
+    std::future<size_t> writeAsync(const std::string& data)
+    {
+        return writeAsync(std::vector<uint8_t>(data.begin(), data.end()));
+    }
+
+    /*! Blocks until every buffer queued with writeAsync has completed. */
+    void waitAsyncWrites();
+
+#if defined(__cpp_impl_coroutine) && !defined(_WIN32)
+    /*! Reads size bytes when awaited in a coroutine.
+     *
+     * The port must be registered with a serial::IoExecutor, which resumes
+     * the coroutine on its thread. The result is the number of bytes read,
+     * fewer than size if the read timed out. Defined in serial/coroutine.h.
+     *
+     * \throw serial::SerialException if the port is not registered
+     */
+    inline ReadAwaitable asyncRead(uint8_t* buffer, size_t size);
+
+#ifdef __cpp_lib_span
+    /*! Reads buffer.size() bytes when awaited. \see Serial::asyncRead */
+    inline ReadAwaitable asyncRead(std::span<uint8_t> buffer);
+#endif
+
+    /*! Reads a line when awaited in a coroutine.
+     *
+     * The result ends with eol unless size bytes were read or the line
+     * timed out like readline(). Bytes after eol stay buffered for the next
+     * read. Defined in serial/coroutine.h.
+     *
+     * \throw serial::SerialException if the port is not registered
+     */
+    inline ReadUntilAwaitable asyncReadUntil(std::string eol = "\n", size_t size = 65536);
+
+    /*! Writes data when awaited in a coroutine.
+     *
+     * The result is the number of bytes written, fewer than data.size() if
+     * the write timed out. Defined in serial/coroutine.h.
+     *
+     * \throw serial::SerialException if the port is not registered
+     */
+    inline WriteAwaitable asyncWrite(std::vector<uint8_t> data);
+
+    /*! Writes a string when awaited. \see Serial::asyncWrite */
+    inline WriteAwaitable asyncWrite(const std::string& data);
+#endif
+
     /*! Sets the serial port identifier.
      *
      * \param port A const std::string reference containing the address of the
@@ -555,6 +999,14 @@ public:
      */
     void setTimeout(const Timeout& timeout);
 
+    /*! Sets the timeout for reads and writes with microsecond resolution.
+     *
+     * Behaves like setTimeout(const Timeout&) with all times given in
+     * microseconds, see serial::MicrosecondTimeout. Platforms without
+     * sub-millisecond timers round non-zero times up to whole milliseconds.
+     */
+    void setTimeout(const MicrosecondTimeout& timeout);
+
     /*! Sets the timeout for reads and writes. */
     void setTimeout(uint32_t inter_byte_timeout, uint32_t read_timeout_constant,
         uint32_t read_timeout_multiplier, uint32_t write_timeout_constant,
@@ -575,6 +1027,12 @@ public:
      */
     Timeout getTimeout() const;
 
+    /*! Gets the timeout for reads and writes in microseconds.
+     *
+     * \see Serial::setTimeout
+     */
+    MicrosecondTimeout getMicrosecondTimeout() const;
+
     /*! Sets the baudrate for the serial port.
      *
      * Possible baudrates depends on the system but some safe baudrates include:
@@ -669,9 +1127,170 @@ public:
      */
     flowcontrol_t getFlowcontrol() const;
 
+    /*! Sets baudrate, bytesize, parity, stopbits and flowcontrol together.
+     *
+     * Each individual setter reprograms an open port on its own, so changing
+     * several of them costs one termios round trip each and passes the line
+     * through every intermediate setting. configure applies the whole set
+     * with a single commit and does nothing if it matches the current one.
+     * If the port rejects the new settings the previous ones are kept.
+     *
+     * \param config The settings to apply. \see serial::PortConfig
+     *
+     * \throw std::invalid_argument
+     * \throw serial::IOException
+     */
+    void configure(const PortConfig& config);
+
+    /*! Gets the line settings of the serial port.
+     *
+     * \see Serial::configure
+     */
+    PortConfig getConfig() const;
+
+    /*! Sets how reads wait for data.
+     *
+     * In readmode_kernel the inter byte timeout is enforced by the tty line
+     * discipline via VTIME, which counts in tenths of a second: non-zero
+     * inter byte timeouts are rounded up to 100 ms steps, capped at 25.5 s.
+     * Requests are then collected up to 255 bytes (VMIN) per system call.
+     * The total timeout still bounds the wait for the first byte of each
+     * chunk. Without an inter byte timeout (0 or Timeout::max()) each read
+     * returns what has arrived, as in readmode_poll.
+     *
+     * readmode_uring falls back to readmode_poll where io_uring is missing
+     * or disabled (older kernels, kernel.io_uring_disabled, seccomp), and
+     * on other platforms; getReadMode() reports the mode in use. Each port
+     * gets its own small ring, the receive buffer behind readline is
+     * registered with it.
+     *
+     * \param readmode Read mode, default is readmode_poll, possible values
+     * are: readmode_poll, readmode_kernel, readmode_uring
+     *
+     * \throw std::invalid_argument if the OS does not support the mode
+     * \throw serial::IOException
+     */
+    void setReadMode(readmode_t readmode);
+
+    /*! Gets the read mode of the serial port.
+     *
+     * \see Serial::setReadMode
+     */
+    readmode_t getReadMode() const;
+
+    /*! Trades throughput for latency on the port.
+     *
+     * Sets ASYNC_LOW_LATENCY on the tty so received bytes are pushed to the
+     * reader immediately instead of on the next flip buffer tick. For
+     * USB serial adapters that expose a sysfs latency_timer (FTDI and
+     * compatibles, default 16 ms) the timer is set to 1 ms; the previous
+     * value is restored when low latency is turned off or the port is
+     * closed. Writing latency_timer usually needs elevated permissions.
+     *
+     * The setting is remembered and applied again whenever the port is
+     * opened. Drivers without either knob are left untouched.
+     *
+     * \param low_latency true to enable, default is false
+     *
+     * \throw std::invalid_argument if the OS does not support low latency
+     * \throw serial::IOException
+     */
+    void setLowLatency(bool low_latency);
+
+    /*! Gets the low latency setting of the serial port.
+     *
+     * \see Serial::setLowLatency
+     */
+    bool getLowLatency() const;
+
+    /*! Limits how much written data may wait in the driver's output queue.
+     *
+     * With pacing on, writes are metered so that the output queue
+     * (\see Serial::outputPending) never holds more than max_queued_ms
+     * worth of bytes at the current settings. A bulk write then keeps the
+     * queue short instead of filling it with seconds of data, and
+     * writePriority() data goes out after at most that much. Time spent
+     * waiting for the queue to drain counts against the write timeout.
+     *
+     * \param max_queued_ms The budget in milliseconds, 0 turns pacing off
+     * (the default).
+     *
+     * \throw std::invalid_argument if the OS does not support write pacing
+     */
+    void setWritePacing(uint32_t max_queued_ms);
+
+    /*! Gets the write pacing budget in milliseconds, 0 when off.
+     *
+     * \see Serial::setWritePacing
+     */
+    uint32_t getWritePacing() const;
+
+    /*! Returns a snapshot of the port's I/O counters.
+     *
+     * Comparing bytes against calls and wait time tells whether a slow port
+     * is limited by the baudrate, by kernel buffering or by the read
+     * pattern. Safe to call from any thread, also while a read or write is
+     * blocked. \see serial::PortStats
+     */
+    PortStats stats() const;
+
+    /*! Sets all of the port's I/O counters and latency histograms back to
+     *  zero.
+     */
+    void resetStats();
+
+    /*! Turns recording of the latency histograms on or off.
+     *
+     * While on, every read, readline and write records how long it took,
+     * reads also record how long until their first byte was available, and
+     * every readiness wait records how long it blocked. Recording costs two
+     * clock reads and one atomic add per histogram; while off it costs a
+     * single pointer check. The histograms are kept when recording is turned
+     * off. Default is off.
+     *
+     * \param latency_tracking true to record, default is false
+     */
+    void setLatencyTracking(bool latency_tracking);
+
+    /*! Gets whether latency histograms are being recorded.
+     *
+     * \see Serial::setLatencyTracking
+     */
+    bool getLatencyTracking() const;
+
+    /*! Returns a snapshot of the port's latency histograms, empty if
+     *  tracking was never turned on. \see serial::LatencyStats
+     */
+    LatencyStats latencyStats() const;
+
     /*! Flush the input and output buffers */
     void flush();
 
+    /*! Return the number of bytes written but not yet sent by the driver.
+     *
+     * Producers can use this for backpressure, holding off while the kernel
+     * output queue is deeper than they want to wait behind.
+     *
+     * \throw serial::PortNotOpenedException
+     * \throw serial::IOException
+     */
+    size_t outputPending();
+
+    /*! Block until everything written so far has left the port, or until
+     * timeout milliseconds have elapsed.
+     *
+     * Unlike flush(), the wait is bounded. While the output queue is non
+     * empty the port is polled at intervals estimated from the queue depth
+     * and the byte time of the current settings. Once the queue is empty,
+     * tcdrain() waits for the few bytes left in the UART.
+     *
+     * \return true if the output queue drained, false on timeout.
+     *
+     * \throw serial::PortNotOpenedException
+     * \throw serial::IOException
+     */
+    bool waitTransmitted(uint32_t timeout);
+
     /*! Flush only the input buffer */
     void flushInput();
 
@@ -738,8 +1357,18 @@ private:
 
 #if _WIN32
     HANDLE fd_;
+    std::unique_ptr<StatsCounters> stats_; // I/O counters behind stats()
+    std::unique_ptr<LatencyRecorder> latency_owner_; // Allocated on first use
+    std::atomic<LatencyRecorder*> latency_; // Recorder in use, or null
 #else
+    class SerialImpl;
+    std::unique_ptr<SerialImpl> pimpl_; // Platform specific implementation
 
+    class ScopedReadLock;
+    class ScopedWriteLock;
+
+    friend class Reactor;
+    friend class IoExecutor;
 #endif
 };
 
@@ -751,7 +1380,7 @@ public:
     {
     }
 
-    const char* what() const override { return m_message.c_str(); }
+    const char* what() const noexcept override { return m_message.c_str(); }
 
 protected:
     std::string m_message;
@@ -811,6 +1440,25 @@ struct PortInfo {
 
     /*! Hardware ID (e.g. VID:PID of USB serial devices) or "n/a" if not available. */
     std::string hardware_id;
+
+    /*! USB vendor ID, 0 if the device is not a USB device or it is unknown. */
+    uint16_t vid = 0;
+
+    /*! USB product ID, 0 if the device is not a USB device or it is unknown. */
+    uint16_t pid = 0;
+
+    /*! USB serial number string, empty if the device has none. */
+    std::string serial_number;
+
+    /*! USB interface the port belongs to, -1 if unknown. Multi-port
+     *  adapters report one port per interface under the same serial number. */
+    int interface_number = -1;
+
+    /*! Kernel driver bound to the port, e.g. "ftdi_sio" or "cdc_acm" (Linux). */
+    std::string driver;
+
+    /*! Stable /dev/serial/by-id link to the port, empty if udev made none (Linux). */
+    std::string by_id_path;
 };
 
 /* Lists the serial ports available on the system
@@ -822,6 +1470,104 @@ struct PortInfo {
  */
 std::vector<PortInfo> list_ports();
 
+/*!
+ * Options for list_ports(const ListPortsOptions&).
+ */
+struct ListPortsOptions {
+
+    /*! Leave out legacy UART ports the kernel registered without finding
+     *  hardware behind them, such as most of /dev/ttyS0 to /dev/ttyS31 on
+     *  Linux. Decided from the UART type in sysfs, or by asking the driver
+     *  with TIOCGSERIAL where sysfs does not tell; ports whose type cannot
+     *  be read are kept. */
+    bool present_only = false;
+};
+
+/*!
+ * Lists the serial ports available on the system, as list_ports(), with
+ * the given options applied.
+ */
+std::vector<PortInfo> list_ports(const ListPortsOptions& options);
+
+/*!
+ * Finds the ports of the USB device with the given vendor and product ID
+ * and, unless it is empty, serial number.
+ *
+ * Lookups go through a hash index over the last enumeration. On Linux the
+ * index is rebuilt only when the device nodes in /dev changed since, so
+ * repeated lookups do not walk sysfs; elsewhere every call enumerates.
+ *
+ * \return The matching ports ordered by interface number, empty if none.
+ */
+std::vector<PortInfo> find_port(uint16_t vid, uint16_t pid,
+    const std::string& serial_number = std::string());
+
+/*!
+ * Describes one port for open_all(), with the settings the Serial
+ * constructor takes.
+ */
+struct PortSpec {
+
+    /*! Address of the serial port, as passed to the Serial constructor. */
+    std::string port;
+
+    uint32_t baudrate = 9600;
+
+    Timeout timeout = Timeout();
+
+    bytesize_t bytesize = eightbits;
+
+    parity_t parity = parity_none;
+
+    stopbits_t stopbits = stopbits_one;
+
+    flowcontrol_t flowcontrol = flowcontrol_none;
+
+    /*! Optional further configuration (read mode, modem lines, ...), run
+     *  on the opening thread right after the port was opened. An exception
+     *  it throws fails the port. */
+    std::function<void(Serial&)> setup;
+};
+
+/*!
+ * Outcome of opening one port with open_all().
+ */
+struct OpenResult {
+
+    /*! The open port, null if opening or setting it up failed. */
+    std::unique_ptr<Serial> serial;
+
+    /*! Why the port failed, null if it is open. */
+    std::exception_ptr error;
+};
+
+/*!
+ * Opens and configures many ports concurrently, so bringing up a large
+ * set takes about as long as the slowest port rather than the sum of all.
+ *
+ * \param specs The ports to open.
+ * \param count Number of entries in specs.
+ * \param max_threads Upper bound on the ports being opened at once, 0
+ * picks a default of 16. Opening mostly waits on drivers, so this is not
+ * tied to the number of CPUs.
+ *
+ * \return One result per spec, in the same order. Failures do not affect
+ * the other ports.
+ */
+std::vector<OpenResult> open_all(const PortSpec* specs, size_t count, size_t max_threads = 0);
+
+/*! \see open_all(const PortSpec*, size_t, size_t) */
+std::vector<OpenResult> open_all(const std::vector<PortSpec>& specs, size_t max_threads = 0);
+
+#ifdef __cpp_lib_span
+/*! \see open_all(const PortSpec*, size_t, size_t) */
+inline std::vector<OpenResult>
+open_all(std::span<const PortSpec> specs, size_t max_threads = 0)
+{
+    return open_all(specs.data(), specs.size(), max_threads);
+}
+#endif
+
 } // namespace serial
 
 #endif
@@ -0,0 +1,532 @@
+/* Epoll based executor for asynchronous port I/O, see serial/executor.h */
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <climits>
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "serial/executor.h"
+#include "serial/impl/delimiter.h"
+#include "serial/impl/unix.h"
+
+using serial::find_delimiter;
+using serial::IoExecutor;
+using serial::IOException;
+using serial::PortNotOpenedException;
+using serial::Serial;
+using serial::SerialException;
+using std::unique_ptr;
+
+// Upper bound on the events taken from epoll per iteration
+static const int max_events = 64;
+
+// Bytes requested from the port per read while looking for a delimiter
+static const size_t line_chunk_size = 4096;
+
+struct IoExecutor::Operation {
+    enum Kind {
+        read,
+        read_until,
+        write
+    };
+
+    Kind kind;
+    Port* port;
+    uint8_t* buffer; // read
+    const uint8_t* data; // write
+    size_t size;
+    size_t done;
+    std::string line; // read_until
+    std::string eol;
+    size_t scanned; // Bytes of line already searched for eol
+    Handler handler;
+    LineHandler line_handler;
+    bool timed; // timer is valid
+    Timers::iterator timer;
+};
+
+struct IoExecutor::Port {
+    Serial::SerialImpl* impl;
+    int fd;
+    uint32_t events; // Events the epoll set watches, 0 when not in the set
+    bool hangup; // Epoll reported EPOLLHUP or EPOLLERR this iteration
+    unique_ptr<Operation> read;
+    unique_ptr<Operation> write;
+};
+
+IoExecutor::IoExecutor()
+    : epoll_fd_(-1)
+    , wake_fd_(-1)
+    , stopped_(false)
+    , pending_(0)
+{
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ == -1) {
+        THROW(IOException, errno);
+    }
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ == -1) {
+        int error = errno;
+        ::close(epoll_fd_);
+        THROW(IOException, error);
+    }
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = wake_fd_;
+    if (-1 == epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event)) {
+        int error = errno;
+        ::close(wake_fd_);
+        ::close(epoll_fd_);
+        THROW(IOException, error);
+    }
+}
+
+IoExecutor::~IoExecutor()
+{
+    // Pending operations fail instead of being dropped, so the coroutines
+    // waiting on them resume
+    std::vector<std::function<void()>> completions;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::exception_ptr error = std::make_exception_ptr(
+            SerialException("IoExecutor destroyed, operation cancelled"));
+        for (auto& item : ports_) {
+            Port& entry = *item.second;
+            if (entry.read) {
+                finish(entry, entry.read, error);
+            }
+            if (entry.write) {
+                finish(entry, entry.write, error);
+            }
+            entry.impl->setExecutor(NULL);
+        }
+        ports_.clear();
+        completions.swap(completions_);
+    }
+    for (size_t i = 0; i < completions.size(); ++i) {
+        try {
+            completions[i]();
+        }
+        catch (...) {
+            // Nobody to rethrow to from a destructor
+        }
+    }
+    ::close(wake_fd_);
+    ::close(epoll_fd_);
+}
+
+void IoExecutor::add(Serial& port)
+{
+    if (!port.isOpen()) {
+        throw PortNotOpenedException("IoExecutor::add");
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (port.pimpl_->getExecutor() != NULL) {
+        throw SerialException("IoExecutor::add port already registered");
+    }
+    unique_ptr<Port> entry(new Port);
+    entry->impl = port.pimpl_.get();
+    entry->fd = port.pimpl_->getFd();
+    entry->events = 0;
+    entry->hangup = false;
+    ports_[entry->fd] = std::move(entry);
+    port.pimpl_->setExecutor(this);
+}
+
+void IoExecutor::remove(Serial& port)
+{
+    detach(port.pimpl_.get(), std::make_exception_ptr(
+                                  SerialException("IoExecutor::remove operation cancelled")));
+}
+
+void IoExecutor::detach(Serial::SerialImpl* impl, std::exception_ptr error)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = ports_.begin(); it != ports_.end(); ++it) {
+        Port& entry = *it->second;
+        if (entry.impl != impl) {
+            continue;
+        }
+        if (entry.read) {
+            finish(entry, entry.read, error);
+        }
+        if (entry.write) {
+            finish(entry, entry.write, error);
+        }
+        impl->setExecutor(NULL);
+        ports_.erase(it);
+        wake();
+        return;
+    }
+}
+
+IoExecutor*
+IoExecutor::of(Serial& port)
+{
+    return port.pimpl_->getExecutor();
+}
+
+IoExecutor::Port&
+IoExecutor::registered(Serial& port, const char* what)
+{
+    for (auto& item : ports_) {
+        if (item.second->impl == port.pimpl_.get()) {
+            return *item.second;
+        }
+    }
+    throw SerialException(std::string(what) + " port not registered");
+}
+
+void IoExecutor::asyncRead(Serial& port, uint8_t* buffer, size_t size, Handler handler)
+{
+    unique_ptr<Operation> operation(new Operation());
+    operation->kind = Operation::read;
+    operation->buffer = buffer;
+    operation->size = size;
+    operation->handler = std::move(handler);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Port& entry = registered(port, "IoExecutor::asyncRead");
+    setDeadline(*operation, Clock::now() + port.pimpl_->readTimeout(size));
+    start(entry, std::move(operation));
+}
+
+void IoExecutor::asyncReadUntil(Serial& port, const std::string& eol, size_t size, LineHandler handler)
+{
+    unique_ptr<Operation> operation(new Operation());
+    operation->kind = Operation::read_until;
+    operation->size = size;
+    operation->eol = eol;
+    operation->line_handler = std::move(handler);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Port& entry = registered(port, "IoExecutor::asyncReadUntil");
+    setDeadline(*operation, Clock::now() + port.pimpl_->readlineTimeout());
+    start(entry, std::move(operation));
+}
+
+void IoExecutor::asyncWrite(Serial& port, const uint8_t* data, size_t size, Handler handler)
+{
+    unique_ptr<Operation> operation(new Operation());
+    operation->kind = Operation::write;
+    operation->data = data;
+    operation->size = size;
+    operation->handler = std::move(handler);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Port& entry = registered(port, "IoExecutor::asyncWrite");
+    setDeadline(*operation, Clock::now() + port.pimpl_->writeTimeout(size));
+    start(entry, std::move(operation));
+}
+
+void IoExecutor::post(std::function<void()> task)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    completions_.push_back(std::move(task));
+    wake();
+}
+
+void IoExecutor::start(Port& port, unique_ptr<Operation> operation)
+{
+    unique_ptr<Operation>& slot = operation->kind == Operation::write ? port.write : port.read;
+    if (slot) {
+        if (operation->timed) {
+            timers_.erase(operation->timer);
+        }
+        throw SerialException(operation->kind == Operation::write
+                ? "IoExecutor write already pending"
+                : "IoExecutor read already pending");
+    }
+    operation->port = &port;
+    operation->done = 0;
+    operation->scanned = 0;
+    slot = std::move(operation);
+    try {
+        updateEvents(port);
+    }
+    catch (...) {
+        timers_.erase(slot->timer);
+        slot.reset();
+        throw;
+    }
+    ++pending_;
+
+    // Bytes may already sit in the port's receive buffer, which epoll does
+    // not report, so every new operation gets one attempt right away
+    ready_.push_back(port.fd);
+    if (std::this_thread::get_id() != loop_thread_) {
+        wake();
+    }
+}
+
+void IoExecutor::setDeadline(Operation& operation, Clock::time_point deadline)
+{
+    if (operation.timed) {
+        timers_.erase(operation.timer);
+    }
+    operation.timer = timers_.insert(std::make_pair(deadline, &operation));
+    operation.timed = true;
+}
+
+void IoExecutor::updateEvents(Port& port)
+{
+    uint32_t events = (port.read ? uint32_t(EPOLLIN) : 0) | (port.write ? uint32_t(EPOLLOUT) : 0);
+    if (events == port.events) {
+        return;
+    }
+    // Idle ports leave the set, so a hung up device does not spin the loop
+    // with EPOLLHUP while nobody is waiting on it
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.fd = port.fd;
+    int op = events == 0 ? EPOLL_CTL_DEL : (port.events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD);
+    if (-1 == epoll_ctl(epoll_fd_, op, port.fd, &event)) {
+        THROW(IOException, errno);
+    }
+    port.events = events;
+}
+
+void IoExecutor::finish(Port& port, unique_ptr<Operation>& slot, std::exception_ptr error)
+{
+    unique_ptr<Operation> operation(std::move(slot));
+    if (operation->timed) {
+        timers_.erase(operation->timer);
+    }
+    --pending_;
+    if (operation->kind == Operation::read_until) {
+        completions_.push_back([handler = std::move(operation->line_handler),
+                                   line = std::move(operation->line), error]() {
+            if (handler) {
+                handler(line, error);
+            }
+        });
+    }
+    else {
+        completions_.push_back([handler = std::move(operation->handler),
+                                   done = operation->done, error]() {
+            if (handler) {
+                handler(done, error);
+            }
+        });
+    }
+    try {
+        updateEvents(port);
+    }
+    catch (const IOException&) {
+        // Only a stale registration is left behind, the next update or
+        // remove() cleans it up
+    }
+}
+
+bool IoExecutor::advance(Port& port, Operation& operation)
+{
+    Serial::SerialImpl* impl = port.impl;
+    unique_ptr<Operation>& slot = operation.kind == Operation::write ? port.write : port.read;
+    try {
+        switch (operation.kind) {
+        case Operation::read:
+            operation.done += readAvailable(port, operation.buffer + operation.done, operation.size - operation.done);
+            if (operation.done == operation.size) {
+                finish(port, slot, std::exception_ptr());
+                return true;
+            }
+            return false;
+
+        case Operation::read_until:
+            while (true) {
+                const std::string& eol = operation.eol;
+                std::string& line = operation.line;
+                if (!eol.empty() && line.size() >= eol.size()) {
+                    // Back up enough to catch a delimiter split across reads
+                    size_t from = operation.scanned >= eol.size() ? operation.scanned - eol.size() + 1 : 0;
+                    size_t match = from + find_delimiter(reinterpret_cast<const uint8_t*>(line.data()) + from, line.size() - from, reinterpret_cast<const uint8_t*>(eol.data()), eol.size());
+                    operation.scanned = line.size();
+                    if (match != line.size()) {
+                        size_t end = match + eol.size();
+                        impl->unread(reinterpret_cast<const uint8_t*>(line.data()) + end, line.size() - end);
+                        line.resize(end);
+                        finish(port, slot, std::exception_ptr());
+                        return true;
+                    }
+                }
+                if (line.size() >= operation.size) {
+                    finish(port, slot, std::exception_ptr());
+                    return true;
+                }
+                size_t offset = line.size();
+                size_t wanted = std::min(operation.size - offset, line_chunk_size);
+                line.resize(offset + wanted);
+                size_t bytes_read = readAvailable(port, reinterpret_cast<uint8_t*>(&line[offset]), wanted);
+                line.resize(offset + bytes_read);
+                if (bytes_read == 0) {
+                    return false;
+                }
+                // Like readline, the line times out once the port stays
+                // quiet for the single byte timeout
+                setDeadline(operation, Clock::now() + impl->readlineTimeout());
+            }
+
+        case Operation::write:
+            while (operation.done < operation.size) {
+                size_t bytes_written = impl->writeNonBlocking(operation.data + operation.done, operation.size - operation.done);
+                if (bytes_written == 0) {
+                    break;
+                }
+                operation.done += bytes_written;
+            }
+            if (operation.done == operation.size) {
+                finish(port, slot, std::exception_ptr());
+                return true;
+            }
+            return false;
+        }
+    }
+    catch (...) {
+        finish(port, slot, std::current_exception());
+        return true;
+    }
+    return false;
+}
+
+size_t
+IoExecutor::readAvailable(Port& port, uint8_t* buffer, size_t size)
+{
+    // With VMIN 0 an empty tty returns 0 from read() just like a hung up
+    // one, which readNonBlocking reports as a disconnect. Only read what
+    // the port has, or read anyway after a hangup so that it is reported.
+    Serial::SerialImpl* impl = port.impl;
+    size_t available = impl->available();
+    if (available == 0 && !port.hangup) {
+        return 0;
+    }
+    return impl->readNonBlocking(buffer, available == 0 ? size : std::min(size, available));
+}
+
+void IoExecutor::wake()
+{
+    uint64_t value = 1;
+    ssize_t ignored = ::write(wake_fd_, &value, sizeof(value));
+    (void)ignored;
+}
+
+size_t
+IoExecutor::runOnce(uint32_t timeout)
+{
+    int wait_ms = timeout == Timeout::max() ? -1 : static_cast<int>(std::min<uint32_t>(timeout, INT_MAX));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        loop_thread_ = std::this_thread::get_id();
+        if (!ready_.empty() || !completions_.empty()) {
+            wait_ms = 0;
+        }
+        else if (!timers_.empty()) {
+            // Round up so the deadline has passed when epoll_wait returns
+            std::chrono::milliseconds until = std::chrono::duration_cast<std::chrono::milliseconds>(
+                timers_.begin()->first - Clock::now() + std::chrono::microseconds(999));
+            int until_ms = static_cast<int>(std::max<int64_t>(0, std::min<int64_t>(until.count(), INT_MAX)));
+            if (wait_ms == -1 || until_ms < wait_ms) {
+                wait_ms = until_ms;
+            }
+        }
+    }
+
+    epoll_event events[max_events];
+    int count = epoll_wait(epoll_fd_, events, max_events, wait_ms);
+    if (count < 0) {
+        if (errno != EINTR) {
+            THROW(IOException, errno);
+        }
+        count = 0;
+    }
+
+    std::vector<std::function<void()>> completions;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<int> ready;
+        ready.swap(ready_);
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.fd == wake_fd_) {
+                uint64_t value;
+                ssize_t ignored = ::read(wake_fd_, &value, sizeof(value));
+                (void)ignored;
+                continue;
+            }
+            auto it = ports_.find(events[i].data.fd);
+            if (it != ports_.end() && (events[i].events & (EPOLLHUP | EPOLLERR))) {
+                it->second->hangup = true;
+            }
+            ready.push_back(events[i].data.fd);
+        }
+        std::sort(ready.begin(), ready.end());
+        ready.erase(std::unique(ready.begin(), ready.end()), ready.end());
+
+        for (int fd : ready) {
+            auto it = ports_.find(fd);
+            if (it == ports_.end()) {
+                continue;
+            }
+            Port& port = *it->second;
+            if (port.read) {
+                advance(port, *port.read);
+            }
+            if (port.write) {
+                advance(port, *port.write);
+            }
+            port.hangup = false;
+        }
+
+        // Whatever is still pending at its deadline completes short
+        Clock::time_point now = Clock::now();
+        while (!timers_.empty() && timers_.begin()->first <= now) {
+            Operation* operation = timers_.begin()->second;
+            Port& port = *operation->port;
+            finish(port, operation->kind == Operation::write ? port.write : port.read,
+                std::exception_ptr());
+        }
+
+        completions.swap(completions_);
+    }
+
+    for (size_t i = 0; i < completions.size(); ++i) {
+        try {
+            completions[i]();
+        }
+        catch (...) {
+            // Keep the handlers that did not get to run
+            std::lock_guard<std::mutex> lock(mutex_);
+            completions_.insert(completions_.begin(), completions.begin() + i + 1, completions.end());
+            throw;
+        }
+    }
+    return completions.size();
+}
+
+void IoExecutor::run()
+{
+    while (!stopped_) {
+        runOnce(Timeout::max());
+    }
+    stopped_ = false;
+}
+
+void IoExecutor::stop()
+{
+    stopped_ = true;
+    wake();
+}
+
+size_t
+IoExecutor::pending() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_;
+}
+
+#endif // defined(__linux__)
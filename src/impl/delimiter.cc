@@ -0,0 +1,139 @@
+/* Vectorized delimiter search, see serial/impl/delimiter.h */
+
+#include <cstring>
+
+#include "serial/impl/delimiter.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SERIAL_DELIMITER_X86 1
+#include <immintrin.h>
+#endif
+
+using serial::find_delimiter;
+
+// memchr for the first delimiter byte, then compare the rest in place.
+static size_t
+find_scalar(const uint8_t* data, size_t size, const uint8_t* delimiter,
+    size_t delimiter_size)
+{
+    size_t last_start = size - delimiter_size;
+    size_t pos = 0;
+    while (pos <= last_start) {
+        const void* hit = memchr(data + pos, delimiter[0], last_start - pos + 1);
+        if (hit == NULL) {
+            break;
+        }
+        pos = static_cast<size_t>(static_cast<const uint8_t*>(hit) - data);
+        if (memcmp(data + pos + 1, delimiter + 1, delimiter_size - 1) == 0) {
+            return pos;
+        }
+        ++pos;
+    }
+    return size;
+}
+
+#ifdef SERIAL_DELIMITER_X86
+
+// Both kernels compare a block against the first delimiter byte and the
+// block shifted by delimiter_size - 1 against the last byte. Only positions
+// where both agree are checked further, which for the usual one or two byte
+// EOL means every candidate is already a match.
+
+__attribute__((target("sse2"))) static size_t
+find_sse2(const uint8_t* data, size_t size, const uint8_t* delimiter,
+    size_t delimiter_size)
+{
+    const __m128i first = _mm_set1_epi8(static_cast<char>(delimiter[0]));
+    const __m128i last = _mm_set1_epi8(static_cast<char>(delimiter[delimiter_size - 1]));
+
+    size_t i = 0;
+    for (; i + delimiter_size - 1 + 16 <= size; i += 16) {
+        __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + delimiter_size - 1));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last))));
+        while (mask != 0) {
+            size_t offset = i + static_cast<size_t>(__builtin_ctz(mask));
+            if (delimiter_size <= 2 || memcmp(data + offset + 1, delimiter + 1, delimiter_size - 2) == 0) {
+                return offset;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return i + find_scalar(data + i, size - i, delimiter, delimiter_size);
+}
+
+__attribute__((target("avx2"))) static size_t
+find_avx2(const uint8_t* data, size_t size, const uint8_t* delimiter,
+    size_t delimiter_size)
+{
+    const __m256i first = _mm256_set1_epi8(static_cast<char>(delimiter[0]));
+    const __m256i last = _mm256_set1_epi8(static_cast<char>(delimiter[delimiter_size - 1]));
+
+    size_t i = 0;
+    for (; i + delimiter_size - 1 + 32 <= size; i += 32) {
+        __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + delimiter_size - 1));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last))));
+        while (mask != 0) {
+            size_t offset = i + static_cast<size_t>(__builtin_ctz(mask));
+            if (delimiter_size <= 2 || memcmp(data + offset + 1, delimiter + 1, delimiter_size - 2) == 0) {
+                return offset;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return i + find_sse2(data + i, size - i, delimiter, delimiter_size);
+}
+
+#endif // SERIAL_DELIMITER_X86
+
+typedef size_t (*find_kernel_t)(const uint8_t*, size_t, const uint8_t*, size_t);
+
+static find_kernel_t
+select_kernel()
+{
+#ifdef SERIAL_DELIMITER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return find_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return find_sse2;
+    }
+#endif
+    return find_scalar;
+}
+
+// Resolved once, on first use
+static find_kernel_t
+kernel()
+{
+    static const find_kernel_t selected = select_kernel();
+    return selected;
+}
+
+size_t
+serial::find_delimiter(const uint8_t* data, size_t size,
+    const uint8_t* delimiter, size_t delimiter_size)
+{
+    if (delimiter_size == 0 || delimiter_size > size) {
+        return size;
+    }
+    return kernel()(data, size, delimiter, delimiter_size);
+}
+
+const char*
+serial::find_delimiter_kernel()
+{
+#ifdef SERIAL_DELIMITER_X86
+    if (kernel() == find_avx2) {
+        return "avx2";
+    }
+    if (kernel() == find_sse2) {
+        return "sse2";
+    }
+#endif
+    return "scalar";
+}
@@ -7,310 +7,511 @@
  * http://opensource.org/licenses/MIT
  */
 
-#include <cstdarg>
+#include <algorithm>
+#include <climits>
 #include <cstdio>
 #include <cstdlib>
-#include <fstream>
-#include <iostream>
-#include <sstream>
-#include <stdexcept>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
-#include <glob.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/serial.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
-#include <sys/types.h>
 #include <unistd.h>
 
+#include "serial/impl/list_ports.h"
+#include "serial/impl/port_index.h"
 #include "serial/serial.h"
 
+using serial::ListPortsOptions;
+using serial::PortIndex;
 using serial::PortInfo;
-using std::cout;
-using std::endl;
-using std::getline;
-using std::ifstream;
-using std::istringstream;
+using serial::Uevent;
+using std::map;
 using std::string;
 using std::vector;
 
-static vector<string> glob(const vector<string>& patterns);
-static string basename(const string& path);
-static string dirname(const string& path);
-static bool path_exists(const string& path);
-static string realpath(const string& path);
-static string usb_sysfs_friendly_name(const string& sys_usb_path);
-static vector<string> get_sysfs_info(const string& device_path);
-static string read_line(const string& file);
-static string usb_sysfs_hw_string(const string& sysfs_path);
-static string format(const char* format, ...);
+// Device name prefixes under /dev that are listed as serial ports, in the
+// order they are listed
+static const char* const port_prefixes[] = { "ttyACM", "ttyS", "ttyUSB", "tty.", "cu." };
 
-vector<string>
-glob(const vector<string>& patterns)
-{
-    vector<string> paths_found;
+static const size_t prefix_count = sizeof(port_prefixes) / sizeof(port_prefixes[0]);
 
-    if (patterns.size() == 0)
-        return paths_found;
+// Room for one sysfs attribute; the ones read here are short strings
+static const size_t attribute_size = 256;
 
-    glob_t glob_results;
+// Ports below this count are described on the calling thread, starting
+// threads costs more than the handful of attribute reads
+static const size_t ports_per_thread = 16;
 
-    int glob_retval = glob(patterns[0].c_str(), 0, NULL, &glob_results);
+static const unsigned max_describe_threads = 4;
 
-    vector<string>::const_iterator iter = patterns.begin();
+static size_t prefix_index(const char* name);
+static size_t read_attribute(int dir_fd, const char* path, char* buffer);
+static string attribute(int dir_fd, const char* path);
+static void usb_sysfs_info(int usb_fd, PortInfo& info);
+static string link_name(int dir_fd, const char* path);
+static void describe_at(int tty_fd, const string& name, PortInfo& info);
+static bool present_at(int tty_fd, const string& dev_path, const string& name);
+static map<string, string> by_id_links(const string& dev_path);
+static vector<string> port_names(const string& dev_path);
 
-    while (++iter != patterns.end()) {
-        glob_retval = glob(iter->c_str(), GLOB_APPEND, NULL, &glob_results);
+size_t
+prefix_index(const char* name)
+{
+    for (size_t index = 0; index < prefix_count; ++index) {
+        if (strncmp(name, port_prefixes[index], strlen(port_prefixes[index])) == 0)
+            return index;
     }
 
-    for (int path_index = 0; path_index < glob_results.gl_pathc; path_index++) {
-        paths_found.push_back(glob_results.gl_pathv[path_index]);
+    return prefix_count;
+}
+
+// Reads the first line of the attribute at path, relative to dir_fd, into
+// buffer without the newline. Returns its length, 0 if it does not exist.
+size_t
+read_attribute(int dir_fd, const char* path, char* buffer)
+{
+    buffer[0] = '\0';
+
+    int fd = openat(dir_fd, path, O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1)
+        return 0;
+
+    ssize_t size = pread(fd, buffer, attribute_size - 1, 0);
+
+    close(fd);
+
+    if (size <= 0) {
+        buffer[0] = '\0';
+        return 0;
     }
 
-    globfree(&glob_results);
+    buffer[size] = '\0';
 
-    return paths_found;
+    return strcspn(buffer, "\n");
 }
 
 string
-basename(const string& path)
+attribute(int dir_fd, const char* path)
 {
-    size_t pos = path.rfind("/");
+    char buffer[attribute_size];
 
-    if (pos == std::string::npos)
-        return path;
+    size_t length = read_attribute(dir_fd, path, buffer);
 
-    return string(path, pos + 1, string::npos);
+    return string(buffer, length);
 }
 
-string
-dirname(const string& path)
+void
+usb_sysfs_info(int usb_fd, PortInfo& info)
 {
-    size_t pos = path.rfind("/");
+    string manufacturer = attribute(usb_fd, "manufacturer");
+
+    string product = attribute(usb_fd, "product");
+
+    info.serial_number = attribute(usb_fd, "serial");
+
+    if (!manufacturer.empty() || !product.empty() || !info.serial_number.empty())
+        info.description = manufacturer + " " + product + " " + info.serial_number;
 
-    if (pos == std::string::npos)
-        return path;
-    else if (pos == 0)
-        return "/";
+    string vid = attribute(usb_fd, "idVendor");
 
-    return string(path, 0, pos);
+    string pid = attribute(usb_fd, "idProduct");
+
+    info.vid = static_cast<uint16_t>(strtoul(vid.c_str(), NULL, 16));
+
+    info.pid = static_cast<uint16_t>(strtoul(pid.c_str(), NULL, 16));
+
+    string serial_number;
+
+    if (!info.serial_number.empty())
+        serial_number = "SNR=" + info.serial_number;
+
+    info.hardware_id = "USB VID:PID=" + vid + ":" + pid + " " + serial_number;
 }
 
-bool path_exists(const string& path)
+// Last component of the symlink at path relative to dir_fd, empty if none
+string
+link_name(int dir_fd, const char* path)
 {
-    struct stat sb;
+    char buffer[PATH_MAX];
 
-    if (stat(path.c_str(), &sb) == 0)
-        return true;
+    ssize_t length = readlinkat(dir_fd, path, buffer, sizeof(buffer) - 1);
+
+    if (length <= 0)
+        return string();
+
+    buffer[length] = '\0';
+
+    const char* slash = strrchr(buffer, '/');
 
-    return false;
+    return slash == NULL ? buffer : slash + 1;
 }
 
-string
-realpath(const string& path)
+// Fills in the port called name from its /sys/class/tty entry. The device
+// links are followed through directory descriptors, ".." of which is the
+// physical parent in sysfs.
+void
+describe_at(int tty_fd, const string& name, PortInfo& info)
 {
-    char* real_path = realpath(path.c_str(), NULL);
+    string device_path = name + "/device";
+
+    int device_fd = openat(tty_fd, device_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (device_fd != -1) {
+        info.driver = link_name(device_fd, "driver");
 
-    string result;
+        bool usb_serial = name.compare(0, 6, "ttyUSB") == 0;
 
-    if (real_path != NULL) {
-        result = real_path;
+        if (usb_serial || name.compare(0, 6, "ttyACM") == 0) {
+            // ttyUSB devices are usb-serial ports below a USB interface,
+            // ttyACM devices the interface itself; the USB device is the
+            // interface's parent
+            int interface_fd = usb_serial ? openat(device_fd, "..", O_RDONLY | O_DIRECTORY | O_CLOEXEC) : device_fd;
 
-        free(real_path);
+            if (interface_fd != -1) {
+                string interface_number = attribute(interface_fd, "bInterfaceNumber");
+
+                if (!interface_number.empty())
+                    info.interface_number = static_cast<int>(strtol(interface_number.c_str(), NULL, 16));
+
+                int usb_fd = openat(interface_fd, "..", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+                if (usb_fd != -1) {
+                    usb_sysfs_info(usb_fd, info);
+
+                    close(usb_fd);
+                }
+
+                if (interface_fd != device_fd)
+                    close(interface_fd);
+            }
+        }
+        else {
+            // Try to read ID string of PCI device
+
+            info.hardware_id = attribute(device_fd, "id");
+        }
+
+        close(device_fd);
     }
 
-    return result;
+    if (info.description.empty())
+        info.description = name;
+
+    if (info.hardware_id.empty())
+        info.hardware_id = "n/a";
 }
 
-string
-usb_sysfs_friendly_name(const string& sys_usb_path)
+// False for a legacy UART port with no hardware behind it. Serial core
+// ports show their UART type in sysfs, PORT_UNKNOWN when the probe found
+// nothing; on kernels without that attribute the driver is asked instead.
+bool
+present_at(int tty_fd, const string& dev_path, const string& name)
 {
-    unsigned int device_number = 0;
+    if (name.compare(0, 4, "ttyS") != 0)
+        return true;
+
+    string type = attribute(tty_fd, (name + "/type").c_str());
 
-    istringstream(read_line(sys_usb_path + "/devnum")) >> device_number;
+    if (!type.empty())
+        return atoi(type.c_str()) != PORT_UNKNOWN;
 
-    string manufacturer = read_line(sys_usb_path + "/manufacturer");
+    // Without O_NONBLOCK the open could wait for carrier detect
+    int fd = open((dev_path + "/" + name).c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
 
-    string product = read_line(sys_usb_path + "/product");
+    if (fd == -1)
+        return errno != EIO && errno != ENXIO && errno != ENODEV;
 
-    string serial = read_line(sys_usb_path + "/serial");
+    serial_struct serial_info;
 
-    if (manufacturer.empty() && product.empty() && serial.empty())
-        return "";
+    bool present = ioctl(fd, TIOCGSERIAL, &serial_info) == -1 || serial_info.type != PORT_UNKNOWN;
 
-    return format("%s %s %s", manufacturer.c_str(), product.c_str(), serial.c_str());
+    close(fd);
+
+    return present;
 }
 
-vector<string>
-get_sysfs_info(const string& device_path)
+// Port names mapped to the /dev/serial/by-id links udev made for them
+map<string, string>
+by_id_links(const string& dev_path)
 {
-    string device_name = basename(device_path);
+    map<string, string> links;
 
-    string friendly_name;
+    string by_id_path = dev_path + "/serial/by-id";
 
-    string hardware_id;
+    DIR* dir = opendir(by_id_path.c_str());
 
-    string sys_device_path = format("/sys/class/tty/%s/device", device_name.c_str());
+    if (dir == NULL)
+        return links;
 
-    if (device_name.compare(0, 6, "ttyUSB") == 0) {
-        sys_device_path = dirname(dirname(realpath(sys_device_path)));
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.')
+            continue;
 
-        if (path_exists(sys_device_path)) {
-            friendly_name = usb_sysfs_friendly_name(sys_device_path);
+        string target = link_name(dirfd(dir), entry->d_name);
 
-            hardware_id = usb_sysfs_hw_string(sys_device_path);
-        }
+        if (!target.empty())
+            links[target] = by_id_path + "/" + entry->d_name;
     }
-    else if (device_name.compare(0, 6, "ttyACM") == 0) {
-        sys_device_path = dirname(realpath(sys_device_path));
 
-        if (path_exists(sys_device_path)) {
-            friendly_name = usb_sysfs_friendly_name(sys_device_path);
+    closedir(dir);
 
-            hardware_id = usb_sysfs_hw_string(sys_device_path);
-        }
-    }
-    else {
-        // Try to read ID string of PCI device
+    return links;
+}
+
+// Names in dev_path that are serial ports, grouped by prefix and sorted
+// within each group, as globbing the prefixes one after another would
+vector<string>
+port_names(const string& dev_path)
+{
+    vector<string> names;
 
-        string sys_id_path = sys_device_path + "/id";
+    DIR* dir = opendir(dev_path.c_str());
 
-        if (path_exists(sys_id_path))
-            hardware_id = read_line(sys_id_path);
+    if (dir == NULL)
+        return names;
+
+    while (dirent* entry = readdir(dir)) {
+        if (prefix_index(entry->d_name) < prefix_count)
+            names.push_back(entry->d_name);
     }
 
-    if (friendly_name.empty())
-        friendly_name = device_name;
+    closedir(dir);
 
-    if (hardware_id.empty())
-        hardware_id = "n/a";
+    std::sort(names.begin(), names.end(), [](const string& a, const string& b) {
+        size_t a_index = prefix_index(a.c_str());
+        size_t b_index = prefix_index(b.c_str());
+        return a_index != b_index ? a_index < b_index : a < b;
+    });
 
-    vector<string> result;
-    result.push_back(friendly_name);
-    result.push_back(hardware_id);
+    return names;
+}
 
-    return result;
+bool serial::is_port_name(const string& name)
+{
+    return prefix_index(name.c_str()) < prefix_count;
 }
 
-string
-read_line(const string& file)
+PortInfo
+serial::describe_port(const string& device)
 {
-    ifstream ifs(file.c_str(), ifstream::in);
+    PortInfo device_entry;
+    device_entry.port = device;
 
-    string line;
+    size_t slash = device.rfind('/');
 
-    if (ifs) {
-        getline(ifs, line);
-    }
+    string name = slash == string::npos ? device : device.substr(slash + 1);
 
-    return line;
+    int tty_fd = open("/sys/class/tty", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    describe_at(tty_fd, name, device_entry);
+
+    if (tty_fd != -1)
+        close(tty_fd);
+
+    device_entry.by_id_path = serial::by_id_link("/dev", name);
+
+    return device_entry;
 }
 
 string
-format(const char* format, ...)
+serial::by_id_link(const string& dev_path, const string& name)
 {
-    va_list ap;
+    map<string, string> links = by_id_links(dev_path);
 
-    size_t buffer_size_bytes = 256;
+    map<string, string>::const_iterator link = links.find(name);
 
-    string result;
+    return link == links.end() ? string() : link->second;
+}
 
-    char* buffer = (char*)malloc(buffer_size_bytes);
+bool serial::port_present(const string& device)
+{
+    size_t slash = device.rfind('/');
 
-    if (buffer == NULL)
-        return result;
+    int tty_fd = open("/sys/class/tty", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
 
-    bool done = false;
+    bool present = present_at(tty_fd, device.substr(0, slash), device.substr(slash + 1));
 
-    unsigned int loop_count = 0;
+    if (tty_fd != -1)
+        close(tty_fd);
 
-    while (!done) {
-        va_start(ap, format);
+    return present;
+}
 
-        int return_value = vsnprintf(buffer, buffer_size_bytes, format, ap);
+vector<PortInfo>
+serial::list_ports_in(const string& dev_path, const string& sysfs_tty_path,
+    const ListPortsOptions& options, unsigned threads)
+{
+    vector<string> names = port_names(dev_path);
 
-        if (return_value < 0) {
-            done = true;
-        }
-        else if (return_value >= buffer_size_bytes) {
-            // Realloc and try again.
+    vector<PortInfo> results(names.size());
 
-            buffer_size_bytes = return_value + 1;
+    // A missing sysfs leaves every port with its defaults, as a failed
+    // lookup of each path would
+    int tty_fd = open(sysfs_tty_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
 
-            char* new_buffer_ptr = (char*)realloc(buffer, buffer_size_bytes);
+    threads = std::max(1u, std::min<unsigned>(threads, names.size() / ports_per_thread));
 
-            if (new_buffer_ptr == NULL) {
-                done = true;
-            }
-            else {
-                buffer = new_buffer_ptr;
-            }
-        }
-        else {
-            result = buffer;
-            done = true;
+    // Each thread fills in every threads-th entry, no two touch the same
+    // one. Ports left out keep an empty name.
+    auto describe = [&](unsigned first) {
+        for (size_t index = first; index < names.size(); index += threads) {
+            if (options.present_only && !present_at(tty_fd, dev_path, names[index]))
+                continue;
+
+            results[index].port = dev_path + "/" + names[index];
+
+            describe_at(tty_fd, names[index], results[index]);
         }
+    };
+
+    vector<std::thread> workers;
+
+    for (unsigned first = 1; first < threads; ++first)
+        workers.push_back(std::thread(describe, first));
+
+    describe(0);
 
-        va_end(ap);
+    for (std::thread& worker : workers)
+        worker.join();
 
-        if (++loop_count > 5)
-            done = true;
+    map<string, string> links = by_id_links(dev_path);
+
+    for (size_t index = 0; index < names.size(); ++index) {
+        map<string, string>::const_iterator link = links.find(names[index]);
+
+        if (link != links.end())
+            results[index].by_id_path = link->second;
     }
 
-    free(buffer);
+    if (tty_fd != -1)
+        close(tty_fd);
+
+    vector<PortInfo>::iterator end = std::remove_if(results.begin(), results.end(),
+        [](const PortInfo& info) { return info.port.empty(); });
 
-    return result;
+    results.erase(end, results.end());
+
+    return results;
 }
 
-string
-usb_sysfs_hw_string(const string& sysfs_path)
+bool serial::parse_uevent(const char* data, size_t size, Uevent& event)
 {
-    string serial_number = read_line(sysfs_path + "/serial");
+    const char* end = data + size;
 
-    if (serial_number.length() > 0) {
-        serial_number = format("SNR=%s", serial_number.c_str());
-    }
+    // Kernel messages start with "action@devpath", udev's with "libudev"
+    const char* header_end = static_cast<const char*>(memchr(data, '\0', size));
+
+    if (header_end == NULL || memchr(data, '@', header_end - data) == NULL)
+        return false;
+
+    event = Uevent();
+
+    for (const char* field = header_end + 1; field < end;) {
+        const char* field_end = static_cast<const char*>(memchr(field, '\0', end - field));
 
-    string vid = read_line(sysfs_path + "/idVendor");
+        if (field_end == NULL)
+            field_end = end;
 
-    string pid = read_line(sysfs_path + "/idProduct");
+        string pair(field, field_end);
 
-    return format("USB VID:PID=%s:%s %s", vid.c_str(), pid.c_str(), serial_number.c_str());
+        size_t equals = pair.find('=');
+
+        if (equals != string::npos) {
+            string key = pair.substr(0, equals);
+
+            if (key == "ACTION")
+                event.action = pair.substr(equals + 1);
+            else if (key == "SUBSYSTEM")
+                event.subsystem = pair.substr(equals + 1);
+            else if (key == "DEVNAME")
+                event.devname = pair.substr(equals + 1);
+        }
+
+        field = field_end + 1;
+    }
+
+    return !event.action.empty();
 }
 
 vector<PortInfo>
 serial::list_ports()
 {
-    vector<PortInfo> results;
+    return list_ports(ListPortsOptions());
+}
+
+vector<PortInfo>
+serial::list_ports(const ListPortsOptions& options)
+{
+    return list_ports_in("/dev", "/sys/class/tty", options,
+        std::min(max_describe_threads, std::max(1u, std::thread::hardware_concurrency())));
+}
+
+// Modification time of a directory, which changes whenever an entry is
+// added or removed; zero if it does not exist
+static timespec
+directory_mtime(const char* path)
+{
+    struct stat sb;
+
+    if (stat(path, &sb) != 0) {
+        timespec none = { 0, 0 };
+        return none;
+    }
+
+    return sb.st_mtim;
+}
+
+static bool
+same_time(const timespec& a, const timespec& b)
+{
+    return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+vector<PortInfo>
+serial::find_port(uint16_t vid, uint16_t pid, const string& serial_number)
+{
+    static std::mutex mutex;
+
+    static std::shared_ptr<const PortIndex> index;
 
-    vector<string> search_globs;
-    search_globs.push_back("/dev/ttyACM*");
-    search_globs.push_back("/dev/ttyS*");
-    search_globs.push_back("/dev/ttyUSB*");
-    search_globs.push_back("/dev/tty.*");
-    search_globs.push_back("/dev/cu.*");
+    static timespec dev_mtime;
 
-    vector<string> devices_found = glob(search_globs);
+    static timespec by_id_mtime;
 
-    vector<string>::iterator iter = devices_found.begin();
+    // Taken before enumerating, so a port plugged in meanwhile makes the
+    // next call enumerate again
+    timespec dev_now = directory_mtime("/dev");
 
-    while (iter != devices_found.end()) {
-        string device = *iter++;
+    timespec by_id_now = directory_mtime("/dev/serial/by-id");
 
-        vector<string> sysfs_info = get_sysfs_info(device);
+    std::shared_ptr<const PortIndex> current;
 
-        string friendly_name = sysfs_info[0];
+    {
+        std::lock_guard<std::mutex> lock(mutex);
 
-        string hardware_id = sysfs_info[1];
+        if (!index || !same_time(dev_now, dev_mtime) || !same_time(by_id_now, by_id_mtime)) {
+            index = std::make_shared<PortIndex>(list_ports());
 
-        PortInfo device_entry;
-        device_entry.port = device;
-        device_entry.description = friendly_name;
-        device_entry.hardware_id = hardware_id;
+            dev_mtime = dev_now;
 
-        results.push_back(device_entry);
+            by_id_mtime = by_id_now;
+        }
+
+        current = index;
     }
 
-    return results;
+    return current->find(vid, pid, serial_number);
 }
 
 #endif // defined(__linux__)
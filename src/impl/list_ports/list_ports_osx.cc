@@ -12,8 +12,10 @@
 #include <string>
 #include <vector>
 
+#include "serial/impl/port_index.h"
 #include "serial/serial.h"
 
+using serial::PortIndex;
 using serial::PortInfo;
 using std::string;
 using std::vector;
@@ -252,6 +254,10 @@ serial::list_ports(void)
         if (vendor_id && product_id) {
             char cstring[HARDWARE_ID_STRING_LENGTH];
 
+            port_info.vid = vendor_id;
+            port_info.pid = product_id;
+            port_info.serial_number = serial_number;
+
             if (serial_number.empty())
                 serial_number = "None";
 
@@ -271,4 +277,17 @@ serial::list_ports(void)
     return devices_found;
 }
 
+// There are no phantom UART ports to leave out here
+vector<PortInfo>
+serial::list_ports(const ListPortsOptions&)
+{
+    return list_ports();
+}
+
+vector<PortInfo>
+serial::find_port(uint16_t vid, uint16_t pid, const string& serial_number)
+{
+    return PortIndex(list_ports()).find(vid, pid, serial_number);
+}
+
 #endif // defined(__APPLE__)
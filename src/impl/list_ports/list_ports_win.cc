@@ -9,13 +9,16 @@
 
 #include <windows.h>
 
+#include "serial/impl/port_index.h"
 #include "serial/serial.h"
+#include <cstdlib>
 #include <cstring>
 #include <devguid.h>
 #include <initguid.h>
 #include <setupapi.h>
 #include <tchar.h>
 
+using serial::PortIndex;
 using serial::PortInfo;
 using std::string;
 using std::vector;
@@ -23,6 +26,20 @@ using std::vector;
 static const DWORD port_name_max_length = 256;
 static const DWORD friendly_name_max_length = 256;
 static const DWORD hardware_id_max_length = 256;
+static const DWORD instance_id_max_length = 256;
+
+// Hexadecimal number following key in a hardware or instance ID such as
+// "USB\VID_0403&PID_6001&MI_00", -1 if key is missing
+static long
+id_field(const std::string& id, const char* key)
+{
+    size_t pos = id.find(key);
+
+    if (pos == std::string::npos)
+        return -1;
+
+    return strtol(id.c_str() + pos + strlen(key), NULL, 16);
+}
 
 // Convert a wide Unicode string to an UTF8 string
 std::string utf8_encode(const std::wstring& wstr)
@@ -141,6 +158,33 @@ serial::list_ports()
         port_entry.description = friendlyName;
         port_entry.hardware_id = hardwareId;
 
+        long vid = id_field(hardwareId, "VID_");
+        long pid = id_field(hardwareId, "PID_");
+
+        if (vid >= 0 && pid >= 0) {
+            port_entry.vid = static_cast<uint16_t>(vid);
+            port_entry.pid = static_cast<uint16_t>(pid);
+            port_entry.interface_number = static_cast<int>(id_field(hardwareId, "MI_"));
+
+            // The last part of the instance ID of a USB device is its serial
+            // number, unless Windows generated one containing '&'
+
+            TCHAR instance_id[instance_id_max_length];
+
+            if (SetupDiGetDeviceInstanceId(device_info_set, &device_info_data, instance_id,
+                    instance_id_max_length, NULL)) {
+#ifdef UNICODE
+                std::string instanceId = utf8_encode(instance_id);
+#else
+                std::string instanceId = instance_id;
+#endif
+                size_t separator = instanceId.rfind('\\');
+
+                if (separator != std::string::npos && instanceId.find('&', separator) == std::string::npos)
+                    port_entry.serial_number = instanceId.substr(separator + 1);
+            }
+        }
+
         devices_found.push_back(port_entry);
     }
 
@@ -149,4 +193,17 @@ serial::list_ports()
     return devices_found;
 }
 
+// There are no phantom UART ports to leave out here
+vector<PortInfo>
+serial::list_ports(const ListPortsOptions&)
+{
+    return list_ports();
+}
+
+vector<PortInfo>
+serial::find_port(uint16_t vid, uint16_t pid, const string& serial_number)
+{
+    return PortIndex(list_ports()).find(vid, pid, serial_number);
+}
+
 #endif // #if defined(_WIN32)
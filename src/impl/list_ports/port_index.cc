@@ -0,0 +1,52 @@
+/* Hash index over enumerated ports, see serial/impl/port_index.h */
+
+#include <algorithm>
+
+#include "serial/impl/port_index.h"
+
+using serial::PortIndex;
+using serial::PortInfo;
+using std::string;
+using std::vector;
+
+PortIndex::PortIndex(const vector<PortInfo>& ports)
+{
+    for (const PortInfo& info : ports) {
+        if (info.vid == 0 && info.pid == 0) {
+            continue;
+        }
+        ports_[key(info.vid, info.pid, string())].push_back(info);
+        if (!info.serial_number.empty()) {
+            ports_[key(info.vid, info.pid, info.serial_number)].push_back(info);
+        }
+    }
+    for (auto& item : ports_) {
+        std::sort(item.second.begin(), item.second.end(), [](const PortInfo& a, const PortInfo& b) {
+            if (a.interface_number != b.interface_number) {
+                return a.interface_number < b.interface_number;
+            }
+            return a.port < b.port;
+        });
+    }
+}
+
+PortIndex::Key
+PortIndex::key(uint16_t vid, uint16_t pid, const string& serial_number)
+{
+    Key result(4, '\0');
+    result[0] = static_cast<char>(vid >> 8);
+    result[1] = static_cast<char>(vid);
+    result[2] = static_cast<char>(pid >> 8);
+    result[3] = static_cast<char>(pid);
+    return result + serial_number;
+}
+
+vector<PortInfo>
+PortIndex::find(uint16_t vid, uint16_t pid, const string& serial_number) const
+{
+    auto it = ports_.find(key(vid, pid, serial_number));
+    if (it == ports_.end()) {
+        return vector<PortInfo>();
+    }
+    return it->second;
+}
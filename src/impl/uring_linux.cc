@@ -0,0 +1,244 @@
+/* Raw system call io_uring ring, see serial/impl/uring.h */
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "serial/impl/uring.h"
+#include "serial/serial.h"
+
+using serial::IOException;
+using serial::Uring;
+
+static int
+uring_setup(unsigned entries, io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int
+uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0));
+}
+
+static int
+uring_register(int fd, unsigned opcode, const void* arg, unsigned count)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+// The rings are shared with the kernel, which reads the submission tail and
+// writes the completion tail concurrently
+static unsigned
+load_acquire(const unsigned* value)
+{
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+static void
+store_release(unsigned* value, unsigned new_value)
+{
+    __atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+}
+
+template <typename T>
+static T*
+at(void* ring, uint32_t offset)
+{
+    return reinterpret_cast<T*>(static_cast<uint8_t*>(ring) + offset);
+}
+
+Uring::Uring(unsigned entries)
+    : fd_(-1)
+    , sq_ring_(MAP_FAILED)
+    , sq_ring_size_(0)
+    , cq_ring_(MAP_FAILED)
+    , cq_ring_size_(0)
+    , sqes_(static_cast<io_uring_sqe*>(MAP_FAILED))
+    , sqes_size_(0)
+    , sq_local_tail_(0)
+    , buffer_base_(NULL)
+    , buffer_size_(0)
+    , buffers_refused_(false)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    fd_ = uring_setup(entries, &params);
+    if (fd_ == -1) {
+        THROW(IOException, errno);
+    }
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ = mmap(NULL, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ != MAP_FAILED) {
+        cq_ring_ = single_mmap ? sq_ring_
+                               : mmap(NULL, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                   fd_, IORING_OFF_CQ_RING);
+    }
+    if (cq_ring_ != MAP_FAILED) {
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES));
+    }
+    if (sqes_ == MAP_FAILED) {
+        int error = errno;
+        release();
+        THROW(IOException, error);
+    }
+
+    sq_head_ = at<unsigned>(sq_ring_, params.sq_off.head);
+    sq_tail_ = at<unsigned>(sq_ring_, params.sq_off.tail);
+    sq_mask_ = *at<unsigned>(sq_ring_, params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    sq_array_ = at<unsigned>(sq_ring_, params.sq_off.array);
+    sq_local_tail_ = *sq_tail_;
+
+    cq_head_ = at<unsigned>(cq_ring_, params.cq_off.head);
+    cq_tail_ = at<unsigned>(cq_ring_, params.cq_off.tail);
+    cq_mask_ = *at<unsigned>(cq_ring_, params.cq_off.ring_mask);
+    cqes_ = at<io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+}
+
+Uring::~Uring()
+{
+    release();
+}
+
+void Uring::release()
+{
+    if (sqes_ != MAP_FAILED) {
+        munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+        munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_ != MAP_FAILED) {
+        munmap(sq_ring_, sq_ring_size_);
+    }
+    if (fd_ != -1) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool Uring::supported()
+{
+    static const int result = []() {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        // Fails with ENOSYS on old kernels, EPERM when kernel.io_uring_disabled
+        // or a seccomp filter forbids it
+        int fd = uring_setup(2, &params);
+        if (fd == -1) {
+            return 0;
+        }
+        const unsigned op_count = 256;
+        std::vector<uint8_t> storage(sizeof(io_uring_probe) + op_count * sizeof(io_uring_probe_op));
+        io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+        int registered = uring_register(fd, IORING_REGISTER_PROBE, probe, op_count);
+        ::close(fd);
+        if (registered == -1) {
+            return 0;
+        }
+        const uint8_t needed[] = { IORING_OP_READV, IORING_OP_READ_FIXED, IORING_OP_LINK_TIMEOUT,
+            IORING_OP_POLL_ADD, IORING_OP_ASYNC_CANCEL };
+        for (uint8_t op : needed) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                return 0;
+            }
+        }
+        return 1;
+    }();
+    return result != 0;
+}
+
+io_uring_sqe*
+Uring::getSqe()
+{
+    if (sq_local_tail_ - load_acquire(sq_head_) >= sq_entries_) {
+        return NULL;
+    }
+    unsigned index = sq_local_tail_ & sq_mask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    ++sq_local_tail_;
+    return sqe;
+}
+
+void Uring::submit(unsigned wait_count)
+{
+    unsigned to_submit = sq_local_tail_ - *sq_tail_;
+    store_release(sq_tail_, sq_local_tail_);
+    while (true) {
+        int r = uring_enter(fd_, to_submit, wait_count, wait_count > 0 ? IORING_ENTER_GETEVENTS : 0);
+        if (r >= 0) {
+            if (static_cast<unsigned>(r) >= to_submit) {
+                return;
+            }
+            // The kernel stopped early, hand over the rest
+            to_submit -= static_cast<unsigned>(r);
+            continue;
+        }
+        // A signal, or a full completion queue the caller has to reap
+        if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+            return;
+        }
+        THROW(IOException, errno);
+    }
+}
+
+bool Uring::popCqe(uint64_t& user_data, int32_t& result)
+{
+    unsigned head = *cq_head_;
+    if (head == load_acquire(cq_tail_)) {
+        return false;
+    }
+    const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+    user_data = cqe.user_data;
+    result = cqe.res;
+    store_release(cq_head_, head + 1);
+    return true;
+}
+
+bool Uring::registerBuffer(void* base, size_t size)
+{
+    if (buffers_refused_) {
+        return false;
+    }
+    if (buffer_base_ != NULL) {
+        uring_register(fd_, IORING_UNREGISTER_BUFFERS, NULL, 0);
+        buffer_base_ = NULL;
+        buffer_size_ = 0;
+    }
+    iovec buffer = { base, size };
+    if (-1 == uring_register(fd_, IORING_REGISTER_BUFFERS, &buffer, 1)) {
+        buffers_refused_ = true;
+        return false;
+    }
+    buffer_base_ = static_cast<const uint8_t*>(base);
+    buffer_size_ = size;
+    return true;
+}
+
+bool Uring::isRegistered(const void* base, size_t size) const
+{
+    const uint8_t* begin = static_cast<const uint8_t*>(base);
+    return buffer_base_ != NULL && begin >= buffer_base_ && begin + size <= buffer_base_ + buffer_size_;
+}
+
+#endif // defined(__linux__)
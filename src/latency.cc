@@ -0,0 +1,95 @@
+/* Log bucketed latency histograms, see serial/latency.h */
+
+#include <cmath>
+#include <cstring>
+
+#include "serial/latency.h"
+
+using serial::LatencyHistogram;
+
+LatencyHistogram::LatencyHistogram()
+{
+    clear();
+}
+
+uint64_t
+LatencyHistogram::lowerBound(size_t bucket)
+{
+    const size_t sub_buckets = size_t(1) << sub_bucket_bits;
+    if (bucket < sub_buckets) {
+        return bucket;
+    }
+    // Bucket group g >= 1 covers [2^(g + bits - 1), 2^(g + bits)) in steps
+    // of 2^(g - 1)
+    size_t group = bucket >> sub_bucket_bits;
+    size_t offset = bucket & (sub_buckets - 1);
+    unsigned shift = static_cast<unsigned>(group - 1);
+    return (uint64_t(sub_buckets) + offset) << shift;
+}
+
+uint64_t
+LatencyHistogram::upperBound(size_t bucket)
+{
+    if (bucket + 1 >= bucket_count) {
+        return UINT64_MAX;
+    }
+    return lowerBound(bucket + 1) - 1;
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds)
+{
+    add(bucketIndex(nanoseconds), 1);
+}
+
+void LatencyHistogram::add(size_t bucket, uint64_t count)
+{
+    counts_[bucket] += count;
+    total_ += count;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+    for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+        counts_[bucket] += other.counts_[bucket];
+    }
+    total_ += other.total_;
+}
+
+uint64_t
+LatencyHistogram::percentile(double fraction) const
+{
+    if (total_ == 0) {
+        return 0;
+    }
+    // Rank of the sample the percentile lands on, 1 based
+    double rank = std::ceil(fraction * static_cast<double>(total_));
+    uint64_t target = rank < 1 ? 1 : static_cast<uint64_t>(rank);
+    if (target > total_) {
+        target = total_;
+    }
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+        seen += counts_[bucket];
+        if (seen >= target) {
+            return upperBound(bucket);
+        }
+    }
+    return upperBound(bucket_count - 1);
+}
+
+uint64_t
+LatencyHistogram::max() const
+{
+    for (size_t bucket = bucket_count; bucket > 0; --bucket) {
+        if (counts_[bucket - 1] != 0) {
+            return upperBound(bucket - 1);
+        }
+    }
+    return 0;
+}
+
+void LatencyHistogram::clear()
+{
+    memset(counts_, 0, sizeof(counts_));
+    total_ = 0;
+}
@@ -0,0 +1,73 @@
+/* Concurrent opening of many ports, see serial::open_all */
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <system_error>
+#include <thread>
+
+#include "serial/serial.h"
+
+using serial::OpenResult;
+using serial::PortSpec;
+using serial::Serial;
+using std::vector;
+
+// Ports opened at once when the caller does not say
+static const size_t default_open_threads = 16;
+
+static void
+open_one(const PortSpec& spec, OpenResult& result)
+{
+    try {
+        std::unique_ptr<Serial> serial(new Serial(spec.port, spec.baudrate, spec.timeout,
+            spec.bytesize, spec.parity, spec.stopbits, spec.flowcontrol));
+        if (spec.setup) {
+            spec.setup(*serial);
+        }
+        result.serial = std::move(serial);
+    }
+    catch (...) {
+        result.error = std::current_exception();
+    }
+}
+
+vector<OpenResult>
+serial::open_all(const PortSpec* specs, size_t count, size_t max_threads)
+{
+    vector<OpenResult> results(count);
+    if (max_threads == 0) {
+        max_threads = default_open_threads;
+    }
+    size_t threads = std::min(max_threads, count);
+
+    // Workers take the next unopened spec until none are left, so a port
+    // that blocks long in open holds up only its own thread
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        for (size_t index = next++; index < count; index = next++) {
+            open_one(specs[index], results[index]);
+        }
+    };
+
+    vector<std::thread> workers;
+    try {
+        for (size_t i = 1; i < threads; ++i) {
+            workers.push_back(std::thread(work));
+        }
+    }
+    catch (const std::system_error&) {
+        // Out of threads, the ones running and this one finish the job
+    }
+    work();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    return results;
+}
+
+vector<OpenResult>
+serial::open_all(const vector<PortSpec>& specs, size_t max_threads)
+{
+    return open_all(specs.data(), specs.size(), max_threads);
+}
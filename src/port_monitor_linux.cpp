@@ -0,0 +1,295 @@
+/* Hotplug driven port table, see serial/port_monitor.h */
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <climits>
+#include <errno.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "serial/impl/list_ports.h"
+#include "serial/impl/port_index.h"
+#include "serial/port_monitor.h"
+
+using serial::IOException;
+using serial::ListPortsOptions;
+using serial::PortIndex;
+using serial::PortInfo;
+using serial::PortMonitor;
+using serial::Timeout;
+using serial::Uevent;
+using std::string;
+using std::vector;
+
+// Netlink multicast group the kernel sends uevents to (udev uses group 2
+// for its own, processed copies)
+static const uint32_t kernel_uevent_group = 1;
+
+// Receive buffer requested for the socket, enough to ride out a hub full of
+// adapters being plugged in at once
+static const int socket_buffer_size = 1024 * 1024;
+
+// A uevent is at most a page of environment plus its header
+static const size_t uevent_buffer_size = 8192;
+
+// How long, and how often, to look for the by-id link of an added port
+// before giving up on udev making one
+static const std::chrono::seconds by_id_wait(5);
+static const int by_id_poll_ms = 100;
+
+PortMonitor::PortMonitor(const Callbacks& callbacks, const ListPortsOptions& options)
+    : socket_fd_(-1)
+    , wake_fd_(-1)
+    , callbacks_(callbacks)
+    , options_(options)
+    , stopped_(false)
+    , buffer_(uevent_buffer_size)
+{
+    socket_fd_ = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if (socket_fd_ == -1) {
+        THROW(IOException, errno);
+    }
+    // SO_RCVBUFFORCE goes past rmem_max but needs CAP_NET_ADMIN
+    if (-1 == setsockopt(socket_fd_, SOL_SOCKET, SO_RCVBUFFORCE, &socket_buffer_size, sizeof(socket_buffer_size))) {
+        setsockopt(socket_fd_, SOL_SOCKET, SO_RCVBUF, &socket_buffer_size, sizeof(socket_buffer_size));
+    }
+    sockaddr_nl address;
+    memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = kernel_uevent_group;
+    if (-1 == bind(socket_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address))) {
+        int error = errno;
+        ::close(socket_fd_);
+        THROW(IOException, error);
+    }
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ == -1) {
+        int error = errno;
+        ::close(socket_fd_);
+        THROW(IOException, error);
+    }
+
+    // Enumerate only after subscribing, so a port plugged in meanwhile is
+    // either listed or has its add event queued on the socket
+    for (const PortInfo& info : list_ports(options_)) {
+        table_[info.port] = info;
+    }
+    publish();
+}
+
+PortMonitor::~PortMonitor()
+{
+    ::close(wake_fd_);
+    ::close(socket_fd_);
+}
+
+PortMonitor::Snapshot
+PortMonitor::ports() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return snapshot_;
+}
+
+void PortMonitor::publish()
+{
+    std::shared_ptr<vector<PortInfo>> ports = std::make_shared<vector<PortInfo>>();
+    ports->reserve(table_.size());
+    for (auto& item : table_) {
+        ports->push_back(item.second);
+    }
+    std::shared_ptr<const PortIndex> index = std::make_shared<PortIndex>(*ports);
+    std::lock_guard<std::mutex> lock(mutex_);
+    snapshot_ = ports;
+    index_ = index;
+}
+
+vector<PortInfo>
+PortMonitor::find(uint16_t vid, uint16_t pid, const string& serial_number) const
+{
+    std::shared_ptr<const PortIndex> index;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        index = index_;
+    }
+    return index->find(vid, pid, serial_number);
+}
+
+bool PortMonitor::receive(vector<Change>& changes)
+{
+    bool changed = false;
+    bool overflowed = false;
+    while (true) {
+        sockaddr_nl sender;
+        iovec chunk = { buffer_.data(), buffer_.size() };
+        msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_name = &sender;
+        message.msg_namelen = sizeof(sender);
+        message.msg_iov = &chunk;
+        message.msg_iovlen = 1;
+        ssize_t size = recvmsg(socket_fd_, &message, MSG_DONTWAIT);
+        if (size == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOBUFS) {
+                overflowed = true;
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            THROW(IOException, errno);
+        }
+
+        // Only the kernel speaks for itself on this group, anything else is
+        // another process rebroadcasting
+        Uevent event;
+        if (sender.nl_pid != 0 || (message.msg_flags & MSG_TRUNC)
+            || !parse_uevent(buffer_.data(), static_cast<size_t>(size), event)) {
+            continue;
+        }
+        if (event.subsystem != "tty" || !is_port_name(event.devname)) {
+            continue;
+        }
+
+        string port = "/dev/" + event.devname;
+        auto it = table_.find(port);
+        if (event.action == "add") {
+            if (options_.present_only && !port_present(port)) {
+                continue;
+            }
+            PortInfo info = describe_port(port);
+            if (info.vid != 0 && info.by_id_path.empty()) {
+                unlinked_[port] = std::chrono::steady_clock::now() + by_id_wait;
+            }
+            // Already known when the port was plugged in while the
+            // constructor enumerated, refresh it without a callback
+            if (it != table_.end()) {
+                it->second = info;
+            }
+            else {
+                table_[port] = info;
+                changes.push_back(Change { true, info });
+            }
+            changed = true;
+        }
+        else if (event.action == "remove" && it != table_.end()) {
+            changes.push_back(Change { false, it->second });
+            table_.erase(it);
+            unlinked_.erase(port);
+            changed = true;
+        }
+    }
+
+    if (overflowed) {
+        rescan(changes);
+        changed = true;
+    }
+    return changed;
+}
+
+void PortMonitor::rescan(vector<Change>& changes)
+{
+    std::map<string, PortInfo> fresh;
+    for (const PortInfo& info : list_ports(options_)) {
+        fresh[info.port] = info;
+    }
+    for (auto& item : table_) {
+        if (fresh.count(item.first) == 0) {
+            changes.push_back(Change { false, item.second });
+        }
+    }
+    for (auto& item : fresh) {
+        if (table_.count(item.first) == 0) {
+            changes.push_back(Change { true, item.second });
+        }
+    }
+    table_.swap(fresh);
+    // The enumeration looked for the links again
+    unlinked_.clear();
+}
+
+bool PortMonitor::resolveLinks()
+{
+    bool changed = false;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    for (auto it = unlinked_.begin(); it != unlinked_.end();) {
+        auto entry = table_.find(it->first);
+        string link = by_id_link("/dev", it->first.substr(it->first.rfind('/') + 1));
+        if (entry != table_.end() && !link.empty()) {
+            entry->second.by_id_path = link;
+            changed = true;
+        }
+        if (entry == table_.end() || !link.empty() || now >= it->second) {
+            it = unlinked_.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    return changed;
+}
+
+size_t
+PortMonitor::runOnce(uint32_t timeout)
+{
+    int wait_ms = timeout == Timeout::max() ? -1 : static_cast<int>(std::min<uint32_t>(timeout, INT_MAX));
+    if (!unlinked_.empty() && (wait_ms == -1 || wait_ms > by_id_poll_ms)) {
+        wait_ms = by_id_poll_ms;
+    }
+    pollfd fds[2] = { { socket_fd_, POLLIN, 0 }, { wake_fd_, POLLIN, 0 } };
+    int count = poll(fds, 2, wait_ms);
+    if (count < 0) {
+        if (errno != EINTR) {
+            THROW(IOException, errno);
+        }
+        return 0;
+    }
+    if (fds[1].revents & POLLIN) {
+        uint64_t value;
+        ssize_t ignored = ::read(wake_fd_, &value, sizeof(value));
+        (void)ignored;
+    }
+
+    vector<Change> changes;
+    bool changed = fds[0].revents != 0 && receive(changes);
+    if (!unlinked_.empty() && resolveLinks()) {
+        changed = true;
+    }
+    if (!changed) {
+        return 0;
+    }
+    // Publish first so callbacks that look at ports() see the change
+    publish();
+    for (const Change& change : changes) {
+        const PortCallback& callback = change.added ? callbacks_.on_add : callbacks_.on_remove;
+        if (callback) {
+            callback(change.info);
+        }
+    }
+    return changes.size();
+}
+
+void PortMonitor::run()
+{
+    while (!stopped_) {
+        runOnce(Timeout::max());
+    }
+    stopped_ = false;
+}
+
+void PortMonitor::stop()
+{
+    stopped_ = true;
+    uint64_t value = 1;
+    ssize_t ignored = ::write(wake_fd_, &value, sizeof(value));
+    (void)ignored;
+}
+
+#endif // defined(__linux__)
@@ -0,0 +1,321 @@
+/* Epoll based multi-port event loop, see serial/reactor.h */
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "serial/impl/unix.h"
+#include "serial/reactor.h"
+
+using serial::IOException;
+using serial::PortNotOpenedException;
+using serial::Reactor;
+using serial::Serial;
+using serial::SerialException;
+using std::shared_ptr;
+
+using Clock = std::chrono::steady_clock;
+
+// Upper bound on the bytes handed to one data callback
+static const size_t reactor_buffer_size = 4096;
+
+// Upper bound on the events taken from epoll per iteration
+static const int max_events = 64;
+
+struct Reactor::Entry {
+    Serial* port;
+    Serial::SerialImpl* impl;
+    Callbacks callbacks;
+    int fd;
+    ModemStatus modem;
+    Clock::time_point next_modem_poll;
+};
+
+static bool
+read_modem_status(int fd, Reactor::ModemStatus& modem)
+{
+    int status;
+    if (-1 == ioctl(fd, TIOCMGET, &status)) {
+        return false;
+    }
+    modem.cts = 0 != (status & TIOCM_CTS);
+    modem.dsr = 0 != (status & TIOCM_DSR);
+    modem.ri = 0 != (status & TIOCM_RI);
+    modem.cd = 0 != (status & TIOCM_CD);
+    return true;
+}
+
+Reactor::Reactor(uint32_t modem_poll_interval)
+    : epoll_fd_(-1)
+    , wake_fd_(-1)
+    , modem_poll_interval_(std::max<uint32_t>(modem_poll_interval, 1))
+    , stopped_(false)
+    , buffer_(reactor_buffer_size)
+{
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ == -1) {
+        THROW(IOException, errno);
+    }
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ == -1) {
+        int error = errno;
+        ::close(epoll_fd_);
+        THROW(IOException, error);
+    }
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = wake_fd_;
+    if (-1 == epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event)) {
+        int error = errno;
+        ::close(wake_fd_);
+        ::close(epoll_fd_);
+        THROW(IOException, error);
+    }
+}
+
+Reactor::~Reactor()
+{
+    for (auto& item : entries_) {
+        item.second->impl->setReactor(NULL);
+    }
+    ::close(wake_fd_);
+    ::close(epoll_fd_);
+}
+
+void Reactor::add(Serial& port, const Callbacks& callbacks)
+{
+    if (!port.isOpen()) {
+        throw PortNotOpenedException("Reactor::add");
+    }
+
+    shared_ptr<Entry> entry = std::make_shared<Entry>();
+    entry->port = &port;
+    entry->impl = port.pimpl_.get();
+    entry->callbacks = callbacks;
+    entry->fd = port.pimpl_->getFd();
+    entry->next_modem_poll = Clock::now();
+    if (callbacks.on_modem_change && !read_modem_status(entry->fd, entry->modem)) {
+        THROW(IOException, errno);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entry->impl->getReactor() != NULL || entries_.count(entry->fd) != 0) {
+        throw SerialException("Reactor::add port already registered");
+    }
+
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = entry->fd;
+    if (-1 == epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, entry->fd, &event)) {
+        THROW(IOException, errno);
+    }
+    entries_[entry->fd] = entry;
+    entry->impl->setReactor(this);
+
+    // Bytes left in the port's receive buffer by an earlier readline never
+    // show up as epoll readiness, so service the port once right away.
+    ready_.push_back(entry->fd);
+}
+
+void Reactor::remove(Serial& port)
+{
+    detach(port.pimpl_.get());
+}
+
+void Reactor::detach(Serial::SerialImpl* impl)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        if (it->second->impl == impl) {
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, it->first, NULL);
+            impl->setReactor(NULL);
+            entries_.erase(it);
+            return;
+        }
+    }
+}
+
+size_t
+Reactor::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+shared_ptr<Reactor::Entry>
+Reactor::find(int fd)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(fd);
+    if (it == entries_.end()) {
+        return shared_ptr<Entry>();
+    }
+    return it->second;
+}
+
+void Reactor::unregister(const shared_ptr<Entry>& entry)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(entry->fd);
+    if (it != entries_.end() && it->second == entry) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, entry->fd, NULL);
+        entry->impl->setReactor(NULL);
+        entries_.erase(it);
+    }
+}
+
+void Reactor::service(const shared_ptr<Entry>& entry, bool hangup)
+{
+    try {
+        // Drain what the kernel has queued, a short read means it is empty.
+        // With VMIN 0 an empty tty returns 0 from read() just like a hung up
+        // one, which readNonBlocking reports as a disconnect, so only read
+        // what the port has, or read anyway after a hangup to report it.
+        Serial::SerialImpl* impl = entry->impl;
+        size_t bytes_read;
+        do {
+            size_t available = impl->available();
+            if (available == 0 && !hangup) {
+                break;
+            }
+            hangup = false;
+            bytes_read = impl->readNonBlocking(buffer_.data(),
+                available == 0 ? buffer_.size() : std::min(buffer_.size(), available));
+            if (bytes_read > 0 && entry->callbacks.on_data) {
+                entry->callbacks.on_data(*entry->port, buffer_.data(), bytes_read);
+            }
+        } while (bytes_read == buffer_.size() && find(entry->fd) == entry);
+    }
+    catch (const SerialException& error) {
+        unregister(entry);
+        if (entry->callbacks.on_error) {
+            entry->callbacks.on_error(*entry->port, error);
+        }
+    }
+}
+
+void Reactor::pollModemLines()
+{
+    std::vector<shared_ptr<Entry>> due;
+    Clock::time_point now = Clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& item : entries_) {
+            if (item.second->callbacks.on_modem_change && item.second->next_modem_poll <= now) {
+                due.push_back(item.second);
+            }
+        }
+    }
+
+    for (auto& entry : due) {
+        entry->next_modem_poll = now + std::chrono::milliseconds(modem_poll_interval_);
+        ModemStatus modem;
+        if (!read_modem_status(entry->fd, modem)) {
+            int error = errno;
+            unregister(entry);
+            if (entry->callbacks.on_error) {
+                entry->callbacks.on_error(*entry->port, IOException(__FILE__, __LINE__, error));
+            }
+            continue;
+        }
+        if (modem.cts != entry->modem.cts || modem.dsr != entry->modem.dsr
+            || modem.ri != entry->modem.ri || modem.cd != entry->modem.cd) {
+            entry->modem = modem;
+            entry->callbacks.on_modem_change(*entry->port, modem);
+        }
+    }
+}
+
+size_t
+Reactor::runOnce(uint32_t timeout)
+{
+    std::vector<int> ready;
+    bool watch_modem = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ready.swap(ready_);
+        for (auto& item : entries_) {
+            if (item.second->callbacks.on_modem_change) {
+                watch_modem = true;
+                break;
+            }
+        }
+    }
+
+    int wait_ms = timeout == Timeout::max() ? -1 : static_cast<int>(std::min<uint32_t>(timeout, INT_MAX));
+    if (!ready.empty()) {
+        wait_ms = 0;
+    }
+    else if (watch_modem && (wait_ms == -1 || static_cast<uint32_t>(wait_ms) > modem_poll_interval_)) {
+        wait_ms = static_cast<int>(modem_poll_interval_);
+    }
+
+    epoll_event events[max_events];
+    int count = epoll_wait(epoll_fd_, events, max_events, wait_ms);
+    if (count < 0) {
+        if (errno != EINTR) {
+            THROW(IOException, errno);
+        }
+        count = 0;
+    }
+
+    std::vector<int> hangups;
+
+    for (int i = 0; i < count; ++i) {
+        if (events[i].data.fd == wake_fd_) {
+            uint64_t value;
+            ssize_t ignored = ::read(wake_fd_, &value, sizeof(value));
+            (void)ignored;
+            continue;
+        }
+        if (std::find(ready.begin(), ready.end(), events[i].data.fd) == ready.end()) {
+            ready.push_back(events[i].data.fd);
+        }
+        if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+            hangups.push_back(events[i].data.fd);
+        }
+    }
+
+    size_t serviced = 0;
+    for (int fd : ready) {
+        shared_ptr<Entry> entry = find(fd);
+        if (entry) {
+            service(entry, std::find(hangups.begin(), hangups.end(), fd) != hangups.end());
+            ++serviced;
+        }
+    }
+
+    if (watch_modem) {
+        pollModemLines();
+    }
+    return serviced;
+}
+
+void Reactor::run()
+{
+    while (!stopped_) {
+        runOnce(Timeout::max());
+    }
+    stopped_ = false;
+}
+
+void Reactor::stop()
+{
+    stopped_ = true;
+    uint64_t value = 1;
+    ssize_t ignored = ::write(wake_fd_, &value, sizeof(value));
+    (void)ignored;
+}
+
+#endif // defined(__linux__)
@@ -23,7 +23,11 @@ using std::vector;
 using serial::bytesize_t;
 using serial::flowcontrol_t;
 using serial::IOException;
+using serial::LatencyStats;
 using serial::parity_t;
+using serial::PortConfig;
+using serial::PortStats;
+using serial::readmode_t;
 using serial::Serial;
 using serial::SerialException;
 using serial::stopbits_t;
@@ -67,3 +71,357 @@ private:
     SerialImpl* pimpl_;
 };
 
+
+Serial::Serial(const string& port, uint32_t baudrate, serial::Timeout timeout,
+    bytesize_t bytesize, parity_t parity, stopbits_t stopbits,
+    flowcontrol_t flowcontrol)
+    : port_(port)
+    , pimpl_(new SerialImpl(port, baudrate, bytesize, parity,
+          stopbits, flowcontrol))
+{
+    pimpl_->setTimeout(timeout);
+}
+
+Serial::~Serial()
+{
+}
+
+void Serial::open()
+{
+    pimpl_->open();
+}
+
+void Serial::close()
+{
+    pimpl_->close();
+}
+
+void Serial::cancel()
+{
+    // No lock, the whole point is to reach a thread that holds one
+    pimpl_->cancel();
+}
+
+bool Serial::isOpen() const
+{
+    return pimpl_->isOpen();
+}
+
+size_t
+Serial::available()
+{
+    return pimpl_->available();
+}
+
+bool Serial::waitReadable(uint32_t timeout)
+{
+    return pimpl_->waitReadable(timeout);
+}
+
+void Serial::waitByteTimes(size_t count)
+{
+    pimpl_->waitByteTimes(count);
+}
+
+size_t
+Serial::read(uint8_t* buffer, size_t size)
+{
+    ScopedReadLock lock(this->pimpl_.get());
+    return this->pimpl_->read(buffer, size);
+}
+
+size_t
+Serial::readv(const iovec* iov, size_t count)
+{
+    ScopedReadLock lock(this->pimpl_.get());
+    return this->pimpl_->readv(iov, count);
+}
+
+size_t
+Serial::readline(string& buffer, size_t size, string eol)
+{
+    ScopedReadLock lock(this->pimpl_.get());
+    return this->pimpl_->readline(buffer, size, eol);
+}
+
+vector<string>
+Serial::readlines(size_t size, string eol)
+{
+    ScopedReadLock lock(this->pimpl_.get());
+    return this->pimpl_->readlines(size, eol);
+}
+
+size_t
+Serial::write(const uint8_t* data, size_t size)
+{
+    ScopedWriteLock lock(this->pimpl_.get());
+    return this->pimpl_->write(data, size);
+}
+
+size_t
+Serial::writePriority(const uint8_t* data, size_t size)
+{
+    // No ScopedWriteLock, that is what lets it overtake a bulk write
+    return this->pimpl_->writePriority(data, size);
+}
+
+size_t
+Serial::writev(const iovec* iov, size_t count)
+{
+    ScopedWriteLock lock(this->pimpl_.get());
+    return this->pimpl_->writev(iov, count);
+}
+
+void Serial::writeAsync(std::vector<uint8_t> data, serial::WriteCallback callback)
+{
+    pimpl_->writeAsync(std::move(data), std::move(callback));
+}
+
+void Serial::waitAsyncWrites()
+{
+    pimpl_->waitAsyncWrites();
+}
+
+void Serial::setPort(const string& port)
+{
+    // Before the locks: the writer needs the write lock to finish its batch,
+    // and close() waits for the writer
+    pimpl_->stopAsyncWriter();
+    ScopedReadLock rlock(this->pimpl_.get());
+    ScopedWriteLock wlock(this->pimpl_.get());
+    bool was_open = pimpl_->isOpen();
+    if (was_open)
+        close();
+    port_ = port;
+    pimpl_->setPort(port);
+    if (was_open)
+        open();
+}
+
+const string&
+Serial::getPort() const
+{
+    return port_;
+}
+
+void Serial::setTimeout(const serial::Timeout& timeout)
+{
+    pimpl_->setTimeout(timeout);
+}
+
+void Serial::setTimeout(const serial::MicrosecondTimeout& timeout)
+{
+    pimpl_->setTimeout(timeout);
+}
+
+serial::Timeout
+Serial::getTimeout() const
+{
+    return pimpl_->getTimeout();
+}
+
+serial::MicrosecondTimeout
+Serial::getMicrosecondTimeout() const
+{
+    return pimpl_->getMicrosecondTimeout();
+}
+
+void Serial::setBaudrate(uint32_t baudrate)
+{
+    pimpl_->setBaudrate(baudrate);
+}
+
+uint32_t
+Serial::getBaudrate() const
+{
+    return uint32_t(pimpl_->getBaudrate());
+}
+
+void Serial::setBytesize(bytesize_t bytesize)
+{
+    pimpl_->setBytesize(bytesize);
+}
+
+bytesize_t
+Serial::getBytesize() const
+{
+    return pimpl_->getBytesize();
+}
+
+void Serial::setParity(parity_t parity)
+{
+    pimpl_->setParity(parity);
+}
+
+parity_t
+Serial::getParity() const
+{
+    return pimpl_->getParity();
+}
+
+void Serial::setStopbits(stopbits_t stopbits)
+{
+    pimpl_->setStopbits(stopbits);
+}
+
+stopbits_t
+Serial::getStopbits() const
+{
+    return pimpl_->getStopbits();
+}
+
+void Serial::setFlowcontrol(flowcontrol_t flowcontrol)
+{
+    pimpl_->setFlowcontrol(flowcontrol);
+}
+
+flowcontrol_t
+Serial::getFlowcontrol() const
+{
+    return pimpl_->getFlowcontrol();
+}
+
+void Serial::configure(const PortConfig& config)
+{
+    pimpl_->configure(config);
+}
+
+PortConfig
+Serial::getConfig() const
+{
+    return pimpl_->getConfig();
+}
+
+void Serial::setReadMode(readmode_t readmode)
+{
+    ScopedReadLock lock(this->pimpl_.get());
+    pimpl_->setReadMode(readmode);
+}
+
+readmode_t
+Serial::getReadMode() const
+{
+    return pimpl_->getReadMode();
+}
+
+void Serial::setLowLatency(bool low_latency)
+{
+    pimpl_->setLowLatency(low_latency);
+}
+
+bool Serial::getLowLatency() const
+{
+    return pimpl_->getLowLatency();
+}
+
+void Serial::setWritePacing(uint32_t max_queued_ms)
+{
+    pimpl_->setWritePacing(max_queued_ms);
+}
+
+uint32_t Serial::getWritePacing() const
+{
+    return pimpl_->getWritePacing();
+}
+
+PortStats
+Serial::stats() const
+{
+    return pimpl_->stats();
+}
+
+void Serial::resetStats()
+{
+    pimpl_->resetStats();
+}
+
+void Serial::setLatencyTracking(bool latency_tracking)
+{
+    pimpl_->setLatencyTracking(latency_tracking);
+}
+
+bool Serial::getLatencyTracking() const
+{
+    return pimpl_->getLatencyTracking();
+}
+
+LatencyStats
+Serial::latencyStats() const
+{
+    return pimpl_->latencyStats();
+}
+
+void Serial::flush()
+{
+    ScopedReadLock rlock(this->pimpl_.get());
+    ScopedWriteLock wlock(this->pimpl_.get());
+    pimpl_->flush();
+}
+
+size_t
+Serial::outputPending()
+{
+    return pimpl_->outputPending();
+}
+
+bool Serial::waitTransmitted(uint32_t timeout)
+{
+    return pimpl_->waitTransmitted(timeout);
+}
+
+void Serial::flushInput()
+{
+    ScopedReadLock lock(this->pimpl_.get());
+    pimpl_->flushInput();
+}
+
+void Serial::flushOutput()
+{
+    ScopedWriteLock lock(this->pimpl_.get());
+    pimpl_->flushOutput();
+}
+
+void Serial::sendBreak(int duration)
+{
+    pimpl_->sendBreak(duration);
+}
+
+void Serial::setBreak(bool level)
+{
+    pimpl_->setBreak(level);
+}
+
+void Serial::setRTS(bool level)
+{
+    pimpl_->setRTS(level);
+}
+
+void Serial::setDTR(bool level)
+{
+    pimpl_->setDTR(level);
+}
+
+bool Serial::waitForChange()
+{
+    return pimpl_->waitForChange();
+}
+
+bool Serial::getCTS()
+{
+    return pimpl_->getCTS();
+}
+
+bool Serial::getDSR()
+{
+    return pimpl_->getDSR();
+}
+
+bool Serial::getRI()
+{
+    return pimpl_->getRI();
+}
+
+bool Serial::getCD()
+{
+    return pimpl_->getCD();
+}
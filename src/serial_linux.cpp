@@ -5,12 +5,16 @@
 
 #if !defined(_WIN32)
 
+#include <algorithm>
+#include <atomic>
+#include <climits>
 #include <errno.h>
 #include <fcntl.h>
 #include <paths.h>
 #include <pthread.h>
 #include <sstream>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
 #include <sys/param.h>
@@ -34,18 +38,23 @@ struct termios2 {
 
 #if defined(__linux__)
 #include <linux/serial.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #endif
 
-#include <sys/select.h>
+#include <poll.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <time.h>
 #ifdef __MACH__
 #include <AvailabilityMacros.h>
-#include <mach/clock.h>
-#include <mach/mach.h>
 #endif
 
+#include "serial/executor.h"
+#include "serial/reactor.h"
+#include "serial/impl/delimiter.h"
 #include "serial/impl/unix.h"
+#include "serial/impl/uring.h"
 
 #ifndef TIOCINQ
 #ifdef FIONREAD
@@ -59,71 +68,430 @@ struct termios2 {
 #include <IOKit/serial/ioss.h>
 #endif
 
+using serial::find_delimiter;
 using serial::IOException;
-using serial::MillisecondTimer;
+using serial::IoCursor;
+using serial::LatencyRecorder;
+using serial::LatencyStats;
+using serial::Deadline;
+using serial::MicrosecondTimeout;
+using serial::PortConfig;
+using serial::PortStats;
+using serial::StatsCounters;
 using serial::PortNotOpenedException;
 using serial::Serial;
 using serial::SerialException;
+#if defined(__linux__)
+using serial::Uring;
+#endif
 using std::invalid_argument;
 using std::string;
 using std::stringstream;
+using std::vector;
+using std::chrono::nanoseconds;
+
+// Number of bytes requested from the port each time the receive buffer is
+// refilled. The tty layer hands data over in pages, so one page per read()
+// keeps the syscall count low without growing the buffer needlessly.
+static const size_t read_chunk_size = 4096;
+
+// Shortest sleep between output queue checks in waitTransmitted and paced
+// writes
+static const nanoseconds min_drain_poll(100000);
+
+// Most queued buffers, and roughly the most bytes, the async writer merges
+// into one writev() call
+static const size_t async_batch_max = 64;
+static const size_t async_batch_bytes = 65536;
+
+// Longest timeout handed to the clock. Far enough out to mean "never" while
+// keeping steady_clock arithmetic clear of overflow.
+static const nanoseconds max_timeout = std::chrono::hours(24 * 365 * 100);
+
+// Submission entries per readmode_uring ring: the cancel poll, the read, its
+// timeout and an abort of the read are the most in flight at once
+static const unsigned uring_entries = 8;
+
+// user_data of the readmode_uring entries
+enum {
+    uring_read = 1,
+    uring_timeout,
+    uring_cancel_poll,
+    uring_abort
+};
 
-MillisecondTimer::MillisecondTimer(const uint32_t millis)
-    : expiry(timespec_now())
+// Nanoseconds since start, for the wait time counters
+static uint64_t
+elapsed_ns(std::chrono::steady_clock::time_point start)
 {
-    int64_t tv_nsec = expiry.tv_nsec + (millis * 1e6);
-    if (tv_nsec >= 1e9) {
-        int64_t sec_diff = tv_nsec / static_cast<int>(1e9);
-        expiry.tv_nsec = tv_nsec % static_cast<int>(1e9);
-        expiry.tv_sec += sec_diff;
+    return static_cast<uint64_t>(std::chrono::duration_cast<nanoseconds>(
+        std::chrono::steady_clock::now() - start)
+                                     .count());
+}
+
+// Times one read or write call for the latency histograms. Does nothing,
+// not even read the clock, when latency tracking is off.
+class LatencyTimer {
+public:
+    LatencyTimer(LatencyRecorder* recorder, LatencyRecorder::histogram_t histogram)
+        : recorder_(recorder)
+        , histogram_(histogram)
+        , first_byte_seen_(false)
+    {
+        if (recorder_ != NULL) {
+            start_ = std::chrono::steady_clock::now();
+        }
     }
-    else {
-        expiry.tv_nsec = tv_nsec;
+
+    ~LatencyTimer()
+    {
+        if (recorder_ != NULL) {
+            recorder_->record(histogram_, elapsed_ns(start_));
+        }
+    }
+
+    // Call whenever the byte count grows, the first non-zero count marks the
+    // time to first byte
+    void gotBytes(size_t bytes)
+    {
+        if (recorder_ != NULL && !first_byte_seen_ && bytes > 0) {
+            first_byte_seen_ = true;
+            recorder_->record(LatencyRecorder::read_first_byte, elapsed_ns(start_));
+        }
+    }
+
+private:
+    LatencyRecorder* recorder_;
+    LatencyRecorder::histogram_t histogram_;
+    bool first_byte_seen_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+Deadline::Deadline(nanoseconds timeout)
+    : expiry_(std::chrono::steady_clock::now() + std::min(timeout, max_timeout))
+{
+}
+
+nanoseconds
+Deadline::remaining() const
+{
+    return expiry_ - std::chrono::steady_clock::now();
+}
+
+IoCursor::IoCursor(const iovec* iov, size_t count)
+    : iov_(iov)
+    , count_(count)
+    , index_(0)
+    , size_(0)
+    , done_(0)
+{
+    for (size_t i = 0; i < count; ++i) {
+        size_ += iov[i].iov_len;
+    }
+    current_.iov_base = NULL;
+    current_.iov_len = 0;
+    if (count > 0) {
+        current_ = iov[0];
+    }
+    // Step over leading empty buffers
+    advance(0);
+}
+
+const iovec*
+IoCursor::pending(int& count) const
+{
+    if (current_.iov_len != iov_[index_].iov_len) {
+        count = 1;
+        return &current_;
+    }
+    count = static_cast<int>(std::min<size_t>(count_ - index_, IOV_MAX));
+    return iov_ + index_;
+}
+
+void IoCursor::advance(size_t bytes)
+{
+    done_ += bytes;
+    while (index_ < count_) {
+        if (bytes < current_.iov_len) {
+            current_.iov_base = static_cast<uint8_t*>(current_.iov_base) + bytes;
+            current_.iov_len -= bytes;
+            return;
+        }
+        bytes -= current_.iov_len;
+        if (++index_ < count_) {
+            current_ = iov_[index_];
+        }
+    }
+}
+
+// A single buffer goes through plain read()/write(), which is what read()
+// and write() always issued
+static ssize_t
+read_iov(int fd, const iovec* iov, int count)
+{
+    if (count == 1) {
+        return ::read(fd, iov->iov_base, iov->iov_len);
+    }
+    return ::readv(fd, iov, count);
+}
+
+static ssize_t
+write_iov(int fd, const iovec* iov, int count)
+{
+    if (count == 1) {
+        return ::write(fd, iov->iov_base, iov->iov_len);
     }
+    return ::writev(fd, iov, count);
+}
+
+// Converts a microsecond timeout, saturating at max_timeout. This also maps
+// MicrosecondTimeout::max() to "never".
+static nanoseconds
+nanoseconds_from_us(uint64_t micros)
+{
+    const uint64_t limit_us = static_cast<uint64_t>(max_timeout.count()) / 1000;
+    return nanoseconds(std::min(micros, limit_us) * 1000);
+}
+
+// The inter byte timeout as a wait bound. Both 0 and MicrosecondTimeout::max()
+// disable it, so neither cuts a wait short.
+static nanoseconds
+inter_byte_timeout_ns(uint64_t micros)
+{
+    return micros == 0 ? max_timeout : nanoseconds_from_us(micros);
 }
 
-int64_t
-MillisecondTimer::remaining()
+// Total timeout t_c + (t_m * N), saturating instead of wrapping around.
+static nanoseconds
+total_timeout_ns(uint64_t constant_us, uint64_t multiplier_us, size_t count)
 {
-    timespec now(timespec_now());
-    int64_t millis = (expiry.tv_sec - now.tv_sec) * 1e3;
-    millis += (expiry.tv_nsec - now.tv_nsec) / 1e6;
-    return millis;
+    const uint64_t limit_us = static_cast<uint64_t>(max_timeout.count()) / 1000;
+    uint64_t total_us = std::min(constant_us, limit_us);
+    if (count != 0) {
+        total_us += std::min<uint64_t>(multiplier_us, limit_us / count) * count;
+    }
+    return nanoseconds_from_us(total_us);
 }
 
-timespec
-MillisecondTimer::timespec_now()
+static timespec
+timespec_from_ns(nanoseconds timeout)
 {
     timespec time;
-#ifdef __MACH__ // OS X does not have clock_gettime, use clock_get_time
-    clock_serv_t cclock;
-    mach_timespec_t mts;
-    host_get_clock_service(mach_host_self(), SYSTEM_CLOCK, &cclock);
-    clock_get_time(cclock, &mts);
-    mach_port_deallocate(mach_task_self(), cclock);
-    time.tv_sec = mts.tv_sec;
-    time.tv_nsec = mts.tv_nsec;
+    int64_t nanos = std::max<int64_t>(timeout.count(), 0);
+    time.tv_sec = static_cast<time_t>(nanos / 1000000000);
+    time.tv_nsec = static_cast<long>(nanos % 1000000000);
+    return time;
+}
+
+// Converts to the millisecond timeout of poll/epoll_wait, rounding up so a
+// sub-millisecond wait does not turn into a non-blocking one.
+static int
+poll_timeout_from_ns(nanoseconds timeout)
+{
+    if (timeout <= nanoseconds::zero()) {
+        return 0;
+    }
+    int64_t millis = (timeout.count() + 999999) / 1000000;
+    return static_cast<int>(std::min<int64_t>(millis, INT_MAX));
+}
+
+// poll with nanosecond resolution where ppoll is available.
+static int
+poll_ns(pollfd* fds, nfds_t count, nanoseconds timeout)
+{
+#if defined(__linux__)
+    timespec timeout_ts = timespec_from_ns(timeout);
+    return ppoll(fds, count, &timeout_ts, NULL);
 #else
-    clock_gettime(CLOCK_MONOTONIC, &time);
+    return ::poll(fds, count, poll_timeout_from_ns(timeout));
 #endif
-    return time;
 }
 
-timespec
-timespec_from_ms(const uint32_t millis)
+#if defined(__linux__)
+// epoll_wait with nanosecond resolution where the kernel has epoll_pwait2
+// (Linux 5.11), falling back to whole milliseconds otherwise. Zero, "never"
+// and whole millisecond timeouts go to plain epoll_wait, which is cheaper.
+static int
+epoll_wait_ns(int epoll_fd, epoll_event* events, int max_events, nanoseconds timeout)
 {
-    timespec time;
-    time.tv_sec = millis / 1e3;
-    time.tv_nsec = (millis - (time.tv_sec * 1e3)) * 1e6;
-    return time;
+    if (timeout <= nanoseconds::zero()) {
+        return epoll_wait(epoll_fd, events, max_events, 0);
+    }
+    if (timeout >= max_timeout) {
+        return epoll_wait(epoll_fd, events, max_events, -1);
+    }
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 35)
+    static std::atomic<bool> have_pwait2(true);
+    if (timeout.count() % 1000000 != 0 && have_pwait2.load(std::memory_order_relaxed)) {
+        timespec timeout_ts = timespec_from_ns(timeout);
+        int r = epoll_pwait2(epoll_fd, events, max_events, &timeout_ts, NULL);
+        if (r != -1 || errno != ENOSYS) {
+            return r;
+        }
+        have_pwait2.store(false, std::memory_order_relaxed);
+    }
+#endif
+    return epoll_wait(epoll_fd, events, max_events, poll_timeout_from_ns(timeout));
+}
+#endif
+
+// Descriptor behind Serial::cancel, or -1 where there is no eventfd.
+static int
+open_cancel_fd()
+{
+#if defined(__linux__)
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd == -1) {
+        THROW(IOException, errno);
+    }
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+static void
+signal_cancel(int fd)
+{
+    if (fd != -1) {
+        uint64_t value = 1;
+        ssize_t ignored = ::write(fd, &value, sizeof(value));
+        (void)ignored;
+    }
+}
+
+// Consumes a pending cancel, returns whether there was one. Several
+// cancel() calls in a row collapse into one.
+static bool
+take_cancel(int fd)
+{
+    uint64_t value;
+    return fd != -1 && ::read(fd, &value, sizeof(value)) == sizeof(value);
+}
+
+// Sleeps for timeout or until a cancel is pending, which is left for the
+// caller to take. Poll skips a negative fd, so this is a plain sleep then.
+static bool
+sleep_unless_cancelled(int fd, nanoseconds timeout)
+{
+    pollfd event = { fd, POLLIN, 0 };
+    return poll_ns(&event, 1, timeout) > 0;
+}
+
+static bool
+uring_supported()
+{
+#if defined(__linux__)
+    return Uring::supported();
+#else
+    return false;
+#endif
 }
 
+// tcsetattr that tolerates drivers pinning the parity and character size.
+// A pty keeps CS8 without parity and, when asked again for parity it
+// already dropped, fails with EINVAL although it applied everything else.
+static int
+set_termios(int fd, const termios& options)
+{
+    if (0 == ::tcsetattr(fd, TCSANOW, &options)) {
+        return 0;
+    }
+    if (errno != EINVAL) {
+        return -1;
+    }
+    termios applied;
+    if (-1 == ::tcgetattr(fd, &applied)) {
+        return -1;
+    }
+    const tcflag_t pinned = CSIZE | PARENB | PARODD;
+    if ((applied.c_cflag & ~pinned) != (options.c_cflag & ~pinned)
+        || applied.c_iflag != options.c_iflag || applied.c_oflag != options.c_oflag
+        || applied.c_lflag != options.c_lflag
+        || memcmp(applied.c_cc, options.c_cc, sizeof(applied.c_cc)) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+#if defined(__linux__)
+// Sysfs latency_timer of a USB serial adapter, found the same way
+// list_ports walks /sys/class/tty/<name>/device. Returns "" when the
+// driver has no such attribute (everything but FTDI style adapters).
+static string
+latency_timer_path(const string& port)
+{
+    char* real_path = realpath(port.c_str(), NULL);
+    if (real_path == NULL) {
+        return string();
+    }
+    string device_name(real_path);
+    free(real_path);
+
+    size_t pos = device_name.rfind('/');
+    if (pos != string::npos) {
+        device_name.erase(0, pos + 1);
+    }
+    if (device_name.compare(0, 6, "ttyUSB") != 0) {
+        return string();
+    }
+
+    string path = "/sys/class/tty/" + device_name + "/device/latency_timer";
+    if (access(path.c_str(), F_OK) != 0) {
+        return string();
+    }
+    return path;
+}
+
+// Reads a small decimal sysfs attribute, -1 with errno set on failure
+static int
+read_sysfs_int(const string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+    char text[16];
+    ssize_t length = ::read(fd, text, sizeof(text) - 1);
+    int error = errno;
+    ::close(fd);
+    if (length <= 0) {
+        errno = length == 0 ? EIO : error;
+        return -1;
+    }
+    text[length] = '\0';
+    return atoi(text);
+}
+
+static bool
+write_sysfs_int(const string& path, int value)
+{
+    int fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    char text[16];
+    int length = snprintf(text, sizeof(text), "%d", value);
+    ssize_t written = ::write(fd, text, static_cast<size_t>(length));
+    int error = errno;
+    ::close(fd);
+    errno = error;
+    return written == length;
+}
+#endif
+
 Serial::SerialImpl::SerialImpl(const string& port, unsigned long baudrate,
     bytesize_t bytesize,
     parity_t parity, stopbits_t stopbits,
     flowcontrol_t flowcontrol)
     : port_(port)
     , fd_(-1)
+    , epoll_fd_(-1)
+    , read_fd_(-1)
+    , read_cancel_fd_(-1)
+    , write_cancel_fd_(-1)
+    , read_cancelled_(false)
     , is_open_(false)
     , xonxoff_(false)
     , rtscts_(false)
@@ -132,20 +500,60 @@ Serial::SerialImpl::SerialImpl(const string& port, unsigned long baudrate,
     , bytesize_(bytesize)
     , stopbits_(stopbits)
     , flowcontrol_(flowcontrol)
+    , read_mode_(readmode_poll)
+    , read_vmin_(1)
+    , termios_()
+    , uring_cancel_armed_(false)
+    , low_latency_(false)
+    , saved_latency_timer_(-1)
+    , read_buffer_begin_(0)
+    , read_buffer_end_(0)
+    , write_pacing_ms_(0)
+    , priority_writers_(0)
+    , latency_(NULL)
+    , writer_running_(false)
+    , writer_sleeping_(false)
+    , writer_stopping_(false)
+    , async_pending_(0)
+    , async_accepting_(false)
+    , async_submitters_(0)
+    , executor_(NULL)
+    , reactor_(NULL)
 {
+    read_cancel_fd_ = open_cancel_fd();
+    try {
+        write_cancel_fd_ = open_cancel_fd();
+        if (port_.empty() == false)
+            open();
+    }
+    catch (...) {
+        closeCancelDescriptors();
+        throw;
+    }
     pthread_mutex_init(&this->read_mutex, NULL);
     pthread_mutex_init(&this->write_mutex, NULL);
-    if (port_.empty() == false)
-        open();
 }
 
 Serial::SerialImpl::~SerialImpl()
 {
     close();
+    closeCancelDescriptors();
     pthread_mutex_destroy(&this->read_mutex);
     pthread_mutex_destroy(&this->write_mutex);
 }
 
+void Serial::SerialImpl::closeCancelDescriptors()
+{
+    if (read_cancel_fd_ != -1) {
+        ::close(read_cancel_fd_);
+        read_cancel_fd_ = -1;
+    }
+    if (write_cancel_fd_ != -1) {
+        ::close(write_cancel_fd_);
+        write_cancel_fd_ = -1;
+    }
+}
+
 void Serial::SerialImpl::open()
 {
     if (port_.empty()) {
@@ -155,6 +563,10 @@ void Serial::SerialImpl::open()
         throw SerialException("Serial port already open.");
     }
 
+    // A cancel() aimed at the previous session does not carry over
+    take_cancel(read_cancel_fd_);
+    take_cancel(write_cancel_fd_);
+
     fd_ = ::open(port_.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
 
     if (fd_ == -1) {
@@ -171,8 +583,87 @@ void Serial::SerialImpl::open()
         }
     }
 
-    reconfigurePort();
+#if defined(__linux__)
+    // Read waits block on a per-port epoll set rather than select, which
+    // breaks once descriptors go past FD_SETSIZE and rebuilds its set on
+    // every call. The set also holds the eventfd cancel() signals.
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ != -1) {
+        epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = fd_;
+        bool added = -1 != epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd_, &event);
+        if (added) {
+            event.data.fd = read_cancel_fd_;
+            added = -1 != epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, read_cancel_fd_, &event);
+        }
+        if (!added) {
+            int error = errno;
+            ::close(epoll_fd_);
+            epoll_fd_ = -1;
+            errno = error;
+        }
+    }
+    if (epoll_fd_ == -1) {
+        int error = errno;
+        ::close(fd_);
+        fd_ = -1;
+        THROW(IOException, error);
+    }
+#endif
+
+    try {
+        if (read_mode_ != readmode_poll) {
+            openReadDescriptor();
+        }
+        if (read_mode_ == readmode_uring && !openUring()) {
+            ::close(read_fd_);
+            read_fd_ = -1;
+            read_mode_ = readmode_poll;
+        }
+        reconfigurePort();
+        if (low_latency_) {
+            applyLowLatency(true);
+        }
+    }
+    catch (...) {
+        closeDescriptors();
+        throw;
+    }
     is_open_ = true;
+    async_accepting_.store(true);
+}
+
+bool Serial::SerialImpl::openUring()
+{
+#if defined(__linux__)
+    try {
+        uring_.reset(new Uring(uring_entries));
+        uring_cancel_armed_ = false;
+        return true;
+    }
+    catch (const IOException&) {
+        // No locked memory left for the ring, or io_uring was disabled
+        // after the probe
+    }
+#endif
+    return false;
+}
+
+void Serial::SerialImpl::openReadDescriptor()
+{
+    // O_NONBLOCK belongs to the open file description, so kernel and
+    // io_uring mode reads get a second, blocking description of the same
+    // tty, io_uring would fail reads on fd_ with EAGAIN instead of waiting.
+    // Everything else keeps using the non-blocking fd_.
+    do {
+        read_fd_ = ::open(port_.c_str(), O_RDONLY | O_NOCTTY | O_CLOEXEC);
+    } while (read_fd_ == -1 && errno == EINTR);
+
+    if (read_fd_ == -1) {
+        THROW(IOException, errno);
+    }
 }
 
 void Serial::SerialImpl::reconfigurePort()
@@ -491,16 +982,41 @@ void Serial::SerialImpl::reconfigurePort()
 #endif
 
     // http://www.unixwiz.net/techtips/termios-vmin-vtime.html
-    // this basically sets the read call up to be a polling read,
-    // but we are using select to ensure there is data available
-    // to read before each call, so we should never needlessly poll
-    options.c_cc[VMIN] = 0;
-    options.c_cc[VTIME] = 0;
-
-    // activate settings
-    ::tcsetattr(fd_, TCSANOW, &options);
+    if (read_mode_ == readmode_kernel) {
+        // Blocking reads return once VMIN bytes arrived or once VTIME tenths
+        // of a second passed without a byte after the first one. VTIME
+        // carries the inter byte timeout, rounded up to whole tenths; 0 and
+        // MicrosecondTimeout::max() both disable it. With VTIME 0 epoll only
+        // reports the port readable once VMIN bytes are waiting, so VMIN
+        // stays 1 and bytes short of it are never stranded. Otherwise
+        // readKernel() raises VMIN to the request size.
+        if (timeout_.inter_byte_timeout == 0
+            || timeout_.inter_byte_timeout == MicrosecondTimeout::max()) {
+            options.c_cc[VTIME] = 0;
+            read_vmin_ = 1;
+        }
+        else {
+            uint64_t deciseconds = (timeout_.inter_byte_timeout + 99999) / 100000;
+            options.c_cc[VTIME] = static_cast<cc_t>(std::min<uint64_t>(deciseconds, 255));
+        }
+        options.c_cc[VMIN] = read_vmin_;
+    }
+    else if (read_mode_ == readmode_uring) {
+        // Ring reads on read_fd_ complete as soon as there is a byte, the
+        // linked timeout ends them otherwise
+        options.c_cc[VMIN] = 1;
+        options.c_cc[VTIME] = 0;
+    }
+    else {
+        // this basically sets the read call up to be a polling read,
+        // but we are using epoll to ensure there is data available
+        // to read before each call, so we should never needlessly poll
+        options.c_cc[VMIN] = 0;
+        options.c_cc[VTIME] = 0;
+    }
 
-    // baud rate must be set after configuring the other options otherwise it will be overwritten
+    // baud rate must be set after configuring the other options otherwise it
+    // will be overwritten, but before the settings are activated
     if (custom_baud == false) {
 #ifdef _BSD_SOURCE
         ::cfsetspeed(&options, baud);
@@ -509,7 +1025,13 @@ void Serial::SerialImpl::reconfigurePort()
         ::cfsetospeed(&options, baud);
 #endif
     }
-    else {
+
+    // activate settings
+    if (-1 == set_termios(fd_, options)) {
+        THROW(IOException, errno);
+    }
+
+    if (custom_baud == true) {
         // OS X support
 #if defined(MAC_OS_X_VERSION_10_4) && (MAC_OS_X_VERSION_MIN_REQUIRED >= MAC_OS_X_VERSION_10_4)
         // Starting with Tiger, the IOSSIOSPEED ioctl can be used to set arbitrary baud rates
@@ -569,39 +1091,92 @@ void Serial::SerialImpl::reconfigurePort()
 #endif
     }
 
+    // Read back what the driver applied, custom rates included, so
+    // setReadMinimum() can reapply it without asking again
+    if (tcgetattr(fd_, &termios_) == -1) {
+        THROW(IOException, errno);
+    }
+
     // Update byte_time_ based on the new settings.
-    uint32_t bit_time_ns = 1e9 / baudrate_;
-    byte_time_ns_ = bit_time_ns * (1 + bytesize_ + parity_ + stopbits_);
+    byte_time_ns_ = getConfig().byteTimeNs();
+}
 
-    // Compensate for the stopbits_one_point_five enum being equal to int 3,
-    // and not 1.5.
-    if (stopbits_ == stopbits_one_point_five) {
-        byte_time_ns_ += ((1.5 - stopbits_one_point_five) * bit_time_ns);
-    }
+int Serial::SerialImpl::closeDescriptors()
+{
+    uring_.reset();
+    if (read_fd_ != -1) {
+        ::close(read_fd_);
+        read_fd_ = -1;
+    }
+    if (epoll_fd_ != -1) {
+        ::close(epoll_fd_);
+        epoll_fd_ = -1;
+    }
+    int result = 0;
+    if (fd_ != -1) {
+        // Linux releases the descriptor even when close reports an error
+        result = ::close(fd_);
+        fd_ = -1;
+    }
+    return result;
 }
 
 void Serial::SerialImpl::close()
 {
+#if defined(__linux__)
+    // Also reached from the destructor, the executor must not keep
+    // advancing operations on a port that is going away
+    if (executor_ != NULL) {
+        executor_->detach(this, std::make_exception_ptr(
+                                    PortNotOpenedException("IoExecutor operation")));
+    }
+    // Nor keep the descriptor in its epoll set, where a reused number
+    // would deliver another file's events to this port
+    if (reactor_ != NULL) {
+        reactor_->detach(this);
+    }
+#endif
     if (is_open_ == true) {
-        if (fd_ != -1) {
-            int ret;
-            ret = ::close(fd_);
-            if (ret == 0) {
-                fd_ = -1;
+        // Queued writes fail rather than outlive the descriptor
+        stopAsyncWriter();
+        if (saved_latency_timer_ != -1) {
+            // Give the adapter its old timer back, the port is going away
+            // either way so a failure here is not worth reporting.
+            try {
+                applyLowLatency(false);
             }
-            else {
-                THROW(IOException, errno);
+            catch (const IOException&) {
+                saved_latency_timer_ = -1;
             }
         }
+        int ret = closeDescriptors();
+        int error = errno;
+        clearReadBuffer();
         is_open_ = false;
+        if (ret == -1) {
+            THROW(IOException, error);
+        }
     }
 }
 
+void Serial::SerialImpl::cancel()
+{
+    // Reads and writes wait on separate eventfds, so a blocked reader
+    // cannot swallow the wakeup meant for a blocked writer
+    signal_cancel(read_cancel_fd_);
+    signal_cancel(write_cancel_fd_);
+}
+
 bool Serial::SerialImpl::isOpen() const
 {
     return is_open_;
 }
 
+int Serial::SerialImpl::getFd() const
+{
+    return fd_;
+}
+
 size_t
 Serial::SerialImpl::available()
 {
@@ -613,22 +1188,58 @@ Serial::SerialImpl::available()
         THROW(IOException, errno);
     }
     else {
-        return static_cast<size_t>(count);
+        return static_cast<size_t>(count) + (read_buffer_end_ - read_buffer_begin_);
     }
 }
 
 bool Serial::SerialImpl::waitReadable(uint32_t timeout)
 {
-    // Setup a select call to block for serial data or a timeout
-    fd_set readfds;
-    FD_ZERO(&readfds);
-    FD_SET(fd_, &readfds);
-    timespec timeout_ts(timespec_from_ms(timeout));
-    int r = pselect(fd_ + 1, &readfds, NULL, NULL, &timeout_ts, NULL);
+    return waitReadable(std::chrono::milliseconds(timeout));
+}
+
+bool Serial::SerialImpl::waitReadable(nanoseconds timeout)
+{
+    // Bytes left over in the receive buffer can be read right away
+    if (read_buffer_end_ > read_buffer_begin_) {
+        return true;
+    }
+    return pollReadable(timeout);
+}
+
+bool Serial::SerialImpl::pollReadable(nanoseconds timeout)
+{
+    // Block for serial data, a cancel() or a timeout
+    read_cancelled_ = false;
+    // A zero timeout only checks readiness, there is no wait worth timing
+    // unless the latency histogram wants the sample
+    LatencyRecorder* latency = latency_.load(std::memory_order_acquire);
+    bool timed = latency != NULL || timeout > nanoseconds::zero();
+    std::chrono::steady_clock::time_point wait_start;
+    if (timed) {
+        wait_start = std::chrono::steady_clock::now();
+    }
+#if defined(__linux__)
+    epoll_event event;
+    int r = epoll_wait_ns(epoll_fd_, &event, 1, timeout);
+    bool cancel_pending = r > 0 && event.data.fd == read_cancel_fd_;
+#else
+    pollfd events[2] = { { fd_, POLLIN, 0 }, { read_cancel_fd_, POLLIN, 0 } };
+    int r = poll_ns(events, 2, timeout);
+    bool cancel_pending = r > 0 && events[1].revents != 0;
+#endif
+    StatsCounters::add(stats_.read_wait_calls);
+    if (timed) {
+        uint64_t wait_ns = elapsed_ns(wait_start);
+        StatsCounters::add(stats_.read_wait_time_ns, wait_ns);
+        if (latency != NULL) {
+            latency->record(LatencyRecorder::wait, wait_ns);
+        }
+    }
 
     if (r < 0) {
-        // Select was interrupted
+        // Wait was interrupted, the caller's loop retries
         if (errno == EINTR) {
+            StatsCounters::add(stats_.read_eintr_retries);
             return false;
         }
         // Otherwise there was some error
@@ -638,19 +1249,19 @@ bool Serial::SerialImpl::waitReadable(uint32_t timeout)
     if (r == 0) {
         return false;
     }
-    // This shouldn't happen, if r > 0 our fd has to be in the list!
-    if (!FD_ISSET(fd_, &readfds)) {
-        THROW(IOException, "select reports ready to read, but our fd isn't"
-                           " in the list, this shouldn't happen!");
+    // Woken by cancel(), the caller gives up as on a timeout
+    if (cancel_pending && take_cancel(read_cancel_fd_)) {
+        read_cancelled_ = true;
+        return false;
     }
-    // Data available to read.
+    // Data available to read, or an error/hangup that the read will report.
     return true;
 }
 
 void Serial::SerialImpl::waitByteTimes(size_t count)
 {
-    timespec wait_time = { 0, static_cast<long>(byte_time_ns_ * count) };
-    pselect(0, NULL, NULL, NULL, &wait_time, NULL);
+    timespec wait_time = timespec_from_ns(nanoseconds(static_cast<int64_t>(byte_time_ns_) * static_cast<int64_t>(count)));
+    nanosleep(&wait_time, NULL);
 }
 
 size_t
@@ -660,45 +1271,119 @@ Serial::SerialImpl::read(uint8_t* buf, size_t size)
     if (!is_open_) {
         throw PortNotOpenedException("Serial::read");
     }
-    size_t bytes_read = 0;
+    iovec iov = { buf, size };
+    IoCursor cursor(&iov, 1);
+    return readCursor(cursor);
+}
+
+size_t
+Serial::SerialImpl::readv(const iovec* iov, size_t count)
+{
+    if (!is_open_) {
+        throw PortNotOpenedException("Serial::readv");
+    }
+    IoCursor cursor(iov, count);
+    return readCursor(cursor);
+}
 
-    // Calculate total timeout in milliseconds t_c + (t_m * N)
-    long total_timeout_ms = timeout_.read_timeout_constant;
-    total_timeout_ms += timeout_.read_timeout_multiplier * static_cast<long>(size);
-    MillisecondTimer total_timeout(total_timeout_ms);
+size_t
+Serial::SerialImpl::readCursor(IoCursor& cursor)
+{
+    const size_t size = cursor.size();
+    LatencyTimer timer(latency_.load(std::memory_order_acquire), LatencyRecorder::read);
+    const iovec* pending;
+    int pending_count;
+
+    // Hand out bytes left over from a previous readline first
+    while (!cursor.finished()) {
+        pending = cursor.pending(pending_count);
+        size_t bytes_copied = readFromBuffer(static_cast<uint8_t*>(pending->iov_base),
+            pending->iov_len);
+        if (bytes_copied == 0) {
+            break;
+        }
+        cursor.advance(bytes_copied);
+    }
+    timer.gotBytes(cursor.done());
+    if (cursor.finished()) {
+        StatsCounters::add(stats_.bytes_read, size);
+        return size;
+    }
+
+    // Calculate total timeout t_c + (t_m * N)
+    Deadline total_timeout(total_timeout_ns(timeout_.read_timeout_constant,
+        timeout_.read_timeout_multiplier, size));
+    const nanoseconds inter_byte_timeout = inter_byte_timeout_ns(timeout_.inter_byte_timeout);
+
+    if (read_mode_ == readmode_uring) {
+        // A ring read completes right away when bytes are waiting, so there
+        // is no non-blocking attempt first. Like readmode_poll, only the
+        // total timeout ends the read.
+        while (!cursor.finished()) {
+            nanoseconds timeout_remaining = total_timeout.remaining();
+            if (timeout_remaining <= nanoseconds::zero()) {
+                break;
+            }
+            pending = cursor.pending(pending_count);
+            size_t bytes_read_now = readUring(pending, pending_count, timeout_remaining);
+            cursor.advance(bytes_read_now);
+            timer.gotBytes(cursor.done());
+            if (bytes_read_now == 0 || read_cancelled_) {
+                break;
+            }
+        }
+        countRead(cursor.done(), size);
+        return cursor.done();
+    }
 
     // Pre-fill buffer with available bytes
     {
-        ssize_t bytes_read_now = ::read(fd_, buf, size);
+        pending = cursor.pending(pending_count);
+        ssize_t bytes_read_now = read_iov(fd_, pending, pending_count);
+        StatsCounters::add(stats_.read_calls);
         if (bytes_read_now > 0) {
-            bytes_read = bytes_read_now;
+            cursor.advance(static_cast<size_t>(bytes_read_now));
         }
+        timer.gotBytes(cursor.done());
+    }
+
+    if (read_mode_ == readmode_kernel) {
+        // The first byte is only seen once the first VMIN batch returns
+        readKernel(cursor, total_timeout, inter_byte_timeout);
+        timer.gotBytes(cursor.done());
+        countRead(cursor.done(), size);
+        return cursor.done();
     }
 
-    while (bytes_read < size) {
-        int64_t timeout_remaining_ms = total_timeout.remaining();
-        if (timeout_remaining_ms <= 0) {
+    while (!cursor.finished()) {
+        nanoseconds timeout_remaining = total_timeout.remaining();
+        if (timeout_remaining <= nanoseconds::zero()) {
             // Timed out
             break;
         }
-        // Timeout for the next select is whichever is less of the remaining
+        // Timeout for the next wait is whichever is less of the remaining
         // total read timeout and the inter-byte timeout.
-        uint32_t timeout = std::min(static_cast<uint32_t>(timeout_remaining_ms),
-            timeout_.inter_byte_timeout);
+        nanoseconds timeout = std::min(timeout_remaining, inter_byte_timeout);
         // Wait for the device to be readable, and then attempt to read.
-        if (waitReadable(timeout)) {
+        if (pollReadable(timeout)) {
             // If it's a fixed-length multi-byte read, insert a wait here so that
             // we can attempt to grab the whole thing in a single IO call. Skip
-            // this wait if a non-max inter_byte_timeout is specified.
-            if (size > 1 && timeout_.inter_byte_timeout == Timeout::max()) {
+            // this wait if an inter byte timeout is set.
+            if (size > 1 && inter_byte_timeout >= max_timeout) {
                 size_t bytes_available = available();
-                if (bytes_available + bytes_read < size) {
-                    waitByteTimes(size - (bytes_available + bytes_read));
+                if (bytes_available + cursor.done() < size) {
+                    // Never sleep past the total timeout
+                    nanoseconds byte_times(static_cast<int64_t>(byte_time_ns_)
+                        * static_cast<int64_t>(size - (bytes_available + cursor.done())));
+                    sleep_unless_cancelled(read_cancel_fd_,
+                        std::min(byte_times, total_timeout.remaining()));
                 }
             }
             // This should be non-blocking returning only what is available now
             //  Then returning so that select can block again.
-            ssize_t bytes_read_now = ::read(fd_, buf + bytes_read, size - bytes_read);
+            pending = cursor.pending(pending_count);
+            ssize_t bytes_read_now = read_iov(fd_, pending, pending_count);
+            StatsCounters::add(stats_.read_calls);
             // read should always return some data as select reported it was
             // ready to read when we get to this point.
             if (bytes_read_now < 1) {
@@ -708,80 +1393,627 @@ Serial::SerialImpl::read(uint8_t* buf, size_t size)
                 throw SerialException("device reports readiness to read but "
                                       "returned no data (device disconnected?)");
             }
-            // Update bytes_read
-            bytes_read += static_cast<size_t>(bytes_read_now);
-            // If bytes_read == size then we have read everything we need
-            if (bytes_read == size) {
-                break;
-            }
-            // If bytes_read < size then we have more to read
-            if (bytes_read < size) {
-                continue;
-            }
-            // If bytes_read > size then we have over read, which shouldn't happen
-            if (bytes_read > size) {
-                throw SerialException("read over read, too many bytes where "
-                                      "read, this shouldn't happen, might be "
-                                      "a logical error!");
-            }
+            cursor.advance(static_cast<size_t>(bytes_read_now));
+            timer.gotBytes(cursor.done());
+        }
+        else if (read_cancelled_) {
+            break;
         }
     }
-    return bytes_read;
+    countRead(cursor.done(), size);
+    return cursor.done();
 }
 
-size_t
-Serial::SerialImpl::write(const uint8_t* data, size_t length)
+void Serial::SerialImpl::countRead(size_t bytes_read, size_t size)
 {
-    if (is_open_ == false) {
-        throw PortNotOpenedException("Serial::write");
+    StatsCounters::add(stats_.bytes_read, bytes_read);
+    if (bytes_read < size) {
+        StatsCounters::add(stats_.read_timeouts);
     }
-    fd_set writefds;
-    size_t bytes_written = 0;
-
-    // Calculate total timeout in milliseconds t_c + (t_m * N)
-    long total_timeout_ms = timeout_.write_timeout_constant;
-    total_timeout_ms += timeout_.write_timeout_multiplier * static_cast<long>(length);
-    MillisecondTimer total_timeout(total_timeout_ms);
+}
 
-    bool first_iteration = true;
-    while (bytes_written < length) {
-        int64_t timeout_remaining_ms = total_timeout.remaining();
-        // Only consider the timeout if it's not the first iteration of the loop
-        // otherwise a timeout of 0 won't be allowed through
-        if (!first_iteration && (timeout_remaining_ms <= 0)) {
-            // Timed out
+void Serial::SerialImpl::readKernel(IoCursor& cursor, const Deadline& total_timeout,
+    nanoseconds inter_byte_timeout)
+{
+    // Without VTIME the port stays at VMIN 1 and each read returns what has
+    // arrived. With it, VMIN asks for the rest of the request, no more than
+    // the line can carry before the deadline, and the line discipline ends
+    // the read at the first longer gap.
+    bool timed_gaps = termios_.c_cc[VTIME] != 0;
+    while (!cursor.finished()) {
+        nanoseconds timeout_remaining = total_timeout.remaining();
+        if (timeout_remaining <= nanoseconds::zero()) {
             break;
         }
-        first_iteration = false;
-
-        timespec timeout(timespec_from_ms(timeout_remaining_ms));
-
-        FD_ZERO(&writefds);
-        FD_SET(fd_, &writefds);
+        int pending_count;
+        const iovec* pending = cursor.pending(pending_count);
+        unsigned char vmin = 1;
+        if (timed_gaps) {
+            size_t wanted = 0;
+            for (int i = 0; i < pending_count; ++i) {
+                wanted += pending[i].iov_len;
+            }
+            if (byte_time_ns_ != 0) {
+                uint64_t reachable = static_cast<uint64_t>(timeout_remaining.count()) / byte_time_ns_;
+                wanted = static_cast<size_t>(std::min<uint64_t>(wanted, std::max<uint64_t>(reachable, 1)));
+            }
+            vmin = static_cast<unsigned char>(std::min<size_t>(wanted, 255));
+            setReadMinimum(vmin);
+        }
 
-        // Do the select
-        int r = pselect(fd_ + 1, NULL, &writefds, NULL, &timeout, NULL);
+        // VMIN/VTIME cannot bound the wait for the first byte by the total
+        // timeout, so that wait happens here. Once bytes have arrived, a
+        // silence longer than the inter byte timeout ends the read.
+        nanoseconds timeout = cursor.done() == 0 || !timed_gaps
+            ? timeout_remaining
+            : std::min(timeout_remaining, inter_byte_timeout);
+        if (!pollReadable(timeout)) {
+            break;
+        }
 
-        // Figure out what happened by looking at select's response 'r'
-        /** Error **/
-        if (r < 0) {
-            // Select was interrupted, try again
+        ssize_t bytes_read_now = read_iov(read_fd_, pending, pending_count);
+        StatsCounters::add(stats_.read_calls);
+        if (bytes_read_now < 0) {
             if (errno == EINTR) {
+                StatsCounters::add(stats_.read_eintr_retries);
                 continue;
             }
-            // Otherwise there was some error
             THROW(IOException, errno);
         }
-        /** Timeout **/
-        if (r == 0) {
+        if (bytes_read_now == 0) {
+            throw SerialException("device reports readiness to read but "
+                                  "returned no data (device disconnected?)");
+        }
+        cursor.advance(static_cast<size_t>(bytes_read_now));
+        // A short read means the line discipline's inter byte timer expired
+        if (timed_gaps && static_cast<size_t>(bytes_read_now) < vmin) {
             break;
         }
+    }
+}
+
+size_t
+Serial::SerialImpl::readUring(const iovec* iov, int count, nanoseconds timeout)
+{
+#if defined(__linux__)
+    // One io_uring_enter stands in for the wait and the read: the read on
+    // the blocking descriptor is linked to a timeout that cancels it, and a
+    // poll on the cancel eventfd stays armed in the ring for cancel()
+    read_cancelled_ = false;
+    if (timeout <= nanoseconds::zero()) {
+        return 0;
+    }
+    if (!uring_cancel_armed_) {
+        io_uring_sqe* poll = uring_->getSqe();
+        poll->opcode = IORING_OP_POLL_ADD;
+        poll->fd = read_cancel_fd_;
+        poll->poll32_events = POLLIN;
+        poll->user_data = uring_cancel_poll;
+        uring_cancel_armed_ = true;
+    }
+    io_uring_sqe* read = uring_->getSqe();
+    if (count == 1 && uring_->isRegistered(iov->iov_base, iov->iov_len)) {
+        read->opcode = IORING_OP_READ_FIXED;
+        read->addr = reinterpret_cast<uint64_t>(iov->iov_base);
+        read->len = static_cast<uint32_t>(iov->iov_len);
+        read->buf_index = 0;
+    }
+    else {
+        read->opcode = IORING_OP_READV;
+        read->addr = reinterpret_cast<uint64_t>(iov);
+        read->len = static_cast<uint32_t>(count);
+    }
+    read->fd = read_fd_;
+    read->flags = IOSQE_IO_LINK;
+    read->user_data = uring_read;
+
+    // Copied by the kernel when the entry is submitted
+    __kernel_timespec timeout_ts;
+    timeout_ts.tv_sec = timeout.count() / 1000000000;
+    timeout_ts.tv_nsec = timeout.count() % 1000000000;
+    io_uring_sqe* timer = uring_->getSqe();
+    timer->opcode = IORING_OP_LINK_TIMEOUT;
+    timer->addr = reinterpret_cast<uint64_t>(&timeout_ts);
+    timer->len = 1;
+    timer->user_data = uring_timeout;
+
+    std::chrono::steady_clock::time_point wait_start = std::chrono::steady_clock::now();
+    StatsCounters::add(stats_.read_calls);
+    bool read_done = false;
+    bool timer_done = false;
+    bool abort_pending = false;
+    int32_t read_result = 0;
+    // Both halves of the link complete before the entries can be reused
+    while (!read_done || !timer_done || abort_pending) {
+        uring_->submit(1);
+        uint64_t tag;
+        int32_t result;
+        while (uring_->popCqe(tag, result)) {
+            switch (tag) {
+            case uring_read:
+                read_done = true;
+                read_result = result;
+                break;
+            case uring_timeout:
+                timer_done = true;
+                break;
+            case uring_abort:
+                abort_pending = false;
+                break;
+            case uring_cancel_poll:
+                uring_cancel_armed_ = false;
+                if (take_cancel(read_cancel_fd_)) {
+                    read_cancelled_ = true;
+                    if (!read_done) {
+                        io_uring_sqe* abort = uring_->getSqe();
+                        abort->opcode = IORING_OP_ASYNC_CANCEL;
+                        abort->addr = uring_read;
+                        abort->user_data = uring_abort;
+                        abort_pending = true;
+                    }
+                }
+                else {
+                    // Taken by a waitReadable in between, keep watching
+                    io_uring_sqe* poll = uring_->getSqe();
+                    poll->opcode = IORING_OP_POLL_ADD;
+                    poll->fd = read_cancel_fd_;
+                    poll->poll32_events = POLLIN;
+                    poll->user_data = uring_cancel_poll;
+                    uring_cancel_armed_ = true;
+                }
+                break;
+            }
+        }
+    }
+    uint64_t wait_ns = elapsed_ns(wait_start);
+    StatsCounters::add(stats_.read_wait_calls);
+    StatsCounters::add(stats_.read_wait_time_ns, wait_ns);
+    if (LatencyRecorder* latency = latency_.load(std::memory_order_acquire)) {
+        latency->record(LatencyRecorder::wait, wait_ns);
+    }
+
+    if (read_result > 0) {
+        return static_cast<size_t>(read_result);
+    }
+    if (read_result == 0) {
+        throw SerialException("device reports readiness to read but "
+                              "returned no data (device disconnected?)");
+    }
+    switch (-read_result) {
+    case ECANCELED: // Timed out or cancelled
+    case EINTR: // Timed out while a kernel worker ran the read
+    case EAGAIN:
+        return 0;
+    default:
+        THROW(IOException, -read_result);
+    }
+#else
+    (void)iov;
+    (void)count;
+    (void)timeout;
+    return 0;
+#endif
+}
+
+void Serial::SerialImpl::setReadMinimum(unsigned char vmin)
+{
+    if (vmin == read_vmin_) {
+        return;
+    }
+    termios_.c_cc[VMIN] = vmin;
+    if (tcsetattr(fd_, TCSANOW, &termios_) == -1) {
+        termios_.c_cc[VMIN] = read_vmin_;
+        THROW(IOException, errno);
+    }
+    read_vmin_ = vmin;
+}
+
+size_t
+Serial::SerialImpl::readNonBlocking(uint8_t* buf, size_t size)
+{
+    if (!is_open_) {
+        throw PortNotOpenedException("Serial::readNonBlocking");
+    }
+    size_t bytes_read = readFromBuffer(buf, size);
+    if (bytes_read == size) {
+        return bytes_read;
+    }
+
+    ssize_t bytes_read_now = ::read(fd_, buf + bytes_read, size - bytes_read);
+    StatsCounters::add(stats_.read_calls);
+    if (bytes_read_now > 0) {
+        bytes_read += static_cast<size_t>(bytes_read_now);
+        StatsCounters::add(stats_.bytes_read, bytes_read);
+        return bytes_read;
+    }
+    StatsCounters::add(stats_.bytes_read, bytes_read);
+    // Report a failure only once the buffered bytes have been handed out
+    if (bytes_read == 0) {
+        if (bytes_read_now == 0) {
+            throw SerialException("device reports readiness to read but "
+                                  "returned no data (device disconnected?)");
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            THROW(IOException, errno);
+        }
+    }
+    return bytes_read;
+}
+
+void Serial::SerialImpl::unread(const uint8_t* data, size_t size)
+{
+    if (size == 0) {
+        return;
+    }
+    // They will be counted again when read
+    stats_.bytes_read.fetch_sub(size, std::memory_order_relaxed);
+    if (read_buffer_begin_ >= size) {
+        read_buffer_begin_ -= size;
+        memcpy(&read_buffer_[read_buffer_begin_], data, size);
+        return;
+    }
+    size_t buffered = read_buffer_end_ - read_buffer_begin_;
+    if (read_buffer_.size() < size + buffered) {
+        read_buffer_.resize(size + buffered);
+    }
+    memmove(&read_buffer_[size], &read_buffer_[read_buffer_begin_], buffered);
+    memcpy(&read_buffer_[0], data, size);
+    read_buffer_begin_ = 0;
+    read_buffer_end_ = size + buffered;
+}
+
+size_t
+Serial::SerialImpl::readFromBuffer(uint8_t* buf, size_t size)
+{
+    size_t bytes_read = std::min(size, read_buffer_end_ - read_buffer_begin_);
+    if (bytes_read > 0) {
+        memcpy(buf, &read_buffer_[read_buffer_begin_], bytes_read);
+        read_buffer_begin_ += bytes_read;
+        if (read_buffer_begin_ == read_buffer_end_) {
+            clearReadBuffer();
+        }
+    }
+    return bytes_read;
+}
+
+size_t
+Serial::SerialImpl::fillReadBuffer()
+{
+    // Move the unconsumed tail to the front so the new chunk lands after it
+    if (read_buffer_begin_ > 0) {
+        memmove(&read_buffer_[0], &read_buffer_[read_buffer_begin_],
+            read_buffer_end_ - read_buffer_begin_);
+        read_buffer_end_ -= read_buffer_begin_;
+        read_buffer_begin_ = 0;
+    }
+    if (read_buffer_.size() < read_buffer_end_ + read_chunk_size) {
+        read_buffer_.resize(read_buffer_end_ + read_chunk_size);
+    }
+
+    uint8_t* chunk = &read_buffer_[read_buffer_end_];
+    size_t chunk_size = read_buffer_.size() - read_buffer_end_;
+
+#if defined(__linux__)
+    if (read_mode_ == readmode_uring) {
+        // The receive buffer is registered with the ring so the kernel
+        // does not map its pages for every read, again after it grew
+        if (!uring_->isRegistered(chunk, chunk_size)) {
+            uring_->registerBuffer(&read_buffer_[0], read_buffer_.size());
+        }
+        iovec iov = { chunk, chunk_size };
+        size_t bytes_read = readUring(&iov, 1, readlineTimeout());
+        read_buffer_end_ += bytes_read;
+        return bytes_read;
+    }
+#endif
+
+    ssize_t bytes_read_now = ::read(fd_, chunk, chunk_size);
+    StatsCounters::add(stats_.read_calls);
+    if (bytes_read_now < 1) {
+        // Nothing pending, wait as long as a single byte read would before
+        // giving up: min(t_c + t_m, inter-byte timeout)
+        nanoseconds timeout = readlineTimeout();
+        if (timeout <= nanoseconds::zero() || !pollReadable(timeout)) {
+            return 0;
+        }
+        bytes_read_now = ::read(fd_, chunk, chunk_size);
+        StatsCounters::add(stats_.read_calls);
+        if (bytes_read_now < 1) {
+            throw SerialException("device reports readiness to read but "
+                                  "returned no data (device disconnected?)");
+        }
+    }
+    read_buffer_end_ += static_cast<size_t>(bytes_read_now);
+    return static_cast<size_t>(bytes_read_now);
+}
+
+void Serial::SerialImpl::clearReadBuffer()
+{
+    read_buffer_begin_ = 0;
+    read_buffer_end_ = 0;
+}
+
+size_t
+Serial::SerialImpl::readUntil(string& line, size_t size, const string& eol,
+    bool& eol_found)
+{
+    if (!is_open_) {
+        throw PortNotOpenedException("Serial::readline");
+    }
+    eol_found = false;
+    LatencyTimer timer(latency_.load(std::memory_order_acquire), LatencyRecorder::read);
+
+    // Number of buffered bytes already searched for the delimiter
+    size_t scanned = 0;
+
+    while (true) {
+        const uint8_t* begin = read_buffer_.data() + read_buffer_begin_;
+        size_t buffered = read_buffer_end_ - read_buffer_begin_;
+        timer.gotBytes(buffered);
+        size_t limit = std::min(buffered, size);
+        size_t line_length = limit;
+
+        if (!eol.empty() && limit >= eol.length()) {
+            // Resume where the last search stopped, backing up just enough to
+            // catch a delimiter split across two chunks.
+            size_t from = scanned >= eol.length() ? scanned - eol.length() + 1 : 0;
+            size_t match = from + find_delimiter(begin + from, limit - from,
+                                      reinterpret_cast<const uint8_t*>(eol.data()), eol.length());
+            if (match != limit) {
+                line_length = match + eol.length();
+                eol_found = true;
+            }
+        }
+        scanned = limit;
+
+        // Keep pulling chunks until the delimiter shows up, the size limit is
+        // reached or the port times out.
+        if (!eol_found && limit < size && fillReadBuffer() > 0) {
+            continue;
+        }
+
+        // The refill may have moved the buffer, so index it afresh
+        line.append(reinterpret_cast<const char*>(read_buffer_.data() + read_buffer_begin_), line_length);
+        read_buffer_begin_ += line_length;
+        if (read_buffer_begin_ == read_buffer_end_) {
+            clearReadBuffer();
+        }
+        StatsCounters::add(stats_.bytes_read, line_length);
+        if (!eol_found && line_length < size) {
+            StatsCounters::add(stats_.read_timeouts);
+        }
+        return line_length;
+    }
+}
+
+size_t
+Serial::SerialImpl::readline(string& line, size_t size, const string& eol)
+{
+    bool eol_found;
+    return readUntil(line, size, eol, eol_found);
+}
+
+vector<string>
+Serial::SerialImpl::readlines(size_t size, const string& eol)
+{
+    vector<string> lines;
+    size_t read_so_far = 0;
+    bool eol_found = true;
+
+    // Keep splitting lines off the buffer until the port times out or the
+    // combined size limit is reached.
+    while (eol_found && read_so_far < size) {
+        string line;
+        size_t bytes_read = readUntil(line, size - read_so_far, eol, eol_found);
+        if (bytes_read == 0) {
+            break;
+        }
+        read_so_far += bytes_read;
+        lines.push_back(std::move(line));
+    }
+    return lines;
+}
+
+size_t
+Serial::SerialImpl::write(const uint8_t* data, size_t length)
+{
+    if (is_open_ == false) {
+        throw PortNotOpenedException("Serial::write");
+    }
+    iovec iov = { const_cast<uint8_t*>(data), length };
+    IoCursor cursor(&iov, 1);
+    return writeCursor(cursor);
+}
+
+size_t
+Serial::SerialImpl::writeNonBlocking(const uint8_t* data, size_t length)
+{
+    if (is_open_ == false) {
+        throw PortNotOpenedException("Serial::writeNonBlocking");
+    }
+    lockWriteChunk();
+    ssize_t bytes_written = ::write(fd_, data, length);
+    int error = errno;
+    write_chunk_mutex_.unlock();
+    StatsCounters::add(stats_.write_calls);
+    if (bytes_written < 0) {
+        errno = error;
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return 0;
+        }
+        THROW(IOException, errno);
+    }
+    if (static_cast<size_t>(bytes_written) < length) {
+        StatsCounters::add(stats_.partial_writes);
+    }
+    StatsCounters::add(stats_.bytes_written, static_cast<size_t>(bytes_written));
+    return static_cast<size_t>(bytes_written);
+}
+
+size_t
+Serial::SerialImpl::writePriority(const uint8_t* data, size_t length)
+{
+    if (is_open_ == false) {
+        throw PortNotOpenedException("Serial::writePriority");
+    }
+    iovec iov = { const_cast<uint8_t*>(data), length };
+    IoCursor cursor(&iov, 1);
+
+    priority_writers_.fetch_add(1);
+    std::lock_guard<std::mutex> lock(write_chunk_mutex_);
+    // Counted out before the lock is released, see lockWriteChunk
+    struct PriorityExit {
+        std::atomic<unsigned>& writers;
+        ~PriorityExit() { writers.fetch_sub(1); }
+    } exit = { priority_writers_ };
+    return writeCursor(cursor, true);
+}
+
+void Serial::SerialImpl::lockWriteChunk()
+{
+    // writePriority calls count themselves in before taking the lock and
+    // out before releasing it, so a zero count seen under the lock means
+    // none is waiting. Otherwise step aside until one has taken it.
+    while (true) {
+        write_chunk_mutex_.lock();
+        if (priority_writers_.load() == 0) {
+            return;
+        }
+        write_chunk_mutex_.unlock();
+        std::this_thread::yield();
+    }
+}
+
+size_t
+Serial::SerialImpl::pacedChunk(uint32_t pacing_ms, nanoseconds timeout_remaining)
+{
+    uint64_t byte_time_ns = std::max<uint32_t>(byte_time_ns_, 1);
+    size_t budget = static_cast<size_t>(std::max<uint64_t>(
+        uint64_t(pacing_ms) * 1000000 / byte_time_ns, 1));
+    size_t queued = outputPending();
+    if (queued < budget) {
+        return budget - queued;
+    }
+    // Sleep until the queue should have dropped below the budget
+    nanoseconds drain(static_cast<int64_t>(byte_time_ns * (queued - budget + 1)));
+    nanoseconds wait = std::min(std::max(drain, min_drain_poll), timeout_remaining);
+    if (wait > nanoseconds::zero()) {
+        sleep_unless_cancelled(write_cancel_fd_, wait);
+    }
+    return 0;
+}
+
+size_t
+Serial::SerialImpl::writev(const iovec* iov, size_t count)
+{
+    if (is_open_ == false) {
+        throw PortNotOpenedException("Serial::writev");
+    }
+    IoCursor cursor(iov, count);
+    return writeCursor(cursor);
+}
+
+size_t
+Serial::SerialImpl::writeCursor(IoCursor& cursor, bool priority)
+{
+    const size_t length = cursor.size();
+    LatencyTimer timer(latency_.load(std::memory_order_acquire), LatencyRecorder::write);
+    const uint32_t pacing_ms = priority ? 0 : write_pacing_ms_.load(std::memory_order_relaxed);
+
+    // Calculate total timeout t_c + (t_m * N)
+    Deadline total_timeout(total_timeout_ns(timeout_.write_timeout_constant,
+        timeout_.write_timeout_multiplier, length));
+
+    bool first_iteration = true;
+    while (!cursor.finished()) {
+        nanoseconds timeout_remaining = total_timeout.remaining();
+        // Only consider the timeout if it's not the first iteration of the loop
+        // otherwise a timeout of 0 won't be allowed through
+        if (!first_iteration && (timeout_remaining <= nanoseconds::zero())) {
+            // Timed out
+            break;
+        }
+        first_iteration = false;
+
+        // Keep the driver's queue within the pacing budget
+        size_t chunk_limit = SIZE_MAX;
+        if (pacing_ms != 0) {
+            chunk_limit = pacedChunk(pacing_ms, timeout_remaining);
+            if (chunk_limit == 0) {
+                if (take_cancel(write_cancel_fd_)) {
+                    break;
+                }
+                continue;
+            }
+        }
+
+        // Wait for room in the output buffer or a cancel(), poll has no
+        // descriptor limit and needs no set to be rebuilt on every iteration
+        pollfd events[2] = { { fd_, POLLOUT, 0 }, { write_cancel_fd_, POLLIN, 0 } };
+        const pollfd& writefd = events[0];
+        std::chrono::steady_clock::time_point wait_start = std::chrono::steady_clock::now();
+        int r = poll_ns(events, 2, timeout_remaining);
+        uint64_t wait_ns = elapsed_ns(wait_start);
+        StatsCounters::add(stats_.write_wait_calls);
+        StatsCounters::add(stats_.write_wait_time_ns, wait_ns);
+        if (LatencyRecorder* latency = latency_.load(std::memory_order_acquire)) {
+            latency->record(LatencyRecorder::wait, wait_ns);
+        }
+
+        // Figure out what happened by looking at poll's response 'r'
+        /** Error **/
+        if (r < 0) {
+            // Poll was interrupted, try again
+            if (errno == EINTR) {
+                StatsCounters::add(stats_.write_eintr_retries);
+                continue;
+            }
+            // Otherwise there was some error
+            THROW(IOException, errno);
+        }
+        /** Timeout **/
+        if (r == 0) {
+            break;
+        }
+        /** Cancelled **/
+        if (events[1].revents != 0) {
+            if (take_cancel(write_cancel_fd_)) {
+                break;
+            }
+            // A concurrent writePriority or waitTransmitted took it
+            if (writefd.revents == 0) {
+                continue;
+            }
+        }
         /** Port ready to write **/
         if (r > 0) {
-            // Make sure our file descriptor is in the ready to write list
-            if (FD_ISSET(fd_, &writefds)) {
+            // Make sure poll reported an event on our file descriptor
+            if (writefd.revents != 0) {
                 // This will write some
-                ssize_t bytes_written_now = ::write(fd_, data + bytes_written, length - bytes_written);
+                int pending_count;
+                const iovec* pending = cursor.pending(pending_count);
+                iovec chunk;
+                if (chunk_limit != SIZE_MAX) {
+                    chunk.iov_base = pending->iov_base;
+                    chunk.iov_len = std::min(pending->iov_len, chunk_limit);
+                    pending = &chunk;
+                    pending_count = 1;
+                }
+                size_t requested = 0;
+                for (int i = 0; i < pending_count; ++i) {
+                    requested += pending[i].iov_len;
+                }
+                ssize_t bytes_written_now;
+                if (priority) {
+                    // The caller already holds write_chunk_mutex_
+                    bytes_written_now = write_iov(fd_, pending, pending_count);
+                }
+                else {
+                    lockWriteChunk();
+                    bytes_written_now = write_iov(fd_, pending, pending_count);
+                    write_chunk_mutex_.unlock();
+                }
+                StatsCounters::add(stats_.write_calls);
                 // write should always return some data as select reported it was
                 // ready to write when we get to this point.
                 if (bytes_written_now < 1) {
@@ -791,29 +2023,189 @@ Serial::SerialImpl::write(const uint8_t* data, size_t length)
                     throw SerialException("device reports readiness to write but "
                                           "returned no data (device disconnected?)");
                 }
-                // Update bytes_written
-                bytes_written += static_cast<size_t>(bytes_written_now);
-                // If bytes_written == size then we have written everything we need to
-                if (bytes_written == length) {
-                    break;
-                }
-                // If bytes_written < size then we have more to write
-                if (bytes_written < length) {
-                    continue;
-                }
-                // If bytes_written > size then we have over written, which shouldn't happen
-                if (bytes_written > length) {
-                    throw SerialException("write over wrote, too many bytes where "
-                                          "written, this shouldn't happen, might be "
-                                          "a logical error!");
+                if (static_cast<size_t>(bytes_written_now) < requested) {
+                    StatsCounters::add(stats_.partial_writes);
                 }
+                cursor.advance(static_cast<size_t>(bytes_written_now));
+                continue;
             }
             // This shouldn't happen, if r > 0 our fd has to be in the list!
-            THROW(IOException, "select reports ready to write, but our fd isn't"
-                               " in the list, this shouldn't happen!");
+            THROW(IOException, "poll reports ready to write, but our fd has"
+                               " no events, this shouldn't happen!");
+        }
+    }
+    StatsCounters::add(stats_.bytes_written, cursor.done());
+    if (!cursor.finished()) {
+        StatsCounters::add(stats_.write_timeouts);
+    }
+    return cursor.done();
+}
+
+void Serial::SerialImpl::writeAsync(vector<uint8_t> data, serial::WriteCallback callback)
+{
+    std::unique_ptr<AsyncWrite> node(new AsyncWrite);
+    node->data = std::move(data);
+    node->callback = std::move(callback);
+
+    // Counted before the check, so stopAsyncWriter either waits for this
+    // push or this call sees the port closing
+    async_submitters_.fetch_add(1);
+    if (!async_accepting_.load()) {
+        async_submitters_.fetch_sub(1);
+        throw PortNotOpenedException("Serial::writeAsync");
+    }
+    if (!writer_running_.load(std::memory_order_acquire)) {
+        try {
+            startAsyncWriter();
+        }
+        catch (...) {
+            async_submitters_.fetch_sub(1);
+            throw;
+        }
+    }
+    async_pending_.fetch_add(1);
+    write_queue_.push(node.release());
+    // Only an idle writer needs waking, a busy one finds the node on its next
+    // pass without this thread touching the mutex
+    if (writer_sleeping_.exchange(false)) {
+        std::lock_guard<std::mutex> lock(writer_wake_mutex_);
+        writer_wake_.notify_one();
+    }
+    async_submitters_.fetch_sub(1);
+}
+
+void Serial::SerialImpl::waitAsyncWrites()
+{
+    std::unique_lock<std::mutex> lock(async_idle_mutex_);
+    async_idle_.wait(lock, [this] { return async_pending_.load() == 0; });
+}
+
+void Serial::SerialImpl::startAsyncWriter()
+{
+    std::lock_guard<std::mutex> lock(writer_start_mutex_);
+    if (writer_running_.load()) {
+        return;
+    }
+    writer_stopping_.store(false);
+    writer_sleeping_.store(false);
+    writer_thread_ = std::thread(&SerialImpl::asyncWriterLoop, this);
+    writer_running_.store(true, std::memory_order_release);
+}
+
+void Serial::SerialImpl::stopAsyncWriter()
+{
+    // Once no call is between the accepting check and its push, nothing
+    // more can be queued
+    async_accepting_.store(false);
+    while (async_submitters_.load() != 0) {
+        std::this_thread::yield();
+    }
+
+    std::lock_guard<std::mutex> lock(writer_start_mutex_);
+    if (writer_running_.load()) {
+        {
+            std::lock_guard<std::mutex> wake_lock(writer_wake_mutex_);
+            writer_stopping_.store(true);
+            writer_wake_.notify_one();
+        }
+        writer_thread_.join();
+        writer_running_.store(false);
+    }
+
+    // Anything the writer did not get to is failed here, this thread is
+    // the only consumer now
+    std::exception_ptr error = std::make_exception_ptr(
+        PortNotOpenedException("Serial::writeAsync"));
+    while (!write_queue_.empty()) {
+        AsyncWrite* node = write_queue_.pop();
+        if (node != NULL) {
+            completeAsyncWrites(&node, 1, 0, error);
+        }
+    }
+}
+
+void Serial::SerialImpl::asyncWriterLoop()
+{
+    AsyncWrite* batch[async_batch_max];
+    while (!writer_stopping_.load()) {
+        // Take whatever is queued, up to the batch limits
+        size_t count = 0;
+        size_t length = 0;
+        while (count < async_batch_max && length < async_batch_bytes) {
+            AsyncWrite* node = write_queue_.pop();
+            if (node == NULL) {
+                break;
+            }
+            batch[count++] = node;
+            length += node->data.size();
+        }
+        if (count > 0) {
+            writeBatch(batch, count);
+            continue;
+        }
+
+        // Nothing ready, announce that we are going to sleep and look once
+        // more so a push racing with the announcement is not missed
+        std::unique_lock<std::mutex> lock(writer_wake_mutex_);
+        writer_sleeping_.store(true);
+        if (!write_queue_.empty()) {
+            writer_sleeping_.store(false);
+            continue;
+        }
+        writer_wake_.wait(lock, [this] {
+            return !writer_sleeping_.load() || writer_stopping_.load();
+        });
+        writer_sleeping_.store(false);
+    }
+}
+
+void Serial::SerialImpl::writeBatch(AsyncWrite** batch, size_t count)
+{
+    iovec iov[async_batch_max];
+    for (size_t i = 0; i < count; ++i) {
+        iov[i].iov_base = batch[i]->data.data();
+        iov[i].iov_len = batch[i]->data.size();
+    }
+    // The write timeout covers the whole batch, as if it were one write()
+    IoCursor cursor(iov, count);
+    std::exception_ptr error;
+    writeLock();
+    try {
+        writeCursor(cursor);
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+    writeUnlock();
+
+    completeAsyncWrites(batch, count, cursor.done(), error);
+}
+
+void Serial::SerialImpl::completeAsyncWrites(AsyncWrite** batch, size_t count,
+    size_t bytes_written, std::exception_ptr error)
+{
+    for (size_t i = 0; i < count; ++i) {
+        AsyncWrite* node = batch[i];
+        size_t size = node->data.size();
+        size_t written = std::min(size, bytes_written);
+        bytes_written -= written;
+        if (node->callback) {
+            // A short write without an error is a timeout, the same result
+            // write() would have returned
+            try {
+                node->callback(written, written == size ? std::exception_ptr() : error);
+            }
+            catch (...) {
+                // Callbacks run on the writer thread, there is no one to
+                // rethrow to
+            }
+        }
+        delete node;
+        if (async_pending_.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(async_idle_mutex_);
+            async_idle_.notify_all();
         }
     }
-    return bytes_written;
 }
 
 void Serial::SerialImpl::setPort(const string& port)
@@ -828,12 +2220,26 @@ Serial::SerialImpl::getPort() const
 }
 
 void Serial::SerialImpl::setTimeout(const serial::Timeout& timeout)
+{
+    setTimeout(MicrosecondTimeout::fromTimeout(timeout));
+}
+
+void Serial::SerialImpl::setTimeout(const serial::MicrosecondTimeout& timeout)
 {
     timeout_ = timeout;
+    // VTIME carries the inter byte timeout in kernel read mode
+    if (is_open_ && read_mode_ == readmode_kernel)
+        reconfigurePort();
 }
 
 serial::Timeout
 Serial::SerialImpl::getTimeout() const
+{
+    return timeout_.toTimeout();
+}
+
+serial::MicrosecondTimeout
+Serial::SerialImpl::getMicrosecondTimeout() const
 {
     return timeout_;
 }
@@ -903,6 +2309,244 @@ Serial::SerialImpl::getFlowcontrol() const
     return flowcontrol_;
 }
 
+void Serial::SerialImpl::configure(const serial::PortConfig& config)
+{
+    PortConfig previous = getConfig();
+    if (config == previous) {
+        return;
+    }
+    baudrate_ = config.baudrate;
+    bytesize_ = config.bytesize;
+    parity_ = config.parity;
+    stopbits_ = config.stopbits;
+    flowcontrol_ = config.flowcontrol;
+    if (!is_open_) {
+        return;
+    }
+    try {
+        reconfigurePort();
+    }
+    catch (...) {
+        baudrate_ = previous.baudrate;
+        bytesize_ = previous.bytesize;
+        parity_ = previous.parity;
+        stopbits_ = previous.stopbits;
+        flowcontrol_ = previous.flowcontrol;
+        // Part of the new settings may have reached the port already
+        try {
+            reconfigurePort();
+        }
+        catch (...) {
+            // The first failure is the one reported
+        }
+        throw;
+    }
+}
+
+serial::PortConfig
+Serial::SerialImpl::getConfig() const
+{
+    return PortConfig(static_cast<uint32_t>(baudrate_), bytesize_, parity_,
+        stopbits_, flowcontrol_);
+}
+
+void Serial::SerialImpl::setReadMode(serial::readmode_t readmode)
+{
+    // Without io_uring reads keep polling, getReadMode() tells which
+    if (readmode == readmode_uring && !uring_supported()) {
+        readmode = readmode_poll;
+    }
+    if (readmode == read_mode_) {
+        return;
+    }
+    if (is_open_) {
+        if (readmode != readmode_poll && read_fd_ == -1) {
+            openReadDescriptor();
+        }
+        if (readmode == readmode_uring && !openUring()) {
+            readmode = readmode_poll;
+        }
+        if (readmode != readmode_uring) {
+            uring_.reset();
+        }
+        if (readmode == readmode_poll && read_fd_ != -1) {
+            ::close(read_fd_);
+            read_fd_ = -1;
+        }
+        if (readmode == read_mode_) {
+            return;
+        }
+    }
+    read_mode_ = readmode;
+    if (is_open_)
+        reconfigurePort();
+}
+
+serial::readmode_t
+Serial::SerialImpl::getReadMode() const
+{
+    return read_mode_;
+}
+
+void Serial::SerialImpl::setLowLatency(bool low_latency)
+{
+    if (is_open_) {
+        applyLowLatency(low_latency);
+    }
+    low_latency_ = low_latency;
+}
+
+nanoseconds
+Serial::SerialImpl::readTimeout(size_t size) const
+{
+    return total_timeout_ns(timeout_.read_timeout_constant,
+        timeout_.read_timeout_multiplier, size);
+}
+
+nanoseconds
+Serial::SerialImpl::readlineTimeout() const
+{
+    // What fillReadBuffer waits for each chunk
+    return std::min(
+        total_timeout_ns(timeout_.read_timeout_constant, timeout_.read_timeout_multiplier, 1),
+        inter_byte_timeout_ns(timeout_.inter_byte_timeout));
+}
+
+nanoseconds
+Serial::SerialImpl::writeTimeout(size_t size) const
+{
+    return total_timeout_ns(timeout_.write_timeout_constant,
+        timeout_.write_timeout_multiplier, size);
+}
+
+void Serial::SerialImpl::setExecutor(serial::IoExecutor* executor)
+{
+    executor_ = executor;
+}
+
+serial::IoExecutor*
+Serial::SerialImpl::getExecutor() const
+{
+    return executor_;
+}
+
+void Serial::SerialImpl::setReactor(serial::Reactor* reactor)
+{
+    reactor_ = reactor;
+}
+
+serial::Reactor*
+Serial::SerialImpl::getReactor() const
+{
+    return reactor_;
+}
+
+void Serial::SerialImpl::setWritePacing(uint32_t max_queued_ms)
+{
+    write_pacing_ms_.store(max_queued_ms, std::memory_order_relaxed);
+}
+
+uint32_t Serial::SerialImpl::getWritePacing() const
+{
+    return write_pacing_ms_.load(std::memory_order_relaxed);
+}
+
+bool Serial::SerialImpl::getLowLatency() const
+{
+    return low_latency_;
+}
+
+serial::PortStats
+Serial::SerialImpl::stats() const
+{
+    return stats_.snapshot();
+}
+
+void Serial::SerialImpl::resetStats()
+{
+    stats_.reset();
+    if (latency_owner_) {
+        latency_owner_->reset();
+    }
+}
+
+void Serial::SerialImpl::setLatencyTracking(bool latency_tracking)
+{
+    // The recorder outlives tracking being turned off so a read that loaded
+    // the pointer just before can still finish recording into it
+    if (latency_tracking && !latency_owner_) {
+        latency_owner_.reset(new LatencyRecorder());
+    }
+    latency_.store(latency_tracking ? latency_owner_.get() : NULL,
+        std::memory_order_release);
+}
+
+bool Serial::SerialImpl::getLatencyTracking() const
+{
+    return latency_.load(std::memory_order_acquire) != NULL;
+}
+
+serial::LatencyStats
+Serial::SerialImpl::latencyStats() const
+{
+    if (!latency_owner_) {
+        return LatencyStats();
+    }
+    return latency_owner_->snapshot();
+}
+
+void Serial::SerialImpl::applyLowLatency(bool low_latency)
+{
+#if defined(__linux__) && defined(TIOCSSERIAL)
+    struct serial_struct ser;
+    if (-1 != ioctl(fd_, TIOCGSERIAL, &ser)) {
+        int flags = low_latency ? (ser.flags | ASYNC_LOW_LATENCY)
+                                : (ser.flags & ~ASYNC_LOW_LATENCY);
+        if (flags != ser.flags) {
+            ser.flags = flags;
+            if (-1 == ioctl(fd_, TIOCSSERIAL, &ser)) {
+                THROW(IOException, errno);
+            }
+        }
+    }
+    else if (errno != ENOTTY && errno != EINVAL) {
+        // ptys and some USB drivers have no serial_struct at all
+        THROW(IOException, errno);
+    }
+
+    string timer_path = latency_timer_path(port_);
+    if (timer_path.empty()) {
+        return;
+    }
+    if (low_latency) {
+        int current = read_sysfs_int(timer_path);
+        if (current == -1) {
+            THROW(IOException, errno);
+        }
+        if (saved_latency_timer_ == -1 && current != 1) {
+            saved_latency_timer_ = current;
+        }
+        if (current != 1 && !write_sysfs_int(timer_path, 1)) {
+            stringstream ss;
+            ss << "setLowLatency failed writing " << timer_path << ": "
+               << errno << " " << strerror(errno);
+            THROW(IOException, ss.str().c_str());
+        }
+    }
+    else if (saved_latency_timer_ != -1) {
+        if (!write_sysfs_int(timer_path, saved_latency_timer_)) {
+            stringstream ss;
+            ss << "setLowLatency failed writing " << timer_path << ": "
+               << errno << " " << strerror(errno);
+            THROW(IOException, ss.str().c_str());
+        }
+        saved_latency_timer_ = -1;
+    }
+#else
+    (void)low_latency;
+#endif
+}
+
 void Serial::SerialImpl::flush()
 {
     if (is_open_ == false) {
@@ -911,11 +2555,53 @@ void Serial::SerialImpl::flush()
     tcdrain(fd_);
 }
 
+size_t
+Serial::SerialImpl::outputPending()
+{
+    if (is_open_ == false) {
+        throw PortNotOpenedException("Serial::outputPending");
+    }
+    int count = 0;
+    if (-1 == ioctl(fd_, TIOCOUTQ, &count)) {
+        THROW(IOException, errno);
+    }
+    return static_cast<size_t>(count);
+}
+
+bool Serial::SerialImpl::waitTransmitted(uint32_t timeout)
+{
+    if (is_open_ == false) {
+        throw PortNotOpenedException("Serial::waitTransmitted");
+    }
+    const nanoseconds wait_limit = std::chrono::milliseconds(timeout);
+    Deadline deadline(wait_limit);
+    // tcdrain() cannot be bounded, so only hand over to it once the kernel
+    // queue is empty and just the UART's own FIFO is left to go
+    while (size_t pending = outputPending()) {
+        nanoseconds remaining = deadline.remaining();
+        if (remaining <= nanoseconds::zero()) {
+            return false;
+        }
+        nanoseconds estimate(static_cast<int64_t>(byte_time_ns_) * static_cast<int64_t>(pending));
+        if (sleep_unless_cancelled(write_cancel_fd_, std::min(std::max(estimate, min_drain_poll), remaining))
+            && take_cancel(write_cancel_fd_)) {
+            return false;
+        }
+    }
+    while (-1 == tcdrain(fd_)) {
+        if (errno != EINTR) {
+            THROW(IOException, errno);
+        }
+    }
+    return true;
+}
+
 void Serial::SerialImpl::flushInput()
 {
     if (is_open_ == false) {
         throw PortNotOpenedException("Serial::flushInput");
     }
+    clearReadBuffer();
     tcflush(fd_, TCIFLUSH);
 }
 
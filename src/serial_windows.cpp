@@ -1,5 +1,7 @@
 #include "serial/serial.h"
+#include "serial/impl/stats.h"
 
+#include <chrono>
 #include <cstring>
 #include <devguid.h>
 #include <initguid.h>
@@ -41,6 +43,8 @@ Serial::Serial(const std::string& port,
     , bytesize_(bytesize)
     , stopbits_(stopbits)
     , flowcontrol_(flowcontrol)
+    , stats_(new StatsCounters())
+    , latency_(NULL)
 {
     if (port_.empty() == false) {
         open();
@@ -139,6 +143,14 @@ void Serial::close()
     }
 }
 
+void Serial::cancel()
+{
+    if (is_open_) {
+        // Fails with ERROR_NOT_FOUND when nothing is pending, which is fine
+        CancelIoEx(fd_, NULL);
+    }
+}
+
 size_t Serial::available()
 {
     if (!is_open_) {
@@ -167,6 +179,17 @@ void Serial::setTimeout(const serial::Timeout& timeout)
 
 serial::Timeout Serial::getTimeout() const { return timeout_; }
 
+void Serial::setTimeout(const serial::MicrosecondTimeout& timeout)
+{
+    // COMMTIMEOUTS only has millisecond resolution
+    setTimeout(timeout.toTimeout());
+}
+
+serial::MicrosecondTimeout Serial::getMicrosecondTimeout() const
+{
+    return serial::MicrosecondTimeout::fromTimeout(timeout_);
+}
+
 bool Serial::waitReadable(uint32_t /*timeout*/)
 {
     THROW(IOException, "waitReadable is not implemented on Windows.");
@@ -236,6 +259,102 @@ void Serial::setFlowcontrol(flowcontrol_t flowcontrol)
 
 flowcontrol_t Serial::getFlowcontrol() const { return flowcontrol_; }
 
+void Serial::configure(const PortConfig& config)
+{
+    PortConfig previous = getConfig();
+    if (config == previous) {
+        return;
+    }
+    baudrate_ = config.baudrate;
+    bytesize_ = config.bytesize;
+    parity_ = config.parity;
+    stopbits_ = config.stopbits;
+    flowcontrol_ = config.flowcontrol;
+    if (!is_open_) {
+        return;
+    }
+    try {
+        reconfigurePort();
+    }
+    catch (...) {
+        baudrate_ = previous.baudrate;
+        bytesize_ = previous.bytesize;
+        parity_ = previous.parity;
+        stopbits_ = previous.stopbits;
+        flowcontrol_ = previous.flowcontrol;
+        throw;
+    }
+}
+
+PortConfig Serial::getConfig() const
+{
+    return PortConfig(uint32_t(baudrate_), bytesize_, parity_, stopbits_,
+        flowcontrol_);
+}
+
+void Serial::setReadMode(readmode_t readmode)
+{
+    // ReadFile is already timed by the driver through COMMTIMEOUTS, and
+    // readmode_uring falls back to readmode_poll
+    if (readmode == readmode_kernel) {
+        throw std::invalid_argument("OS does not support kernel read mode");
+    }
+}
+
+readmode_t Serial::getReadMode() const { return readmode_poll; }
+
+void Serial::setLowLatency(bool low_latency)
+{
+    // The FTDI latency timer lives in the driver's registry settings
+    if (low_latency) {
+        throw std::invalid_argument("OS does not support low latency mode");
+    }
+}
+
+bool Serial::getLowLatency() const { return false; }
+
+void Serial::setWritePacing(uint32_t max_queued_ms)
+{
+    // WriteFile hands the whole buffer to the driver in one call
+    if (max_queued_ms != 0) {
+        throw std::invalid_argument("OS does not support write pacing");
+    }
+}
+
+uint32_t Serial::getWritePacing() const { return 0; }
+
+PortStats Serial::stats() const { return stats_->snapshot(); }
+
+void Serial::resetStats()
+{
+    stats_->reset();
+    if (latency_owner_) {
+        latency_owner_->reset();
+    }
+}
+
+void Serial::setLatencyTracking(bool latency_tracking)
+{
+    if (latency_tracking && !latency_owner_) {
+        latency_owner_.reset(new LatencyRecorder());
+    }
+    latency_.store(latency_tracking ? latency_owner_.get() : NULL,
+        std::memory_order_release);
+}
+
+bool Serial::getLatencyTracking() const
+{
+    return latency_.load(std::memory_order_acquire) != NULL;
+}
+
+LatencyStats Serial::latencyStats() const
+{
+    if (!latency_owner_) {
+        return LatencyStats();
+    }
+    return latency_owner_->snapshot();
+}
+
 bool Serial::waitForChange()
 {
     if (!is_open_) {
@@ -371,6 +490,47 @@ void Serial::flush()
     FlushFileBuffers(fd_);
 }
 
+size_t Serial::outputPending()
+{
+    if (!is_open_) {
+        return 0;
+    }
+
+    COMSTAT cs;
+
+    if (!ClearCommError(fd_, NULL, &cs)) {
+        std::stringstream ss;
+        ss << "Error while checking status of the serial port: " << GetLastError();
+        THROW(IOException, ss.str().c_str());
+    }
+
+    return static_cast<size_t>(cs.cbOutQue);
+}
+
+bool Serial::waitTransmitted(uint32_t timeout)
+{
+    if (!is_open_) {
+        throw PortNotOpenedException("Serial::waitTransmitted");
+    }
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now()
+        + std::chrono::milliseconds(timeout);
+    uint64_t byte_time_ns = getConfig().byteTimeNs();
+    while (size_t pending = outputPending()) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            return false;
+        }
+        // Sleep roughly until the queue should be empty, at least 1 ms.
+        // Parenthesised so the windows.h min/max macros stay out of the way.
+        uint64_t wait_ms = (std::max)(uint64_t(1), byte_time_ns * pending / 1000000);
+        uint64_t remaining_ms = static_cast<uint64_t>(
+                                    std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count())
+            + 1;
+        Sleep(static_cast<DWORD>((std::min)(wait_ms, remaining_ms)));
+    }
+    return true;
+}
+
 void Serial::flushInput()
 {
     std::unique_lock read_lock(m_read_mutex);
@@ -401,17 +561,123 @@ size_t Serial::read(uint8_t* buffer, size_t size)
         throw PortNotOpenedException("Serial::read");
     }
 
+    LatencyRecorder* latency = latency_.load(std::memory_order_acquire);
+    std::chrono::steady_clock::time_point start;
+    if (latency != NULL) {
+        start = std::chrono::steady_clock::now();
+    }
+
     DWORD bytes_read;
 
-    if (!ReadFile(fd_, buffer, static_cast<DWORD>(size), &bytes_read, NULL)) {
+    BOOL read_ok = ReadFile(fd_, buffer, static_cast<DWORD>(size), &bytes_read, NULL);
+    StatsCounters::add(stats_->read_calls);
+    // Cancelled reads return what arrived so far, like a timeout
+    if (!read_ok && GetLastError() != ERROR_OPERATION_ABORTED) {
         std::stringstream ss;
         ss << "Error while reading from the serial port: " << GetLastError();
         THROW(IOException, ss.str().c_str());
     }
 
+    StatsCounters::add(stats_->bytes_read, bytes_read);
+    if (bytes_read < size) {
+        StatsCounters::add(stats_->read_timeouts);
+    }
+    if (latency != NULL) {
+        // ReadFile hands everything over at once, so the first byte and
+        // completion are the same moment here
+        uint64_t elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start)
+                                                     .count());
+        if (bytes_read > 0) {
+            latency->record(LatencyRecorder::read_first_byte, elapsed);
+        }
+        latency->record(LatencyRecorder::read, elapsed);
+    }
     return (size_t)(bytes_read);
 }
 
+size_t Serial::readv(const iovec* iov, size_t count)
+{
+    // No scatter read for comm handles, fill the buffers one at a time and
+    // stop at the first one a timeout left short
+    size_t bytes_read = 0;
+    for (size_t i = 0; i < count; ++i) {
+        size_t bytes_read_now = read(static_cast<uint8_t*>(iov[i].iov_base), iov[i].iov_len);
+        bytes_read += bytes_read_now;
+        if (bytes_read_now < iov[i].iov_len) {
+            break;
+        }
+    }
+    return bytes_read;
+}
+
+size_t Serial::readline(std::string& line, size_t size, std::string eol)
+{
+    std::unique_ptr<uint8_t[]> tmp = std::make_unique<uint8_t[]>(size * sizeof(uint8_t));
+
+    size_t read_so_far = 0;
+
+    while (read_so_far < size) {
+        size_t bytes_read = read(tmp.get() + read_so_far, 1);
+
+        if (bytes_read == 0) {
+            break; // Timeout occured on reading 1 byte
+        }
+
+        read_so_far += bytes_read;
+
+        if (read_so_far >= eol.length()
+            && std::memcmp(tmp.get() + read_so_far - eol.length(), eol.data(), eol.length()) == 0) {
+            break; // EOL found
+        }
+    }
+
+    line.append(reinterpret_cast<const char*>(tmp.get()), read_so_far);
+
+    return read_so_far;
+}
+
+std::vector<std::string> Serial::readlines(size_t size, std::string eol)
+{
+    std::vector<std::string> lines;
+
+    std::unique_ptr<uint8_t[]> tmp = std::make_unique<uint8_t[]>(size * sizeof(uint8_t));
+
+    size_t read_so_far = 0;
+    size_t start_of_line = 0;
+
+    while (read_so_far < size) {
+        size_t bytes_read = read(tmp.get() + read_so_far, 1);
+
+        read_so_far += bytes_read;
+
+        if (bytes_read == 0) {
+            if (start_of_line != read_so_far) {
+                lines.push_back(std::string(reinterpret_cast<const char*>(tmp.get() + start_of_line), read_so_far - start_of_line));
+            }
+
+            break; // Timeout occured on reading 1 byte
+        }
+
+        if (read_so_far - start_of_line >= eol.length()
+            && std::memcmp(tmp.get() + read_so_far - eol.length(), eol.data(), eol.length()) == 0) {
+            // EOL found
+            lines.push_back(std::string(reinterpret_cast<const char*>(tmp.get() + start_of_line), read_so_far - start_of_line));
+            start_of_line = read_so_far;
+        }
+
+        if (read_so_far == size) {
+            if (start_of_line != read_so_far) {
+                lines.push_back(std::string(reinterpret_cast<const char*>(tmp.get() + start_of_line), read_so_far - start_of_line));
+            }
+
+            break; // Reached the maximum read length
+        }
+    }
+
+    return lines;
+}
+
 size_t Serial::write(const uint8_t* data, size_t size)
 {
     std::unique_lock write_lock(m_write_mutex);
@@ -420,17 +686,81 @@ size_t Serial::write(const uint8_t* data, size_t size)
         throw PortNotOpenedException("Serial::write");
     }
 
+    LatencyRecorder* latency = latency_.load(std::memory_order_acquire);
+    std::chrono::steady_clock::time_point start;
+    if (latency != NULL) {
+        start = std::chrono::steady_clock::now();
+    }
+
     DWORD bytes_written;
 
-    if (!WriteFile(fd_, data, static_cast<DWORD>(size), &bytes_written, NULL)) {
+    BOOL write_ok = WriteFile(fd_, data, static_cast<DWORD>(size), &bytes_written, NULL);
+    StatsCounters::add(stats_->write_calls);
+    if (!write_ok && GetLastError() != ERROR_OPERATION_ABORTED) {
         std::stringstream ss;
         ss << "Error while writing to the serial port: " << GetLastError();
         THROW(IOException, ss.str().c_str());
     }
 
+    StatsCounters::add(stats_->bytes_written, bytes_written);
+    if (bytes_written < size) {
+        StatsCounters::add(stats_->partial_writes);
+        StatsCounters::add(stats_->write_timeouts);
+    }
+    if (latency != NULL) {
+        latency->record(LatencyRecorder::write,
+            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                                      .count()));
+    }
     return (size_t)(bytes_written);
 }
 
+size_t Serial::writePriority(const uint8_t* data, size_t size)
+{
+    return write(data, size);
+}
+
+size_t Serial::writev(const iovec* iov, size_t count)
+{
+    size_t bytes_written = 0;
+    for (size_t i = 0; i < count; ++i) {
+        size_t bytes_written_now = write(static_cast<const uint8_t*>(iov[i].iov_base), iov[i].iov_len);
+        bytes_written += bytes_written_now;
+        if (bytes_written_now < iov[i].iov_len) {
+            break;
+        }
+    }
+    return bytes_written;
+}
+
+void Serial::writeAsync(std::vector<uint8_t> data, WriteCallback callback)
+{
+    if (is_open_ == false) {
+        throw PortNotOpenedException("Serial::writeAsync");
+    }
+    // No writer thread here, write now and report the outcome the same way
+    size_t bytes_written = 0;
+    std::exception_ptr error;
+    try {
+        bytes_written = write(data.data(), data.size());
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+    if (callback) {
+        try {
+            callback(bytes_written, error);
+        }
+        catch (...) {
+        }
+    }
+}
+
+void Serial::waitAsyncWrites()
+{
+}
+
 void Serial::reconfigurePort()
 {
     if (fd_ == INVALID_HANDLE_VALUE) {
@@ -0,0 +1,216 @@
+/* Background writes through Serial::writeAsync */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include "serial/serial.h"
+#include "test_util.h"
+
+using serial::Serial;
+using serial::Timeout;
+using serial_test::PtyPair;
+
+// Runs function on a thread of its own, so a call that deadlocks can be
+// reported instead of hanging the suite
+static std::future<void>
+run_detached(std::function<void()> function)
+{
+    std::shared_ptr<std::promise<void> > done = std::make_shared<std::promise<void> >();
+    std::thread([function, done] {
+        try {
+            function();
+            done->set_value();
+        }
+        catch (...) {
+            done->set_exception(std::current_exception());
+        }
+    }).detach();
+    return done->get_future();
+}
+
+// A blocked thread cannot be unwound, so a deadlock ends the binary
+static void
+expect_finished(std::future<void>& result, const char* what)
+{
+    if (result.wait_for(std::chrono::seconds(5)) != std::future_status::ready) {
+        fprintf(stderr, "  %s still blocked after 5 s, deadlocked\n", what);
+        _exit(EXIT_FAILURE);
+    }
+    result.get();
+}
+
+TEST(future_reports_bytes_written)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(100));
+    std::future<size_t> first = port.writeAsync(std::string("hello "));
+    std::future<size_t> second = port.writeAsync(std::string("world"));
+    CHECK_EQ(6u, first.get());
+    CHECK_EQ(5u, second.get());
+    CHECK_EQ(std::string("hello world"), pty.receive(11));
+}
+
+TEST(callbacks_complete_in_queue_order)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(100));
+    std::vector<int> order;
+    std::string expected;
+    for (int i = 0; i < 100; ++i) {
+        std::string chunk = std::to_string(i) + ",";
+        expected += chunk;
+        port.writeAsync(std::vector<uint8_t>(chunk.begin(), chunk.end()),
+            [&order, i](size_t, std::exception_ptr) { order.push_back(i); });
+    }
+    port.waitAsyncWrites();
+    CHECK_EQ(100u, order.size());
+    CHECK(std::is_sorted(order.begin(), order.end()));
+    CHECK_EQ(expected, pty.receive(expected.size()));
+}
+
+TEST(small_writes_are_coalesced)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 4000000, Timeout::simpleTimeout(2000));
+    // The large write fills the pty and keeps the writer busy while the
+    // small ones queue up behind it; its callback runs before the next batch
+    std::vector<uint8_t> large(256 * 1024, 'x');
+    port.writeAsync(large, [&port](size_t, std::exception_ptr) { port.resetStats(); });
+    std::vector<std::future<size_t> > results;
+    for (int i = 0; i < 50; ++i) {
+        results.push_back(port.writeAsync(std::string("ab")));
+    }
+    CHECK_EQ(large.size() + 100, pty.receive(large.size() + 100).size());
+    for (size_t i = 0; i < results.size(); ++i) {
+        CHECK_EQ(2u, results[i].get());
+    }
+    serial::PortStats stats = port.stats();
+    CHECK_EQ(100u, stats.bytes_written);
+    CHECK(stats.write_calls <= 2);
+}
+
+TEST(producers_do_not_interleave_buffers)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(100));
+    const int producers = 4;
+    const int per_producer = 200;
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.push_back(std::thread([&port, p] {
+            for (int i = 0; i < per_producer; ++i) {
+                port.writeAsync(std::vector<uint8_t>(8, static_cast<uint8_t>('a' + p)),
+                    serial::WriteCallback());
+            }
+        }));
+    }
+    std::string received = pty.receive(producers * per_producer * 8);
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    port.waitAsyncWrites();
+    CHECK_EQ(static_cast<size_t>(producers * per_producer * 8), received.size());
+    for (size_t i = 0; i + 8 <= received.size(); i += 8) {
+        CHECK_EQ(std::string(8, received[i]), received.substr(i, 8));
+    }
+}
+
+TEST(close_fails_queued_writes)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(200));
+    // Nobody reads the device side, the large write times out and the rest
+    // are still queued when close() stops the writer
+    std::future<size_t> large = port.writeAsync(std::vector<uint8_t>(256 * 1024, 'x'));
+    std::vector<std::future<size_t> > results;
+    for (int i = 0; i < 10; ++i) {
+        results.push_back(port.writeAsync(std::string("data")));
+    }
+    while (port.stats().write_calls == 0) {
+        std::this_thread::yield();
+    }
+    port.close();
+    size_t written = large.get();
+    CHECK(written > 0 && written < 256 * 1024);
+    for (size_t i = 0; i < results.size(); ++i) {
+        CHECK_THROWS(serial::PortNotOpenedException, results[i].get());
+    }
+    CHECK_THROWS(serial::PortNotOpenedException, port.writeAsync(std::string("late")));
+}
+
+TEST(set_port_does_not_deadlock_with_the_writer)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(200));
+    // Nobody reads the device side, so this write fills the pty and holds
+    // the write lock until it times out
+    std::thread bulk([&port] { port.write(std::vector<uint8_t>(256 * 1024, 'x')); });
+    while (port.stats().write_calls == 0) {
+        std::this_thread::yield();
+    }
+    std::future<void> reopened = run_detached([&port, &pty] { port.setPort(pty.name()); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    // Queued while setPort waits for the lock: it is either written before
+    // the port is reopened or refused
+    std::future<size_t> queued;
+    try {
+        queued = port.writeAsync(std::string("data"));
+    }
+    catch (const serial::PortNotOpenedException&) {
+    }
+    expect_finished(reopened, "setPort");
+    bulk.join();
+    if (queued.valid()) {
+        try {
+            queued.get();
+        }
+        catch (const serial::PortNotOpenedException&) {
+        }
+    }
+    CHECK(port.isOpen());
+    pty.receive(1024 * 1024, 100);
+    CHECK_EQ(4u, port.writeAsync(std::string("more")).get());
+    CHECK_EQ(std::string("more"), pty.receive(4));
+}
+
+TEST(write_async_racing_close_is_completed)
+{
+    for (int round = 0; round < 20; ++round) {
+        PtyPair pty;
+        Serial port(pty.name(), 4000000, Timeout::simpleTimeout(50));
+        std::atomic<int> accepted(0);
+        std::atomic<int> completed(0);
+        std::vector<std::thread> producers;
+        for (int p = 0; p < 2; ++p) {
+            producers.push_back(std::thread([&port, &accepted, &completed] {
+                while (true) {
+                    try {
+                        port.writeAsync(std::vector<uint8_t>(16, 'x'),
+                            [&completed](size_t, std::exception_ptr) { ++completed; });
+                    }
+                    catch (const serial::PortNotOpenedException&) {
+                        return;
+                    }
+                    ++accepted;
+                }
+            }));
+        }
+        while (accepted.load() < 10) {
+            std::this_thread::yield();
+        }
+        port.close();
+        for (size_t i = 0; i < producers.size(); ++i) {
+            producers[i].join();
+        }
+        // Every buffer writeAsync took completes, none is left queued
+        std::future<void> idle = run_detached([&port] { port.waitAsyncWrites(); });
+        expect_finished(idle, "waitAsyncWrites");
+        CHECK_EQ(accepted.load(), completed.load());
+    }
+}
+
+SERIAL_TEST_MAIN()
@@ -0,0 +1,310 @@
+/* Asynchronous I/O through IoExecutor and the coroutine awaitables */
+
+#include <chrono>
+#include <thread>
+
+#include "serial/coroutine.h"
+#include "serial/executor.h"
+#include "serial/serial.h"
+#include "test_util.h"
+
+using serial::IoExecutor;
+using serial::Serial;
+using serial::Timeout;
+using serial_test::PtyPair;
+
+typedef std::chrono::steady_clock Clock;
+
+// Drives the executor until done is set, for at most two seconds
+static void
+run_until(IoExecutor& executor, const bool& done)
+{
+    Clock::time_point give_up = Clock::now() + std::chrono::seconds(2);
+    while (!done && Clock::now() < give_up) {
+        executor.runOnce(50);
+    }
+}
+
+TEST(read_completes_when_bytes_arrive)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(1000));
+    IoExecutor executor;
+    executor.add(port);
+    uint8_t buffer[8];
+    size_t result = 0;
+    bool done = false;
+    executor.asyncRead(port, buffer, sizeof(buffer), [&](size_t bytes_read, std::exception_ptr error) {
+        CHECK(!error);
+        result = bytes_read;
+        done = true;
+    });
+    executor.runOnce(0);
+    CHECK(!done);
+    pty.send("abcd");
+    executor.runOnce(100);
+    CHECK(!done);
+    pty.send("efgh");
+    run_until(executor, done);
+    CHECK_EQ(8u, result);
+    CHECK_EQ(std::string("abcdefgh"), std::string(buffer, buffer + 8));
+    CHECK_EQ(0u, executor.pending());
+}
+
+TEST(read_until_leaves_rest_buffered)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(1000));
+    IoExecutor executor;
+    executor.add(port);
+    std::vector<std::string> lines;
+    bool done = false;
+    IoExecutor::LineHandler collect = [&](std::string line, std::exception_ptr error) {
+        CHECK(!error);
+        lines.push_back(line);
+        done = true;
+    };
+    pty.send("first\r");
+    executor.asyncReadUntil(port, "\r\n", 1024, collect);
+    executor.runOnce(50);
+    CHECK(!done);
+    pty.send("\nsecond\r\nthird");
+    run_until(executor, done);
+    done = false;
+    executor.asyncReadUntil(port, "\r\n", 1024, collect);
+    run_until(executor, done);
+    CHECK_EQ(2u, lines.size());
+    CHECK_EQ(std::string("first\r\n"), lines[0]);
+    CHECK_EQ(std::string("second\r\n"), lines[1]);
+    executor.remove(port);
+    CHECK_EQ(std::string("third"), port.read(5));
+}
+
+TEST(read_times_out_short)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(100));
+    IoExecutor executor;
+    executor.add(port);
+    uint8_t buffer[16];
+    size_t result = 99;
+    bool done = false;
+    pty.send("abc");
+    Clock::time_point start = Clock::now();
+    executor.asyncRead(port, buffer, sizeof(buffer), [&](size_t bytes_read, std::exception_ptr error) {
+        CHECK(!error);
+        result = bytes_read;
+        done = true;
+    });
+    run_until(executor, done);
+    long elapsed = static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        Clock::now() - start)
+                                         .count());
+    CHECK(done);
+    CHECK_EQ(3u, result);
+    CHECK(elapsed >= 90 && elapsed < 1000);
+}
+
+TEST(write_reaches_device)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(1000));
+    IoExecutor executor;
+    executor.add(port);
+    std::string data(100000, 'x');
+    size_t result = 0;
+    bool done = false;
+    executor.asyncWrite(port, reinterpret_cast<const uint8_t*>(data.data()), data.size(),
+        [&](size_t bytes_written, std::exception_ptr error) {
+            CHECK(!error);
+            result = bytes_written;
+            done = true;
+        });
+    // The pty only takes a few KiB at a time, the write finishes in pieces
+    // while the device side drains it
+    std::string received;
+    std::thread reader([&] { received = pty.receive(data.size()); });
+    run_until(executor, done);
+    reader.join();
+    CHECK_EQ(data.size(), result);
+    CHECK_EQ(data, received);
+}
+
+TEST(remove_cancels_pending_operations)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(1000));
+    IoExecutor executor;
+    executor.add(port);
+    uint8_t buffer[4];
+    bool cancelled = false;
+    executor.asyncRead(port, buffer, sizeof(buffer), [&](size_t, std::exception_ptr error) {
+        cancelled = static_cast<bool>(error);
+    });
+    CHECK_THROWS(serial::SerialException, executor.asyncRead(port, buffer, 1, IoExecutor::Handler()));
+    executor.remove(port);
+    CHECK(IoExecutor::of(port) == NULL);
+    run_until(executor, cancelled);
+    CHECK(cancelled);
+    CHECK_EQ(0u, executor.pending());
+    CHECK_THROWS(serial::SerialException, executor.asyncRead(port, buffer, 1, IoExecutor::Handler()));
+}
+
+TEST(destroying_a_port_fails_its_operations)
+{
+    PtyPair pty;
+    IoExecutor executor;
+    uint8_t buffer[4];
+    bool failed = false;
+    {
+        // Goes out of scope before the executor, still registered
+        Serial port(pty.name(), 115200, Timeout::simpleTimeout(1000));
+        executor.add(port);
+        executor.asyncRead(port, buffer, sizeof(buffer), [&](size_t, std::exception_ptr error) {
+            failed = static_cast<bool>(error);
+        });
+    }
+    CHECK_EQ(0u, executor.pending());
+    run_until(executor, failed);
+    CHECK(failed);
+}
+
+TEST(destroying_the_executor_fails_pending_operations)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(1000));
+    uint8_t buffer[4];
+    bool failed = false;
+    {
+        IoExecutor executor;
+        executor.add(port);
+        executor.asyncRead(port, buffer, sizeof(buffer), [&](size_t, std::exception_ptr error) {
+            failed = static_cast<bool>(error);
+        });
+    }
+    CHECK(failed);
+    CHECK(IoExecutor::of(port) == NULL);
+}
+
+TEST(ports_progress_independently)
+{
+    PtyPair first_pty;
+    PtyPair second_pty;
+    Serial first(first_pty.name(), 115200, Timeout::simpleTimeout(1000));
+    Serial second(second_pty.name(), 115200, Timeout::simpleTimeout(1000));
+    IoExecutor executor;
+    executor.add(first);
+    executor.add(second);
+    std::string first_line;
+    std::string second_line;
+    bool first_done = false;
+    bool second_done = false;
+    executor.asyncReadUntil(first, "\n", 64, [&](std::string line, std::exception_ptr) {
+        first_line = line;
+        first_done = true;
+    });
+    executor.asyncReadUntil(second, "\n", 64, [&](std::string line, std::exception_ptr) {
+        second_line = line;
+        second_done = true;
+    });
+    second_pty.send("two\n");
+    run_until(executor, second_done);
+    CHECK_EQ(std::string("two\n"), second_line);
+    CHECK(!first_done);
+    first_pty.send("one\n");
+    run_until(executor, first_done);
+    CHECK_EQ(std::string("one\n"), first_line);
+}
+
+#ifdef __cpp_impl_coroutine
+static serial::Detached
+echo_lines(Serial& port, int count, int& echoed)
+{
+    for (int i = 0; i < count; ++i) {
+        std::string line = co_await port.asyncReadUntil("\r\n");
+        size_t written = co_await port.asyncWrite("echo " + line);
+        CHECK_EQ(line.size() + 5, written);
+        ++echoed;
+    }
+}
+
+TEST(coroutine_echoes_lines)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(1000));
+    IoExecutor executor;
+    executor.add(port);
+    int echoed = 0;
+    echo_lines(port, 3, echoed);
+    pty.send("a\r\nbb\r\nccc\r\n");
+    Clock::time_point give_up = Clock::now() + std::chrono::seconds(2);
+    while (echoed < 3 && Clock::now() < give_up) {
+        executor.runOnce(50);
+    }
+    CHECK_EQ(3, echoed);
+    CHECK_EQ(std::string("echo a\r\necho bb\r\necho ccc\r\n"), pty.receive(27));
+}
+
+static serial::Detached
+read_frame(Serial& port, std::vector<uint8_t>& frame, size_t& result, bool& done)
+{
+    result = co_await port.asyncRead(frame.data(), frame.size());
+    done = true;
+}
+
+TEST(coroutine_read_times_out_short)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(100));
+    IoExecutor executor;
+    executor.add(port);
+    std::vector<uint8_t> frame(10);
+    size_t result = 0;
+    bool done = false;
+    pty.send("1234");
+    read_frame(port, frame, result, done);
+    run_until(executor, done);
+    CHECK(done);
+    CHECK_EQ(4u, result);
+}
+
+static serial::Detached
+read_cancelled(Serial& port, bool& thrown)
+{
+    try {
+        co_await port.asyncReadUntil();
+    }
+    catch (const serial::SerialException&) {
+        thrown = true;
+    }
+}
+
+TEST(coroutine_sees_cancellation_as_exception)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(1000));
+    IoExecutor executor;
+    executor.add(port);
+    bool thrown = false;
+    read_cancelled(port, thrown);
+    executor.remove(port);
+    run_until(executor, thrown);
+    CHECK(thrown);
+    CHECK_THROWS(serial::SerialException, port.asyncReadUntil());
+}
+
+TEST(coroutine_resumes_when_executor_is_destroyed)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(1000));
+    bool thrown = false;
+    {
+        IoExecutor executor;
+        executor.add(port);
+        read_cancelled(port, thrown);
+    }
+    CHECK(thrown);
+}
+#endif
+
+SERIAL_TEST_MAIN()
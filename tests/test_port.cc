@@ -0,0 +1,285 @@
+/* Opening, closing and configuring a port */
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdarg>
+#include <memory>
+#include <thread>
+
+#include <dlfcn.h>
+#include <sys/ioctl.h>
+
+#include "serial/serial.h"
+#include "test_util.h"
+
+using serial::OpenResult;
+using serial::PortSpec;
+using serial::Serial;
+using serial::Timeout;
+using serial_test::PtyPair;
+
+// While set, TCSETS2 fails like a driver rejecting a custom rate. The pty
+// takes any rate, and by then the other settings are already applied.
+static bool reject_custom_baud = false;
+
+// While positive, TIOCOUTQ reports that many bytes queued, one fewer per
+// call, like a UART slowly sending them. A pty's queue is always empty.
+static int stub_output_queue = 0;
+
+// Declared __THROW (noexcept) by <sys/ioctl.h>, the definition must match
+int ioctl(int fd, unsigned long request, ...) __THROW
+{
+    typedef int (*Ioctl)(int, unsigned long, void*);
+    static Ioctl real = reinterpret_cast<Ioctl>(dlsym(RTLD_NEXT, "ioctl"));
+    va_list ap;
+    va_start(ap, request);
+    void* argument = va_arg(ap, void*);
+    va_end(ap);
+    // TCSETS2 is _IOW('T', 0x2B, struct termios2)
+    if (reject_custom_baud && _IOC_TYPE(request) == 'T' && _IOC_NR(request) == 0x2B) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (stub_output_queue > 0 && request == TIOCOUTQ) {
+        *static_cast<int*>(argument) = stub_output_queue--;
+        return 0;
+    }
+    return real(fd, request, argument);
+}
+
+TEST(opens_and_closes)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200);
+    CHECK(port.isOpen());
+    CHECK_EQ(pty.name(), port.getPort());
+    CHECK_THROWS(serial::SerialException, port.open());
+    port.close();
+    CHECK(!port.isOpen());
+    port.open();
+    CHECK(port.isOpen());
+}
+
+TEST(deferred_open)
+{
+    PtyPair pty;
+    Serial port;
+    CHECK(!port.isOpen());
+    CHECK_THROWS(std::invalid_argument, port.open());
+    CHECK_THROWS(serial::PortNotOpenedException, port.write("x"));
+    port.setPort(pty.name());
+    port.open();
+    CHECK(port.isOpen());
+}
+
+TEST(missing_device_throws)
+{
+    CHECK_THROWS(serial::IOException, Serial("/dev/does-not-exist-serial-test"));
+}
+
+TEST(configure_reaches_termios)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200);
+    port.configure(serial::PortConfig(57600, serial::sevenbits,
+        serial::parity_even, serial::stopbits_two, serial::flowcontrol_hardware));
+
+    serial::PortConfig config = port.getConfig();
+    CHECK_EQ(57600u, config.baudrate);
+    CHECK(config.bytesize == serial::sevenbits);
+    CHECK(config.parity == serial::parity_even);
+    CHECK(config.stopbits == serial::stopbits_two);
+    CHECK(config.flowcontrol == serial::flowcontrol_hardware);
+
+    // The pty driver pins character size and parity to CS8 without parity,
+    // so only the remaining fields can be checked on the device
+    termios options;
+    CHECK_EQ(0, tcgetattr(pty.slave(), &options));
+    CHECK_EQ(static_cast<speed_t>(B57600), cfgetospeed(&options));
+    CHECK(options.c_cflag & CSTOPB);
+    CHECK(options.c_cflag & CRTSCTS);
+}
+
+TEST(configure_keeps_old_settings_on_failure)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 9600);
+    CHECK_THROWS(std::invalid_argument,
+        port.configure(serial::PortConfig(19200, static_cast<serial::bytesize_t>(42))));
+    CHECK_EQ(9600u, port.getBaudrate());
+    CHECK(port.getBytesize() == serial::eightbits);
+}
+
+TEST(configure_restores_the_port_after_a_partial_apply)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 9600);
+    reject_custom_baud = true;
+    CHECK_THROWS(serial::IOException,
+        port.configure(serial::PortConfig(12345, serial::eightbits, serial::parity_none,
+            serial::stopbits_two, serial::flowcontrol_hardware)));
+    reject_custom_baud = false;
+    CHECK(port.getConfig() == serial::PortConfig(9600));
+
+    // The stop bits and flow control went out before the rate failed
+    termios options;
+    CHECK_EQ(0, tcgetattr(pty.slave(), &options));
+    CHECK_EQ(static_cast<speed_t>(B9600), cfgetospeed(&options));
+    CHECK(!(options.c_cflag & CSTOPB));
+    CHECK(!(options.c_cflag & CRTSCTS));
+}
+
+TEST(individual_setters)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 9600);
+    port.setBaudrate(38400);
+    port.setParity(serial::parity_odd);
+    port.setStopbits(serial::stopbits_one);
+    port.setBytesize(serial::eightbits);
+    port.setFlowcontrol(serial::flowcontrol_software);
+
+    termios options;
+    CHECK_EQ(0, tcgetattr(pty.slave(), &options));
+    CHECK_EQ(static_cast<speed_t>(B38400), cfgetospeed(&options));
+    CHECK(options.c_iflag & IXON);
+}
+
+TEST(timeouts_round_trip)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 9600);
+    port.setTimeout(serial::MicrosecondTimeout(250, 1500, 2, 999, 0));
+    serial::MicrosecondTimeout timeout = port.getMicrosecondTimeout();
+    CHECK_EQ(250u, timeout.inter_byte_timeout);
+    CHECK_EQ(1500u, timeout.read_timeout_constant);
+
+    // Sub-millisecond values round up rather than becoming non-blocking
+    serial::Timeout legacy = port.getTimeout();
+    CHECK_EQ(1u, legacy.inter_byte_timeout);
+    CHECK_EQ(2u, legacy.read_timeout_constant);
+    CHECK_EQ(1u, legacy.write_timeout_constant);
+}
+
+TEST(low_latency_on_pty_is_harmless)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200);
+    port.setLowLatency(true);
+    CHECK(port.getLowLatency());
+    port.close();
+    port.open();
+    port.setLowLatency(false);
+    CHECK(!port.getLowLatency());
+}
+
+TEST(output_queue_drains)
+{
+    // A pty hands written bytes straight to the other side, so the output
+    // queue is always empty and waitTransmitted returns at once
+    PtyPair pty;
+    Serial port(pty.name(), 9600, Timeout::simpleTimeout(100));
+    port.write(std::string(100, 'x'));
+    CHECK_EQ(0u, port.outputPending());
+    CHECK(port.waitTransmitted(50));
+    port.close();
+    CHECK_THROWS(serial::PortNotOpenedException, port.outputPending());
+    CHECK_THROWS(serial::PortNotOpenedException, port.waitTransmitted(50));
+}
+
+TEST(wait_transmitted_sleeps_while_bytes_are_queued)
+{
+    typedef std::chrono::steady_clock Clock;
+    PtyPair pty;
+    Serial port(pty.name(), 9600, Timeout::simpleTimeout(100));
+
+    // About a second of bytes at 9600 baud, far more than the timeout
+    stub_output_queue = 1000;
+    Clock::time_point start = Clock::now();
+    CHECK(!port.waitTransmitted(50));
+    auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+    CHECK(waited.count() >= 40);
+    CHECK(waited.count() < 500);
+
+    // A queue that empties, each poll sleeps the estimated time of what is left
+    stub_output_queue = 3;
+    CHECK(port.waitTransmitted(1000));
+    CHECK_EQ(0, stub_output_queue);
+    stub_output_queue = 0;
+}
+
+TEST(open_all_reports_each_port)
+{
+    std::vector<std::unique_ptr<PtyPair>> ptys;
+    std::vector<PortSpec> specs;
+    std::atomic<int> setups(0);
+    for (int i = 0; i < 6; ++i) {
+        ptys.emplace_back(new PtyPair);
+        PortSpec spec;
+        spec.port = i == 3 ? std::string("/dev/does-not-exist-serial-test") : ptys.back()->name();
+        spec.baudrate = 57600;
+        spec.timeout = Timeout::simpleTimeout(250);
+        spec.setup = [&setups](Serial&) { ++setups; };
+        specs.push_back(spec);
+    }
+    specs[5].setup = [](Serial&) { throw serial::SerialException("setup failed"); };
+
+    std::vector<OpenResult> results = serial::open_all(specs, 4);
+    CHECK_EQ(specs.size(), results.size());
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (i == 3 || i == 5) {
+            CHECK(!results[i].serial);
+            CHECK(static_cast<bool>(results[i].error));
+            continue;
+        }
+        CHECK(!results[i].error);
+        CHECK(results[i].serial && results[i].serial->isOpen());
+        if (results[i].serial) {
+            CHECK_EQ(specs[i].port, results[i].serial->getPort());
+            CHECK_EQ(57600u, results[i].serial->getBaudrate());
+            CHECK_EQ(250u, results[i].serial->getTimeout().read_timeout_constant);
+        }
+    }
+    CHECK_EQ(4, setups.load());
+    CHECK_THROWS(serial::IOException, std::rethrow_exception(results[3].error));
+    CHECK_THROWS(serial::SerialException, std::rethrow_exception(results[5].error));
+    CHECK(serial::open_all(std::vector<PortSpec>()).empty());
+}
+
+TEST(open_all_overlaps_slow_ports)
+{
+    typedef std::chrono::steady_clock Clock;
+    std::vector<std::unique_ptr<PtyPair>> ptys;
+    std::vector<PortSpec> specs;
+    std::atomic<int> running(0);
+    std::atomic<int> most_running(0);
+    for (int i = 0; i < 8; ++i) {
+        ptys.emplace_back(new PtyPair);
+        PortSpec spec;
+        spec.port = ptys.back()->name();
+        // Stands in for a driver that takes long to bring the device up
+        spec.setup = [&](Serial&) {
+            int now = ++running;
+            int seen = most_running.load();
+            while (now > seen && !most_running.compare_exchange_weak(seen, now)) {
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            --running;
+        };
+        specs.push_back(spec);
+    }
+
+    Clock::time_point start = Clock::now();
+    std::vector<OpenResult> results = serial::open_all(specs, 4);
+    Clock::duration elapsed = Clock::now() - start;
+    for (const OpenResult& result : results) {
+        CHECK(result.serial && !result.error);
+    }
+    // Two rounds of four instead of eight one after another
+    CHECK(elapsed < std::chrono::milliseconds(600));
+    CHECK(most_running.load() <= 4);
+    CHECK(most_running.load() > 1);
+}
+
+SERIAL_TEST_MAIN()
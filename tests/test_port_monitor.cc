@@ -0,0 +1,305 @@
+/* Port enumeration and the hotplug driven PortMonitor */
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include "serial/impl/list_ports.h"
+#include "serial/impl/port_index.h"
+#include "serial/port_monitor.h"
+#include "serial/serial.h"
+#include "test_util.h"
+
+using serial::PortInfo;
+using serial::PortMonitor;
+using serial::Uevent;
+
+typedef std::chrono::steady_clock Clock;
+
+static const char kernel_add[] = "add@/devices/pci0000:00/usb1/1-1/1-1:1.0/ttyUSB3/tty/ttyUSB3\0"
+                                 "ACTION=add\0"
+                                 "DEVPATH=/devices/pci0000:00/usb1/1-1/1-1:1.0/ttyUSB3/tty/ttyUSB3\0"
+                                 "SUBSYSTEM=tty\0"
+                                 "MAJOR=188\0"
+                                 "MINOR=3\0"
+                                 "DEVNAME=ttyUSB3\0"
+                                 "SEQNUM=4711";
+
+TEST(parse_uevent_reads_kernel_messages)
+{
+    Uevent event;
+    CHECK(serial::parse_uevent(kernel_add, sizeof(kernel_add), event));
+    CHECK_EQ(std::string("add"), event.action);
+    CHECK_EQ(std::string("tty"), event.subsystem);
+    CHECK_EQ(std::string("ttyUSB3"), event.devname);
+
+    // The last pair need not be terminated
+    CHECK(serial::parse_uevent(kernel_add, sizeof(kernel_add) - 1, event));
+    CHECK_EQ(std::string("ttyUSB3"), event.devname);
+}
+
+TEST(parse_uevent_rejects_other_messages)
+{
+    Uevent event;
+    static const char udev[] = "libudev\0\xfe\xed\xca\xfe";
+    CHECK(!serial::parse_uevent(udev, sizeof(udev), event));
+    CHECK(!serial::parse_uevent("", 0, event));
+    static const char unterminated[] = { 'a', 'd', 'd', '@', '/' };
+    CHECK(!serial::parse_uevent(unterminated, sizeof(unterminated), event));
+}
+
+TEST(port_names_match_list_ports)
+{
+    CHECK(serial::is_port_name("ttyUSB0"));
+    CHECK(serial::is_port_name("ttyACM12"));
+    CHECK(serial::is_port_name("ttyS3"));
+    CHECK(!serial::is_port_name("tty1"));
+    CHECK(!serial::is_port_name("ptmx"));
+    CHECK(!serial::is_port_name(""));
+    for (const PortInfo& info : serial::list_ports()) {
+        CHECK_EQ(std::string("/dev/"), info.port.substr(0, 5));
+        CHECK(serial::is_port_name(info.port.substr(5)));
+    }
+}
+
+static void
+write_attribute(const std::string& path, const std::string& value)
+{
+    std::ofstream(path.c_str()) << value << "\n";
+}
+
+TEST(list_ports_reads_fake_sysfs)
+{
+    char root_template[] = "/tmp/test_list_ports.XXXXXX";
+    std::string root = mkdtemp(root_template);
+    std::string usb = root + "/sys/devices/usb1/1-2";
+    std::string tty = usb + "/1-2:1.3/ttyUSB0/tty/ttyUSB0";
+    for (const char* dir : { "/dev", "/dev/serial", "/dev/serial/by-id", "/sys", "/sys/class",
+             "/sys/class/tty", "/sys/devices", "/sys/devices/usb1", "/sys/devices/usb1/1-2",
+             "/sys/devices/usb1/1-2/1-2:1.3", "/sys/devices/usb1/1-2/1-2:1.3/ttyUSB0",
+             "/sys/devices/usb1/1-2/1-2:1.3/ttyUSB0/tty", "/sys/devices/usb1/1-2/1-2:1.3/ttyUSB0/tty/ttyUSB0" }) {
+        CHECK_EQ(0, mkdir((root + dir).c_str(), 0755));
+    }
+    CHECK_EQ(0, symlink("../../../ttyUSB0", (tty + "/device").c_str()));
+    CHECK_EQ(0, symlink(tty.c_str(), (root + "/sys/class/tty/ttyUSB0").c_str()));
+    CHECK_EQ(0, symlink("../../../bus/usb-serial/drivers/ftdi_sio", (usb + "/1-2:1.3/ttyUSB0/driver").c_str()));
+    CHECK_EQ(0, symlink("../../ttyUSB0", (root + "/dev/serial/by-id/usb-FTDI_FT232R_A1-if03-port0").c_str()));
+    write_attribute(usb + "/1-2:1.3/bInterfaceNumber", "03");
+    write_attribute(usb + "/idVendor", "0403");
+    write_attribute(usb + "/idProduct", "6001");
+    write_attribute(usb + "/manufacturer", "FTDI");
+    write_attribute(usb + "/product", "FT232R");
+    write_attribute(usb + "/serial", "A1");
+    for (const char* name : { "ttyUSB0", "ttyS1", "ttyS0", "tty1", "null" }) {
+        write_attribute(root + "/dev/" + name, "");
+    }
+
+    std::vector<PortInfo> ports = serial::list_ports_in(root + "/dev", root + "/sys/class/tty", serial::ListPortsOptions(), 1);
+    CHECK_EQ(3u, ports.size());
+    if (ports.size() == 3) {
+        CHECK_EQ(root + "/dev/ttyS0", ports[0].port);
+        CHECK_EQ(std::string("ttyS0"), ports[0].description);
+        CHECK_EQ(std::string("n/a"), ports[0].hardware_id);
+        CHECK_EQ(root + "/dev/ttyS1", ports[1].port);
+        CHECK_EQ(root + "/dev/ttyUSB0", ports[2].port);
+        CHECK_EQ(std::string("FTDI FT232R A1"), ports[2].description);
+        CHECK_EQ(std::string("USB VID:PID=0403:6001 SNR=A1"), ports[2].hardware_id);
+        CHECK_EQ(0x0403, ports[2].vid);
+        CHECK_EQ(0x6001, ports[2].pid);
+        CHECK_EQ(std::string("A1"), ports[2].serial_number);
+        CHECK_EQ(3, ports[2].interface_number);
+        CHECK_EQ(std::string("ftdi_sio"), ports[2].driver);
+        CHECK_EQ(root + "/dev/serial/by-id/usb-FTDI_FT232R_A1-if03-port0", ports[2].by_id_path);
+        CHECK_EQ(0, ports[0].vid);
+        CHECK_EQ(-1, ports[0].interface_number);
+        CHECK(ports[0].by_id_path.empty());
+    }
+    // What PortMonitor looks for until udev made the link
+    CHECK_EQ(root + "/dev/serial/by-id/usb-FTDI_FT232R_A1-if03-port0", serial::by_id_link(root + "/dev", "ttyUSB0"));
+    CHECK(serial::by_id_link(root + "/dev", "ttyS0").empty());
+    CHECK(serial::by_id_link(root + "/missing", "ttyUSB0").empty());
+    CHECK_EQ(0, system(("rm -rf " + root).c_str()));
+}
+
+TEST(present_only_leaves_out_phantom_uarts)
+{
+    char root_template[] = "/tmp/test_list_ports.XXXXXX";
+    std::string root = mkdtemp(root_template);
+    for (const char* dir : { "/dev", "/sys", "/sys/class", "/sys/class/tty", "/sys/class/tty/ttyS0",
+             "/sys/class/tty/ttyS1", "/sys/class/tty/ttyS2", "/sys/class/tty/ttyUSB0" }) {
+        CHECK_EQ(0, mkdir((root + dir).c_str(), 0755));
+    }
+    write_attribute(root + "/sys/class/tty/ttyS0/type", "4");
+    write_attribute(root + "/sys/class/tty/ttyS1/type", "0");
+    // ttyS2 has no type attribute and its node is a plain file, which the
+    // TIOCGSERIAL fallback cannot judge
+    for (const char* name : { "ttyS0", "ttyS1", "ttyS2", "ttyUSB0" }) {
+        write_attribute(root + "/dev/" + name, "");
+    }
+
+    serial::ListPortsOptions options;
+    CHECK_EQ(4u, serial::list_ports_in(root + "/dev", root + "/sys/class/tty", options, 1).size());
+    options.present_only = true;
+    std::vector<PortInfo> ports = serial::list_ports_in(root + "/dev", root + "/sys/class/tty", options, 1);
+    CHECK_EQ(3u, ports.size());
+    if (ports.size() == 3) {
+        CHECK_EQ(root + "/dev/ttyS0", ports[0].port);
+        CHECK_EQ(root + "/dev/ttyS2", ports[1].port);
+        CHECK_EQ(root + "/dev/ttyUSB0", ports[2].port);
+    }
+    CHECK_EQ(0, system(("rm -rf " + root).c_str()));
+}
+
+static PortInfo
+usb_port(const std::string& port, uint16_t vid, uint16_t pid, const std::string& serial_number, int interface_number)
+{
+    PortInfo info;
+    info.port = port;
+    info.vid = vid;
+    info.pid = pid;
+    info.serial_number = serial_number;
+    info.interface_number = interface_number;
+    return info;
+}
+
+TEST(port_index_finds_by_usb_identity)
+{
+    std::vector<PortInfo> ports;
+    ports.push_back(usb_port("/dev/ttyUSB3", 0x0403, 0x6011, "FT4", 1));
+    ports.push_back(usb_port("/dev/ttyUSB2", 0x0403, 0x6011, "FT4", 0));
+    ports.push_back(usb_port("/dev/ttyUSB0", 0x0403, 0x6001, "A1", 0));
+    ports.push_back(usb_port("/dev/ttyUSB1", 0x0403, 0x6001, "B2", 0));
+    ports.push_back(usb_port("/dev/ttyS0", 0, 0, "", -1));
+    serial::PortIndex index(ports);
+
+    std::vector<PortInfo> found = index.find(0x0403, 0x6011, "FT4");
+    CHECK_EQ(2u, found.size());
+    if (found.size() == 2) {
+        CHECK_EQ(std::string("/dev/ttyUSB2"), found[0].port);
+        CHECK_EQ(std::string("/dev/ttyUSB3"), found[1].port);
+    }
+    found = index.find(0x0403, 0x6001, "B2");
+    CHECK_EQ(1u, found.size());
+    CHECK_EQ(std::string("/dev/ttyUSB1"), found.empty() ? std::string() : found[0].port);
+    CHECK_EQ(2u, index.find(0x0403, 0x6001, "").size());
+    CHECK(index.find(0x0403, 0x6001, "C3").empty());
+    CHECK(index.find(0, 0, "").empty());
+}
+
+TEST(find_port_matches_list_ports)
+{
+    for (const PortInfo& info : serial::list_ports()) {
+        if (info.vid == 0) {
+            continue;
+        }
+        bool found = false;
+        for (const PortInfo& match : serial::find_port(info.vid, info.pid, info.serial_number)) {
+            found = found || match.port == info.port;
+        }
+        CHECK(found);
+    }
+    CHECK(serial::find_port(0xffff, 0xffff).empty());
+    // Unchanged /dev, answered from the index
+    CHECK(serial::find_port(0xffff, 0xffff, "none").empty());
+}
+
+TEST(monitor_starts_from_list_ports)
+{
+    PortMonitor monitor;
+    PortMonitor::Snapshot ports = monitor.ports();
+    std::vector<PortInfo> listed = serial::list_ports();
+    CHECK_EQ(listed.size(), ports->size());
+    for (const PortInfo& info : listed) {
+        bool found = false;
+        for (const PortInfo& known : *ports) {
+            found = found || (known.port == info.port && known.hardware_id == info.hardware_id);
+        }
+        CHECK(found);
+    }
+    // Unchanged tables hand out the same snapshot
+    CHECK(ports == monitor.ports());
+    for (const PortInfo& info : *ports) {
+        if (info.vid != 0) {
+            CHECK(!monitor.find(info.vid, info.pid, info.serial_number).empty());
+        }
+    }
+    CHECK(monitor.find(0xffff, 0xffff).empty());
+}
+
+TEST(monitor_ignores_events_not_sent_by_the_kernel)
+{
+    int added = 0;
+    PortMonitor::Callbacks callbacks;
+    callbacks.on_add = [&](const PortInfo&) { ++added; };
+    PortMonitor monitor(callbacks);
+    size_t before = monitor.ports()->size();
+
+    // Multicasting to the uevent group needs CAP_NET_ADMIN, without it there
+    // is nothing to check
+    int sender = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    CHECK(sender != -1);
+    sockaddr_nl address;
+    memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = 1;
+    ssize_t sent = sendto(sender, kernel_add, sizeof(kernel_add), 0,
+        reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    ::close(sender);
+    if (sent > 0) {
+        CHECK_EQ(0u, monitor.runOnce(200));
+    }
+    CHECK_EQ(0, added);
+    CHECK_EQ(before, monitor.ports()->size());
+}
+
+TEST(monitor_applies_kernel_events)
+{
+    int added = 0;
+    PortMonitor::Callbacks callbacks;
+    callbacks.on_add = [&](const PortInfo&) { ++added; };
+    PortMonitor monitor(callbacks);
+    PortMonitor::Snapshot before = monitor.ports();
+    if (before->empty()) {
+        return;
+    }
+
+    // Writing an action to a device's uevent file makes the kernel emit
+    // that event, which needs root and a writable /sys
+    std::string name = before->front().port.substr(5);
+    FILE* trigger = fopen(("/sys/class/tty/" + name + "/uevent").c_str(), "w");
+    if (trigger == NULL) {
+        return;
+    }
+    bool written = fputs("add", trigger) >= 0;
+    written = fclose(trigger) == 0 && written;
+    if (!written) {
+        return;
+    }
+    Clock::time_point give_up = Clock::now() + std::chrono::seconds(2);
+    while (monitor.ports() == before && Clock::now() < give_up) {
+        monitor.runOnce(50);
+    }
+    // A known port is refreshed in place, without a callback
+    CHECK(monitor.ports() != before);
+    CHECK_EQ(before->size(), monitor.ports()->size());
+    CHECK_EQ(0, added);
+}
+
+TEST(stop_ends_run)
+{
+    PortMonitor monitor;
+    CHECK_EQ(0u, monitor.runOnce(0));
+    std::thread loop([&] { monitor.run(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Clock::time_point start = Clock::now();
+    monitor.stop();
+    loop.join();
+    CHECK(Clock::now() - start < std::chrono::seconds(1));
+}
+
+SERIAL_TEST_MAIN()
@@ -0,0 +1,177 @@
+/* Callback driven receive on many ports through Reactor */
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "serial/reactor.h"
+#include "serial/serial.h"
+#include "test_util.h"
+
+using serial::Reactor;
+using serial::Serial;
+using serial::Timeout;
+using serial_test::PtyPair;
+
+typedef std::chrono::steady_clock Clock;
+
+// Drives the reactor until received holds size bytes, for at most two seconds
+static void
+run_until(Reactor& reactor, const std::string& received, size_t size)
+{
+    Clock::time_point give_up = Clock::now() + std::chrono::seconds(2);
+    while (received.size() < size && Clock::now() < give_up) {
+        reactor.runOnce(50);
+    }
+}
+
+static Reactor::Callbacks
+collect_into(std::string& received, int& errors)
+{
+    Reactor::Callbacks callbacks;
+    callbacks.on_data = [&received](Serial&, const uint8_t* data, size_t size) {
+        received.append(reinterpret_cast<const char*>(data), size);
+    };
+    callbacks.on_error = [&errors](Serial&, const serial::SerialException&) {
+        ++errors;
+    };
+    return callbacks;
+}
+
+TEST(idle_port_stays_registered)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(100));
+    Reactor reactor;
+    std::string received;
+    int errors = 0;
+    reactor.add(port, collect_into(received, errors));
+    CHECK_EQ(1u, reactor.size());
+
+    // Nothing to read is not a disconnect
+    reactor.runOnce(5);
+    CHECK_EQ(0, errors);
+    CHECK_EQ(1u, reactor.size());
+
+    pty.send("late");
+    run_until(reactor, received, 4);
+    CHECK_EQ(std::string("late"), received);
+    CHECK_EQ(0, errors);
+}
+
+TEST(delivers_bytes_from_each_port)
+{
+    PtyPair first_pty;
+    PtyPair second_pty;
+    Serial first(first_pty.name(), 115200, Timeout::simpleTimeout(100));
+    Serial second(second_pty.name(), 115200, Timeout::simpleTimeout(100));
+    Reactor reactor;
+    std::string first_received;
+    std::string second_received;
+    int errors = 0;
+    reactor.add(first, collect_into(first_received, errors));
+    reactor.add(second, collect_into(second_received, errors));
+
+    // More than one read's worth, the drain must not end on a full buffer
+    std::string bulk(8192, 'x');
+    first_pty.send(bulk);
+    second_pty.send("two");
+    run_until(reactor, first_received, bulk.size());
+    run_until(reactor, second_received, 3);
+    CHECK(first_received == bulk);
+    CHECK_EQ(std::string("two"), second_received);
+    CHECK_EQ(0, errors);
+    CHECK_EQ(2u, reactor.size());
+}
+
+TEST(buffered_bytes_are_delivered_after_add)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(100));
+    pty.send("line\nrest");
+    CHECK_EQ(std::string("line\n"), port.readline());
+    // readline kept the tail in the receive buffer, where epoll cannot see it
+    Reactor reactor;
+    std::string received;
+    int errors = 0;
+    reactor.add(port, collect_into(received, errors));
+    run_until(reactor, received, 4);
+    CHECK_EQ(std::string("rest"), received);
+    CHECK_EQ(0, errors);
+}
+
+TEST(closing_a_port_unregisters_it)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(100));
+    Reactor reactor;
+    std::string received;
+    int errors = 0;
+    reactor.add(port, collect_into(received, errors));
+    port.close();
+    CHECK_EQ(0u, reactor.size());
+    reactor.runOnce(5);
+    CHECK_EQ(0, errors);
+
+    // Reopened, it can be registered again
+    port.open();
+    reactor.add(port, collect_into(received, errors));
+    CHECK_EQ(1u, reactor.size());
+    CHECK_THROWS(serial::SerialException, reactor.add(port, collect_into(received, errors)));
+}
+
+TEST(destroying_a_port_or_the_reactor_unregisters)
+{
+    PtyPair pty;
+    std::string received;
+    int errors = 0;
+    {
+        Reactor reactor;
+        {
+            Serial port(pty.name(), 115200, Timeout::simpleTimeout(100));
+            reactor.add(port, collect_into(received, errors));
+        }
+        CHECK_EQ(0u, reactor.size());
+        pty.send("gone");
+        reactor.runOnce(5);
+        CHECK(received.empty());
+    }
+
+    // The port must not reach back into a reactor that is gone
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(100));
+    std::unique_ptr<Reactor> reactor(new Reactor());
+    reactor->add(port, collect_into(received, errors));
+    reactor.reset();
+    port.close();
+    CHECK_EQ(0, errors);
+}
+
+TEST(stop_ends_run)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(100));
+    Reactor reactor;
+    std::string received;
+    int errors = 0;
+    reactor.add(port, collect_into(received, errors));
+    std::thread loop([&reactor]() { reactor.run(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    reactor.stop();
+    loop.join();
+    CHECK_EQ(0, errors);
+
+    // A stop from inside a callback ends run() after that iteration
+    Reactor::Callbacks callbacks = collect_into(received, errors);
+    reactor.remove(port);
+    callbacks.on_data = [&](Serial&, const uint8_t* data, size_t size) {
+        received.append(reinterpret_cast<const char*>(data), size);
+        reactor.stop();
+    };
+    reactor.add(port, callbacks);
+    pty.send("stop");
+    reactor.run();
+    CHECK_EQ(std::string("stop"), received);
+}
+
+SERIAL_TEST_MAIN()
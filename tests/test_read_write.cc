@@ -0,0 +1,360 @@
+/* Reading and writing through a pty pair */
+
+#include <chrono>
+#include <thread>
+
+#include "serial/serial.h"
+#include "test_util.h"
+
+using serial::Serial;
+using serial::Timeout;
+using serial_test::PtyPair;
+
+typedef std::chrono::steady_clock Clock;
+
+static long
+elapsed_ms(Clock::time_point start)
+{
+    return static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        Clock::now() - start)
+                                 .count());
+}
+
+TEST(write_reaches_device)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(100));
+    CHECK_EQ(5u, port.write("hello"));
+    std::vector<uint8_t> bytes = { 0x00, 0xff, 0x7f };
+    CHECK_EQ(3u, port.write(bytes));
+    CHECK_EQ(std::string("hello\x00\xff\x7f", 8), pty.receive(8));
+}
+
+TEST(read_exact_size)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(500));
+    pty.send("0123456789");
+    CHECK_EQ(std::string("0123"), port.read(4));
+    uint8_t buffer[6];
+    CHECK_EQ(6u, port.read(buffer, sizeof(buffer)));
+    CHECK_EQ(std::string("456789"), std::string(buffer, buffer + 6));
+}
+
+TEST(read_appends_to_containers)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(500));
+    pty.send("abcdef");
+    std::vector<uint8_t> bytes(1, 'x');
+    CHECK_EQ(3u, port.read(bytes, 3));
+    CHECK_EQ(4u, bytes.size());
+    CHECK_EQ('c', static_cast<char>(bytes[3]));
+    std::string text = "y";
+    CHECK_EQ(3u, port.read(text, 3));
+    CHECK_EQ(std::string("ydef"), text);
+}
+
+TEST(read_times_out_short)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(50));
+    pty.send("ab");
+    Clock::time_point start = Clock::now();
+    CHECK_EQ(std::string("ab"), port.read(10));
+    long waited = elapsed_ms(start);
+    CHECK(waited >= 40);
+    CHECK(waited < 1000);
+}
+
+TEST(read_waits_for_late_bytes)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(1000));
+    std::thread device([&pty]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        pty.send("late");
+    });
+    CHECK_EQ(std::string("late"), port.read(4));
+    device.join();
+}
+
+TEST(available_and_wait_readable)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(100));
+    CHECK_EQ(0u, port.available());
+    CHECK(!port.waitReadable());
+    pty.send("xyz");
+    CHECK(port.waitReadable());
+    CHECK_EQ(3u, port.available());
+}
+
+TEST(kernel_read_mode)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout(100, 500, 0, 100, 0));
+    port.setReadMode(serial::readmode_kernel);
+    CHECK(port.getReadMode() == serial::readmode_kernel);
+    std::thread device([&pty]() {
+        for (int i = 0; i < 4; ++i) {
+            pty.send("chunk");
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    });
+    CHECK_EQ(std::string("chunkchunkchunkchunk"), port.read(20));
+    device.join();
+    port.setReadMode(serial::readmode_poll);
+    pty.send("!");
+    CHECK_EQ(std::string("!"), port.read(1));
+}
+
+TEST(kernel_read_mode_returns_short_reads_at_the_deadline)
+{
+    // Without an inter byte timeout nothing may be held back for VMIN
+    PtyPair pty;
+    const Timeout timeouts[] = { Timeout::simpleTimeout(300), Timeout(0, 300, 0, 100, 0) };
+    for (const Timeout& timeout : timeouts) {
+        Serial port(pty.name(), 115200, timeout);
+        port.setReadMode(serial::readmode_kernel);
+        std::thread device([&pty]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            pty.send("0123456789");
+        });
+        Clock::time_point start = Clock::now();
+        CHECK_EQ(std::string("0123456789"), port.read(100));
+        device.join();
+        long elapsed = elapsed_ms(start);
+        CHECK(elapsed >= 250 && elapsed < 1000);
+        pty.send("x");
+        CHECK_EQ(std::string("x"), port.read(1));
+    }
+}
+
+TEST(uring_read_mode)
+{
+    // Falls back to readmode_poll where io_uring is unavailable, the reads
+    // behave the same either way
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(100));
+    port.setReadMode(serial::readmode_uring);
+    CHECK(port.getReadMode() == serial::readmode_uring
+        || port.getReadMode() == serial::readmode_poll);
+    std::thread device([&pty]() {
+        for (int i = 0; i < 4; ++i) {
+            pty.send("chunk");
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    });
+    CHECK_EQ(std::string("chunkchunkchunkchunk"), port.read(20));
+    device.join();
+
+    pty.send("ab");
+    Clock::time_point start = Clock::now();
+    CHECK_EQ(std::string("ab"), port.read(10));
+    CHECK(elapsed_ms(start) >= 90);
+
+    // The registered receive buffer behind readline, and its leftovers
+    pty.send("one\ntwo\nthr");
+    CHECK_EQ(std::string("one\n"), port.readline());
+    CHECK_EQ(std::string("two\n"), port.readline());
+    pty.send("ee\n");
+    CHECK_EQ(std::string("three\n"), port.readline());
+    std::string long_line(10000, 'x');
+    pty.send(long_line + "\n");
+    CHECK_EQ(long_line + "\n", port.readline(20000));
+
+    char a[3], b[4];
+    iovec parts[] = { { a, 3 }, { b, 4 } };
+    pty.send("ABCDEFG");
+    CHECK_EQ(7u, port.readv(parts, 2));
+    CHECK_EQ(std::string("ABCDEFG"), std::string(a, 3) + std::string(b, 4));
+
+    // Switching modes on an open port
+    port.setReadMode(serial::readmode_kernel);
+    pty.send("k");
+    CHECK_EQ(std::string("k"), port.read(1));
+    port.setReadMode(serial::readmode_uring);
+    port.close();
+    port.open();
+    pty.send("reopened");
+    CHECK_EQ(std::string("reopened"), port.read(8));
+    port.setReadMode(serial::readmode_poll);
+    CHECK(port.getReadMode() == serial::readmode_poll);
+    pty.send("!");
+    CHECK_EQ(std::string("!"), port.read(1));
+}
+
+TEST(scatter_gather_frames)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(200));
+    char header[] = "HD";
+    char empty[1];
+    char payload[] = "payload";
+    char crc[] = "C";
+    iovec frame[] = { { header, 2 }, { empty, 0 }, { payload, 7 }, { crc, 1 } };
+    CHECK_EQ(10u, port.writev(frame, 4));
+    CHECK_EQ(std::string("HDpayloadC"), pty.receive(10));
+
+    // Buffered readline leftovers are scattered first, then the port
+    pty.send("line\nABCDEFGHIJ");
+    CHECK_EQ(std::string("line\n"), port.readline());
+    char a[3], b[4], c[5];
+    iovec parts[] = { { a, 3 }, { b, 4 }, { c, 5 } };
+    CHECK_EQ(10u, port.readv(parts, 3));
+    CHECK_EQ(std::string("ABC"), std::string(a, 3));
+    CHECK_EQ(std::string("DEFG"), std::string(b, 4));
+    CHECK_EQ(std::string("HIJ"), std::string(c, 3));
+}
+
+TEST(kernel_mode_scatter_read)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout(100, 500, 0, 100, 0));
+    port.setReadMode(serial::readmode_kernel);
+    std::thread device([&pty]() {
+        for (int i = 0; i < 3; ++i) {
+            pty.send("abcd");
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    });
+    char a[5], b[7];
+    iovec parts[] = { { a, 5 }, { b, 7 } };
+    CHECK_EQ(12u, port.readv(parts, 2));
+    device.join();
+    CHECK_EQ(std::string("abcdabcdabcd"), std::string(a, 5) + std::string(b, 7));
+}
+
+TEST(paced_writes_stay_within_budget)
+{
+    // 10 ms at 9600 8N1 is 9 bytes, so 90 bytes take at least 10 writes
+    PtyPair pty;
+    Serial port(pty.name(), 9600, Timeout::simpleTimeout(500));
+    port.setWritePacing(10);
+    CHECK_EQ(10u, port.getWritePacing());
+    std::string data(90, 'p');
+    CHECK_EQ(data.size(), port.write(data));
+    CHECK(port.stats().write_calls >= 10);
+    CHECK_EQ(data, pty.receive(data.size()));
+    port.setWritePacing(0);
+}
+
+TEST(priority_write_overtakes_bulk)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 4000000, Timeout::simpleTimeout(2000));
+    std::string bulk(256 * 1024, 'x');
+    // Nobody reads yet, the bulk write stalls with the pty full
+    std::thread bulk_writer([&]() { port.write(bulk); });
+    while (port.stats().write_calls == 0) {
+        std::this_thread::yield();
+    }
+    std::thread urgent_writer([&]() { port.writePriority("URGENT"); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::string received = pty.receive(bulk.size() + 6);
+    bulk_writer.join();
+    urgent_writer.join();
+    CHECK_EQ(bulk.size() + 6, received.size());
+    size_t position = received.find("URGENT");
+    CHECK(position != std::string::npos);
+    CHECK(position + 6 < received.size());
+}
+
+TEST(large_transfer_both_ways)
+{
+    // Multi-byte reads sleep for the missing bytes' transmit time first, a
+    // fast line keeps that short for a 64 KiB transfer
+    PtyPair pty;
+    Serial port(pty.name(), 4000000, Timeout::simpleTimeout(1000));
+    std::string payload;
+    for (int i = 0; i < 64 * 1024; ++i) {
+        payload.push_back(static_cast<char>('a' + i % 26));
+    }
+    std::string received;
+    std::thread device([&]() { received = pty.receive(payload.size()); });
+    CHECK_EQ(payload.size(), port.write(payload));
+    device.join();
+    CHECK(received == payload);
+
+    std::thread sender([&]() { pty.send(payload); });
+    std::string echoed;
+    while (echoed.size() < payload.size()) {
+        if (port.read(echoed, payload.size() - echoed.size()) == 0) {
+            break;
+        }
+    }
+    sender.join();
+    CHECK(echoed == payload);
+}
+
+TEST(cancel_wakes_blocked_reads)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(10000));
+    const serial::readmode_t modes[] = { serial::readmode_poll, serial::readmode_kernel,
+        serial::readmode_uring };
+    for (size_t i = 0; i < 3; ++i) {
+        port.setReadMode(modes[i]);
+        pty.send("ab");
+        std::thread canceller([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            port.cancel();
+        });
+        Clock::time_point start = Clock::now();
+        CHECK_EQ(std::string("ab"), port.read(10));
+        canceller.join();
+        CHECK(elapsed_ms(start) < 2000);
+    }
+
+    std::thread canceller([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        port.cancel();
+    });
+    Clock::time_point start = Clock::now();
+    std::string line = port.readline();
+    canceller.join();
+    CHECK(line.empty());
+    CHECK(elapsed_ms(start) < 2000);
+}
+
+TEST(cancel_before_wait_ends_next_read)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(10000));
+    // Several cancels with nobody waiting end exactly one read
+    port.cancel();
+    port.cancel();
+    Clock::time_point start = Clock::now();
+    CHECK_EQ(std::string(), port.read(1));
+    CHECK(elapsed_ms(start) < 2000);
+    pty.send("x");
+    CHECK_EQ(std::string("x"), port.read(1));
+
+    // Reopening drops a cancel nobody consumed
+    port.cancel();
+    port.close();
+    port.open();
+    port.setTimeout(Timeout::simpleTimeout(200));
+    start = Clock::now();
+    CHECK_EQ(std::string(), port.read(1));
+    CHECK(elapsed_ms(start) >= 150);
+}
+
+TEST(cancel_wakes_blocked_write)
+{
+    // Nobody reads the device side, so the write fills the pty and blocks
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(10000));
+    std::thread canceller([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        port.cancel();
+    });
+    Clock::time_point start = Clock::now();
+    size_t written = port.write(std::string(1024 * 1024, 'x'));
+    canceller.join();
+    CHECK(written > 0 && written < 1024 * 1024);
+    CHECK(elapsed_ms(start) < 2000);
+}
+
+SERIAL_TEST_MAIN()
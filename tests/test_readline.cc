@@ -0,0 +1,103 @@
+/* Line oriented reads on top of the receive buffer */
+
+#include <chrono>
+#include <thread>
+
+#include "serial/serial.h"
+#include "test_util.h"
+
+using serial::Serial;
+using serial::Timeout;
+using serial_test::PtyPair;
+
+TEST(readline_splits_on_newline)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(100));
+    pty.send("first\nsecond\n");
+    CHECK_EQ(std::string("first\n"), port.readline());
+    CHECK_EQ(std::string("second\n"), port.readline());
+}
+
+TEST(readline_multi_byte_eol)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(100));
+    pty.send("a\rb\r\nc\r\n");
+    CHECK_EQ(std::string("a\rb\r\n"), port.readline(65536, "\r\n"));
+    CHECK_EQ(std::string("c\r\n"), port.readline(65536, "\r\n"));
+}
+
+TEST(readline_eol_split_across_chunks)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout(Timeout::max(), 200, 0, 100, 0));
+    pty.send("value\r");
+    std::string line;
+    std::thread device([&pty]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        pty.send("\nnext");
+    });
+    CHECK_EQ(7u, port.readline(line, 65536, "\r\n"));
+    device.join();
+    CHECK_EQ(std::string("value\r\n"), line);
+    CHECK_EQ(std::string("next"), port.read(4));
+}
+
+TEST(readline_waits_without_inter_byte_timeout)
+{
+    PtyPair pty;
+    // An inter byte timeout of 0 disables it, the read timeout still applies
+    Serial port(pty.name(), 115200, Timeout(0, 500, 0, 100, 0));
+    std::thread device([&pty]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        pty.send("late\n");
+    });
+    CHECK_EQ(std::string("late\n"), port.readline());
+    device.join();
+}
+
+TEST(readline_respects_size_limit)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(100));
+    pty.send("0123456789\n");
+    CHECK_EQ(std::string("0123"), port.readline(4));
+    CHECK_EQ(std::string("456789\n"), port.readline());
+}
+
+TEST(readline_times_out_without_eol)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(30));
+    pty.send("partial");
+    CHECK_EQ(std::string("partial"), port.readline());
+    CHECK_EQ(std::string(""), port.readline());
+}
+
+TEST(readlines_returns_every_line)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(30));
+    pty.send("one\ntwo\nthree\ntail");
+    std::vector<std::string> lines = port.readlines();
+    CHECK_EQ(4u, lines.size());
+    if (lines.size() == 4) {
+        CHECK_EQ(std::string("one\n"), lines[0]);
+        CHECK_EQ(std::string("three\n"), lines[2]);
+        CHECK_EQ(std::string("tail"), lines[3]);
+    }
+}
+
+TEST(read_after_readline_sees_buffered_bytes)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(100));
+    pty.send("line\nrest");
+    CHECK_EQ(std::string("line\n"), port.readline());
+    CHECK(port.available() >= 4u);
+    CHECK(port.waitReadable());
+    CHECK_EQ(std::string("rest"), port.read(4));
+}
+
+SERIAL_TEST_MAIN()
@@ -0,0 +1,88 @@
+/* I/O counters and latency histograms */
+
+#include "serial/serial.h"
+#include "test_util.h"
+
+using serial::LatencyHistogram;
+using serial::Serial;
+using serial::Timeout;
+using serial_test::PtyPair;
+
+TEST(counters_follow_traffic)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(20));
+    pty.send("hello\nxy");
+    port.readline();
+    port.read(5);
+    port.write("abc");
+
+    serial::PortStats stats = port.stats();
+    CHECK_EQ(8u, stats.bytes_read);
+    CHECK_EQ(3u, stats.bytes_written);
+    CHECK(stats.read_calls >= 1);
+    CHECK_EQ(1u, stats.write_calls);
+    CHECK_EQ(1u, stats.read_timeouts);
+    CHECK(stats.wait_calls >= 1);
+    CHECK(stats.wait_time_ns > 0);
+
+    port.resetStats();
+    CHECK_EQ(0u, port.stats().bytes_read);
+    CHECK_EQ(0u, port.stats().wait_calls);
+}
+
+TEST(histogram_buckets_bound_their_values)
+{
+    for (uint64_t value = 0; value < (uint64_t(1) << 36); value = value * 3 + 1) {
+        size_t bucket = LatencyHistogram::bucketIndex(value);
+        CHECK(LatencyHistogram::lowerBound(bucket) <= value);
+        CHECK(value <= LatencyHistogram::upperBound(bucket));
+    }
+}
+
+TEST(histogram_percentiles_and_merge)
+{
+    LatencyHistogram low;
+    LatencyHistogram high;
+    for (uint64_t i = 1; i <= 990; ++i) {
+        low.record(1000);
+    }
+    for (uint64_t i = 1; i <= 10; ++i) {
+        high.record(10000000);
+    }
+    low.merge(high);
+    CHECK_EQ(1000u, low.count());
+    // Within one sub-bucket (1/16) of the recorded value
+    CHECK(low.percentile(0.5) >= 1000 && low.percentile(0.5) < 1070);
+    CHECK(low.percentile(0.99) < 1070);
+    CHECK(low.percentile(0.999) >= 10000000);
+    CHECK(low.max() < 10700000);
+}
+
+TEST(latency_tracking_records_calls)
+{
+    PtyPair pty;
+    Serial port(pty.name(), 115200, Timeout::simpleTimeout(20));
+    CHECK(!port.getLatencyTracking());
+    port.read(1);
+    CHECK_EQ(0u, port.latencyStats().read.count());
+
+    port.setLatencyTracking(true);
+    pty.send("ab\n");
+    port.readline();
+    port.write("z");
+    port.read(1);
+
+    serial::LatencyStats latency = port.latencyStats();
+    CHECK_EQ(2u, latency.read.count());
+    CHECK_EQ(1u, latency.read_first_byte.count());
+    CHECK_EQ(1u, latency.write.count());
+    CHECK(latency.wait.count() >= 1);
+    CHECK(latency.read.max() >= 20000000);
+
+    port.setLatencyTracking(false);
+    port.read(1);
+    CHECK_EQ(2u, port.latencyStats().read.count());
+}
+
+SERIAL_TEST_MAIN()
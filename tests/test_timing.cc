@@ -0,0 +1,121 @@
+/* Timeout behaviour against a device paced at its baud rate */
+
+#include <chrono>
+
+#include "serial/serial.h"
+#include "test_util.h"
+#include "virtual_device.h"
+
+using serial::MicrosecondTimeout;
+using serial::PortConfig;
+using serial::Serial;
+using serial::Timeout;
+using serial_test::VirtualDevice;
+
+typedef std::chrono::steady_clock Clock;
+
+static long
+elapsed_ms(Clock::time_point start)
+{
+    return static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        Clock::now() - start)
+                                 .count());
+}
+
+TEST(byte_time_follows_line_settings)
+{
+    CHECK_EQ(1041660u, PortConfig(9600).byteTimeNs());
+    CHECK_EQ(86800u, PortConfig(115200).byteTimeNs());
+    // 7E2: start, 7 data, parity, 2 stop
+    CHECK_EQ(11u * 104166u, PortConfig(9600, serial::sevenbits, serial::parity_even, serial::stopbits_two).byteTimeNs());
+    CHECK_EQ(9u * 104166u + 104166u / 2,
+        PortConfig(9600, serial::sixbits, serial::parity_odd, serial::stopbits_one_point_five).byteTimeNs());
+}
+
+TEST(delivery_is_paced_by_baud)
+{
+    VirtualDevice device(PortConfig(9600));
+    Serial port(device.name(), 9600, Timeout::simpleTimeout(1000));
+    Clock::time_point start = Clock::now();
+    device.send(std::string(100, 'p'));
+    CHECK_EQ(100u, port.read(100).size());
+    long waited = elapsed_ms(start);
+    // 100 characters at 1.04 ms each
+    CHECK(waited >= 100);
+    CHECK(waited < 250);
+}
+
+TEST(multi_byte_read_waits_for_whole_request)
+{
+    VirtualDevice device(PortConfig(9600));
+    Serial port(device.name(), 9600, Timeout::simpleTimeout(1000));
+    device.send(std::string(64, 'w'));
+    port.resetStats();
+    CHECK_EQ(64u, port.read(64).size());
+    // waitByteTimes sleeps for the missing characters instead of waking
+    // for every byte
+    CHECK(port.stats().read_calls <= 6);
+}
+
+TEST(read_timeout_multiplier_scales_with_size)
+{
+    VirtualDevice device(PortConfig(9600));
+    Serial port(device.name(), 9600);
+    // 10 ms + 0.5 ms per requested byte, while each byte takes 1.04 ms
+    port.setTimeout(MicrosecondTimeout(MicrosecondTimeout::max(), 10000, 500, 1000, 0));
+    device.send(std::string(60, 'm'));
+    Clock::time_point start = Clock::now();
+    size_t got = port.read(60).size();
+    long waited = elapsed_ms(start);
+    CHECK(got < 60);
+    CHECK(got >= 20);
+    CHECK(waited >= 35);
+    CHECK(waited < 150);
+    device.flush();
+}
+
+TEST(kernel_inter_byte_timeout_ends_read_at_gap)
+{
+    VirtualDevice::Options options;
+    options.gap_every = 10;
+    options.gap_ns = 400000000;
+    VirtualDevice device(PortConfig(115200), options);
+    Serial port(device.name(), 115200, Timeout(100, 2000, 0, 100, 0));
+    port.setReadMode(serial::readmode_kernel);
+    device.send(std::string(20, 'g'));
+    Clock::time_point start = Clock::now();
+    CHECK_EQ(10u, port.read(20).size());
+    CHECK(elapsed_ms(start) < 350);
+    CHECK_EQ(10u, port.read(10).size());
+}
+
+TEST(bursts_arrive_whole)
+{
+    VirtualDevice::Options options;
+    options.burst_size = 16;
+    VirtualDevice device(PortConfig(115200), options);
+    Serial port(device.name(), 115200, Timeout::simpleTimeout(1000));
+    device.send(std::string(32, 'b'));
+    CHECK(port.waitReadable());
+    CHECK_EQ(16u, port.available());
+    CHECK_EQ(32u, port.read(32).size());
+}
+
+TEST(jitter_keeps_every_byte)
+{
+    VirtualDevice::Options options;
+    options.jitter_ns = 200000;
+    VirtualDevice device(PortConfig(115200), options);
+    Serial port(device.name(), 115200, Timeout::simpleTimeout(2000));
+    std::string payload;
+    for (int i = 0; i < 500; ++i) {
+        payload.push_back(static_cast<char>(i));
+    }
+    device.send(payload);
+    std::string received;
+    while (received.size() < payload.size() && port.read(received, payload.size() - received.size()) > 0) {
+    }
+    CHECK(received == payload);
+}
+
+SERIAL_TEST_MAIN()
@@ -0,0 +1,200 @@
+/*
+ * Minimal test harness for the pty backed tests. Each test file defines
+ * cases with TEST(name), checks with CHECK/CHECK_EQ/CHECK_THROWS and ends in
+ * SERIAL_TEST_MAIN(). A failing check reports file and line and marks the
+ * case failed; the executable exits non-zero when any case failed.
+ */
+
+#ifndef SERIAL_TESTS_TEST_UTIL_H
+#define SERIAL_TESTS_TEST_UTIL_H
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace serial_test {
+
+struct TestCase {
+    const char* name;
+    void (*function)();
+};
+
+inline std::vector<TestCase>&
+registry()
+{
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+inline bool& current_failed()
+{
+    static bool failed = false;
+    return failed;
+}
+
+struct Registrar {
+    Registrar(const char* name, void (*function)())
+    {
+        TestCase test_case = { name, function };
+        registry().push_back(test_case);
+    }
+};
+
+inline void
+fail(const char* file, int line, const std::string& message)
+{
+    fprintf(stderr, "  %s:%d: %s\n", file, line, message.c_str());
+    current_failed() = true;
+}
+
+inline int
+run_all()
+{
+    int failures = 0;
+    for (const TestCase& test_case : registry()) {
+        current_failed() = false;
+        try {
+            test_case.function();
+        }
+        catch (const std::exception& e) {
+            fail(__FILE__, __LINE__, std::string("unexpected exception: ") + e.what());
+        }
+        printf("[%s] %s\n", current_failed() ? "FAIL" : " OK ", test_case.name);
+        if (current_failed()) {
+            ++failures;
+        }
+    }
+    printf("%d of %zu cases failed\n", failures, registry().size());
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * A pty pair standing in for a serial device. The Serial under test opens
+ * name(); the test plays the device through master().
+ */
+class PtyPair {
+public:
+    PtyPair()
+        : master_(-1)
+        , slave_(-1)
+    {
+        char name[128];
+        if (openpty(&master_, &slave_, name, NULL, NULL) == -1) {
+            perror("openpty");
+            exit(EXIT_FAILURE);
+        }
+        name_ = name;
+        // Raw on the device side too, so bytes pass through unchanged
+        termios options;
+        tcgetattr(master_, &options);
+        cfmakeraw(&options);
+        tcsetattr(master_, TCSANOW, &options);
+    }
+
+    ~PtyPair()
+    {
+        ::close(master_);
+        ::close(slave_);
+    }
+
+    const std::string& name() const { return name_; }
+    int master() const { return master_; }
+    int slave() const { return slave_; }
+
+    // Sends bytes from the device side
+    void send(const std::string& data)
+    {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = ::write(master_, data.data() + sent, data.size() - sent);
+            if (n <= 0) {
+                perror("write");
+                exit(EXIT_FAILURE);
+            }
+            sent += static_cast<size_t>(n);
+        }
+    }
+
+    // Collects up to size bytes on the device side, waiting at most
+    // timeout_ms for each chunk
+    std::string receive(size_t size, int timeout_ms = 1000)
+    {
+        std::string data;
+        while (data.size() < size) {
+            pollfd event = { master_, POLLIN, 0 };
+            if (::poll(&event, 1, timeout_ms) <= 0) {
+                break;
+            }
+            char chunk[4096];
+            ssize_t n = ::read(master_, chunk, std::min(sizeof(chunk), size - data.size()));
+            if (n <= 0) {
+                break;
+            }
+            data.append(chunk, static_cast<size_t>(n));
+        }
+        return data;
+    }
+
+private:
+    PtyPair(const PtyPair&);
+    PtyPair& operator=(const PtyPair&);
+
+    int master_;
+    int slave_;
+    std::string name_;
+};
+
+} // namespace serial_test
+
+#define TEST(name)                                                   \
+    static void name();                                              \
+    static serial_test::Registrar name##_registrar(#name, &name);    \
+    static void name()
+
+#define CHECK(condition)                                                     \
+    do {                                                                     \
+        if (!(condition)) {                                                  \
+            serial_test::fail(__FILE__, __LINE__, "CHECK(" #condition ")"); \
+        }                                                                    \
+    } while (0)
+
+#define CHECK_EQ(expected, actual)                                      \
+    do {                                                                \
+        auto expected_value = (expected);                               \
+        auto actual_value = (actual);                                   \
+        if (!(expected_value == actual_value)) {                        \
+            std::ostringstream message;                                 \
+            message << "CHECK_EQ(" #expected ", " #actual "): expected " \
+                    << expected_value << ", got " << actual_value;      \
+            serial_test::fail(__FILE__, __LINE__, message.str());       \
+        }                                                               \
+    } while (0)
+
+#define CHECK_THROWS(exception_type, statement)                                      \
+    do {                                                                             \
+        bool thrown = false;                                                         \
+        try {                                                                        \
+            statement;                                                               \
+        }                                                                            \
+        catch (const exception_type&) {                                              \
+            thrown = true;                                                           \
+        }                                                                            \
+        if (!thrown) {                                                               \
+            serial_test::fail(__FILE__, __LINE__, #statement " did not throw " #exception_type); \
+        }                                                                            \
+    } while (0)
+
+#define SERIAL_TEST_MAIN() \
+    int main() { return serial_test::run_all(); }
+
+#endif // SERIAL_TESTS_TEST_UTIL_H
@@ -0,0 +1,234 @@
+/*
+ * A simulated serial device on a pty pair that delivers bytes at the speed
+ * of a real line. A pump thread releases queued bytes to the master side no
+ * faster than one character time each, computed by PortConfig::byteTimeNs()
+ * just like the library's own byte time, so waitByteTimes, inter-byte
+ * timeouts and read_timeout_multiplier behave as they would on hardware.
+ *
+ * Options add seeded (reproducible) per-byte jitter, USB style bursts where
+ * a whole frame shows up at once, and periodic gaps in the stream.
+ */
+
+#ifndef SERIAL_TESTS_VIRTUAL_DEVICE_H
+#define SERIAL_TESTS_VIRTUAL_DEVICE_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+
+#include <poll.h>
+#include <pty.h>
+#include <sys/prctl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "serial/serial.h"
+
+namespace serial_test {
+
+class VirtualDevice {
+public:
+    struct Options {
+        /*! Up to this many nanoseconds of random delay per byte. */
+        uint64_t jitter_ns;
+        /*! Bytes released together once the last of them is due, 1 for a
+         *  plain UART, e.g. 64 for a full speed USB bulk packet.
+         */
+        size_t burst_size;
+        /*! After every gap_every bytes the line goes quiet for gap_ns. */
+        size_t gap_every;
+        uint64_t gap_ns;
+        /*! Seed for the jitter, equal seeds give equal schedules. */
+        uint32_t seed;
+
+        Options()
+            : jitter_ns(0)
+            , burst_size(1)
+            , gap_every(0)
+            , gap_ns(0)
+            , seed(1)
+        {
+        }
+    };
+
+    explicit VirtualDevice(const serial::PortConfig& line, const Options& options = Options())
+        : byte_time_(line.byteTimeNs())
+        , options_(options)
+        , random_(options.seed)
+        , stopping_(false)
+        , busy_(false)
+    {
+        char path[128];
+        if (openpty(&master_, &slave_, path, NULL, NULL) == -1) {
+            perror("openpty");
+            exit(EXIT_FAILURE);
+        }
+        name_ = path;
+        termios raw;
+        tcgetattr(master_, &raw);
+        cfmakeraw(&raw);
+        tcsetattr(master_, TCSANOW, &raw);
+        pump_ = std::thread(&VirtualDevice::pump, this);
+    }
+
+    ~VirtualDevice()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        changed_.notify_all();
+        pump_.join();
+        ::close(master_);
+        ::close(slave_);
+    }
+
+    /*! Path of the tty the Serial under test should open. */
+    const std::string& name() const { return name_; }
+
+    /*! Nanoseconds per character on the simulated line. */
+    uint64_t byteTimeNs() const { return byte_time_; }
+
+    /*! Queues bytes for paced delivery; the line starts from idle if it
+     *  had nothing left to send.
+     */
+    void send(const std::string& data)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.insert(queue_.end(), data.begin(), data.end());
+        }
+        changed_.notify_all();
+    }
+
+    /*! Blocks until every queued byte has been delivered. */
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [this]() { return queue_.empty() && !busy_; });
+    }
+
+    /*! Reads up to size bytes the host wrote, waiting at most timeout_ms
+     *  for each chunk. The host to device direction is not paced.
+     */
+    std::string receive(size_t size, int timeout_ms = 1000)
+    {
+        std::string data;
+        while (data.size() < size) {
+            pollfd event = { master_, POLLIN, 0 };
+            if (::poll(&event, 1, timeout_ms) <= 0) {
+                break;
+            }
+            char chunk[4096];
+            ssize_t n = ::read(master_, chunk, std::min(sizeof(chunk), size - data.size()));
+            if (n <= 0) {
+                break;
+            }
+            data.append(chunk, static_cast<size_t>(n));
+        }
+        return data;
+    }
+
+private:
+    VirtualDevice(const VirtualDevice&);
+    VirtualDevice& operator=(const VirtualDevice&);
+
+    typedef std::chrono::steady_clock Clock;
+
+    void pump()
+    {
+        // Default timer slack (50 us) is most of a byte time at high baud
+        prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+
+        Clock::time_point due = Clock::now();
+        size_t sent_total = 0;
+        std::string burst;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (queue_.empty()) {
+                    busy_ = false;
+                    changed_.notify_all();
+                    changed_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+                    if (stopping_) {
+                        return;
+                    }
+                    // An idle line starts sending right away
+                    due = Clock::now();
+                }
+                if (stopping_) {
+                    return;
+                }
+                busy_ = true;
+                size_t count = std::min(options_.burst_size, queue_.size());
+                burst.assign(queue_.begin(), queue_.begin() + static_cast<std::ptrdiff_t>(count));
+                queue_.erase(queue_.begin(), queue_.begin() + static_cast<std::ptrdiff_t>(count));
+            }
+
+            // Every byte of the burst must be on the wire before it is seen
+            for (size_t i = 0; i < burst.size(); ++i) {
+                if (options_.gap_every != 0 && sent_total != 0 && sent_total % options_.gap_every == 0) {
+                    due += std::chrono::nanoseconds(options_.gap_ns);
+                }
+                due += std::chrono::nanoseconds(byte_time_ + jitter());
+                ++sent_total;
+            }
+            sleepUntil(due);
+
+            size_t written = 0;
+            while (written < burst.size()) {
+                ssize_t n = ::write(master_, burst.data() + written, burst.size() - written);
+                if (n <= 0) {
+                    return;
+                }
+                written += static_cast<size_t>(n);
+            }
+        }
+    }
+
+    uint64_t jitter()
+    {
+        if (options_.jitter_ns == 0) {
+            return 0;
+        }
+        return std::uniform_int_distribution<uint64_t>(0, options_.jitter_ns)(random_);
+    }
+
+    static void sleepUntil(Clock::time_point due)
+    {
+        Clock::duration remaining = due - Clock::now();
+        if (remaining <= Clock::duration::zero()) {
+            return;
+        }
+        int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count();
+        timespec wait = { static_cast<time_t>(ns / 1000000000), static_cast<long>(ns % 1000000000) };
+        while (nanosleep(&wait, &wait) == -1) {
+        }
+    }
+
+    int master_;
+    int slave_;
+    std::string name_;
+    uint64_t byte_time_;
+    Options options_;
+    std::mt19937 random_;
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<char> queue_;
+    bool stopping_;
+    bool busy_;
+    std::thread pump_;
+};
+
+} // namespace serial_test
+
+#endif // SERIAL_TESTS_VIRTUAL_DEVICE_H